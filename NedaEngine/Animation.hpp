@@ -0,0 +1,281 @@
+//
+//  Animation.hpp
+//  NedaEngine
+//
+//  Skeletal animation on the cpu, skinning on the gpu. Poses are kept as structure of arrays, every channel of
+//  the joints' rotations and translations padded to a multiple of 4 joints, so sampling a clip and blending two
+//  poses run 4 joints per instruction with SSE or NEON. The hierarchy walk that turns a pose into skinning
+//  matrices stays scalar. skin.comp then skins every character's vertices once per frame into one vertex buffer
+//  that all the passes draw from. The structs here match skin.comp.
+
+#ifndef Animation_hpp
+#define Animation_hpp
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define NEDA_ANIMATION_SSE 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define NEDA_ANIMATION_NEON 1
+#endif
+
+#include "Math.hpp"
+
+namespace neda {
+
+struct AnimationConfig {
+    static const uint32_t MAX_JOINTS = 255; // joint indices are packed into 8 bits
+    static const uint32_t GROUP_SIZE = 64; // local size of skin.comp
+};
+
+// the bind pose vertex skin.comp reads, std430
+struct SkinVertex {
+    Vec3 position;
+    uint32_t joints; // four 8 bit joint indices, the first in the low byte
+    Vec3 normal;
+    float pad0;
+    Vec3 color;
+    float pad1;
+    float weights[4]; // sum to 1
+};
+static_assert(sizeof(SkinVertex) == 64, "SkinVertex has to match skin.comp");
+
+// the top three rows of a joint's skinning matrix, row by row. std430
+struct JointMatrix {
+    float rows[3][4];
+};
+static_assert(sizeof(JointMatrix) == 48, "JointMatrix has to match skin.comp");
+
+struct SkinPushConstants {
+    uint32_t vertexCount; // of one character
+    uint32_t jointCount; // of one character, character c's matrices start at c * jointCount
+    uint32_t characterCount;
+    uint32_t pad;
+};
+
+inline uint32_t packJoints(uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
+    return a | (b << 8) | (c << 16) | (d << 24);
+}
+
+struct Skeleton {
+    std::vector<int32_t> parents; // parents come before their children, -1 for a root
+    std::vector<Mat4> inverseBindMatrices;
+
+    uint32_t jointCount() const { return static_cast<uint32_t>(parents.size()); }
+    uint32_t laneCount() const { return (jointCount() + 3) & ~3u; } // a pose's channels are whole simd blocks long
+};
+
+enum PoseChannel : uint32_t {
+    POSE_ROTATION_X = 0, // a unit quaternion
+    POSE_ROTATION_Y,
+    POSE_ROTATION_Z,
+    POSE_ROTATION_W,
+    POSE_TRANSLATION_X, // from the parent
+    POSE_TRANSLATION_Y,
+    POSE_TRANSLATION_Z,
+    POSE_CHANNEL_COUNT,
+};
+
+// the joints' local transforms, channel by channel. the padding joints are identities
+struct Pose {
+    std::vector<float> values;
+    uint32_t laneCount = 0;
+
+    void resize(const Skeleton& skeleton) {
+        laneCount = skeleton.laneCount();
+        values.assign(POSE_CHANNEL_COUNT * laneCount, 0.0f);
+        std::fill(channel(POSE_ROTATION_W), channel(POSE_ROTATION_W) + laneCount, 1.0f);
+    }
+
+    float* channel(uint32_t index) { return values.data() + index * laneCount; }
+    const float* channel(uint32_t index) const { return values.data() + index * laneCount; }
+
+    void setRotation(uint32_t joint, const Vec3& axis, float angle) {
+        Vec3 v = normalize(axis) * std::sin(angle * 0.5f);
+        channel(POSE_ROTATION_X)[joint] = v.x;
+        channel(POSE_ROTATION_Y)[joint] = v.y;
+        channel(POSE_ROTATION_Z)[joint] = v.z;
+        channel(POSE_ROTATION_W)[joint] = std::cos(angle * 0.5f);
+    }
+
+    void setTranslation(uint32_t joint, const Vec3& translation) {
+        channel(POSE_TRANSLATION_X)[joint] = translation.x;
+        channel(POSE_TRANSLATION_Y)[joint] = translation.y;
+        channel(POSE_TRANSLATION_Z)[joint] = translation.z;
+    }
+};
+
+namespace detail {
+
+// just enough of 4 wide floats for the pose math, so it is written once for every instruction set
+#if NEDA_ANIMATION_SSE
+typedef __m128 Lanes;
+inline Lanes load(const float* p) { return _mm_loadu_ps(p); }
+inline void store(float* p, Lanes v) { _mm_storeu_ps(p, v); }
+inline Lanes splat(float s) { return _mm_set1_ps(s); }
+inline Lanes add(Lanes a, Lanes b) { return _mm_add_ps(a, b); }
+inline Lanes mul(Lanes a, Lanes b) { return _mm_mul_ps(a, b); }
+inline Lanes lerp(Lanes a, Lanes b, Lanes t) { return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t)); }
+inline Lanes inverseSqrt(Lanes v) { return _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(v)); }
+// v with its sign flipped wherever s is negative
+inline Lanes flipSign(Lanes v, Lanes s) { return _mm_xor_ps(v, _mm_and_ps(s, _mm_set1_ps(-0.0f))); }
+#elif NEDA_ANIMATION_NEON
+typedef float32x4_t Lanes;
+inline Lanes load(const float* p) { return vld1q_f32(p); }
+inline void store(float* p, Lanes v) { vst1q_f32(p, v); }
+inline Lanes splat(float s) { return vdupq_n_f32(s); }
+inline Lanes add(Lanes a, Lanes b) { return vaddq_f32(a, b); }
+inline Lanes mul(Lanes a, Lanes b) { return vmulq_f32(a, b); }
+inline Lanes lerp(Lanes a, Lanes b, Lanes t) { return vmlaq_f32(a, vsubq_f32(b, a), t); }
+inline Lanes inverseSqrt(Lanes v) { return vdivq_f32(vdupq_n_f32(1.0f), vsqrtq_f32(v)); }
+inline Lanes flipSign(Lanes v, Lanes s) {
+    uint32x4_t sign = vandq_u32(vreinterpretq_u32_f32(s), vdupq_n_u32(0x80000000u));
+    return vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(v), sign));
+}
+#else
+struct Lanes {
+    float v[4];
+};
+inline Lanes load(const float* p) { return {{p[0], p[1], p[2], p[3]}}; }
+inline void store(float* p, Lanes a) { std::copy(a.v, a.v + 4, p); }
+inline Lanes splat(float s) { return {{s, s, s, s}}; }
+inline Lanes add(Lanes a, Lanes b) { return {{a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3]}}; }
+inline Lanes mul(Lanes a, Lanes b) { return {{a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3]}}; }
+inline Lanes lerp(Lanes a, Lanes b, Lanes t) {
+    Lanes result;
+    for (int i = 0; i < 4; i++) result.v[i] = a.v[i] + (b.v[i] - a.v[i]) * t.v[i];
+    return result;
+}
+inline Lanes inverseSqrt(Lanes a) {
+    Lanes result;
+    for (int i = 0; i < 4; i++) result.v[i] = 1.0f / std::sqrt(a.v[i]);
+    return result;
+}
+inline Lanes flipSign(Lanes a, Lanes s) {
+    Lanes result;
+    for (int i = 0; i < 4; i++) result.v[i] = std::signbit(s.v[i]) ? -a.v[i] : a.v[i];
+    return result;
+}
+#endif
+
+inline Lanes dot4(Lanes ax, Lanes ay, Lanes az, Lanes aw, Lanes bx, Lanes by, Lanes bz, Lanes bw) {
+    return add(add(mul(ax, bx), mul(ay, by)), add(mul(az, bz), mul(aw, bw)));
+}
+
+// nlerp of 4 joints' rotations, b is flipped onto a's hemisphere first so the blend takes the short way
+inline void blendRotations(const Pose& a, const Pose& b, Lanes t, uint32_t lane, Pose& out) {
+    Lanes ax = load(a.channel(POSE_ROTATION_X) + lane), ay = load(a.channel(POSE_ROTATION_Y) + lane);
+    Lanes az = load(a.channel(POSE_ROTATION_Z) + lane), aw = load(a.channel(POSE_ROTATION_W) + lane);
+    Lanes bx = load(b.channel(POSE_ROTATION_X) + lane), by = load(b.channel(POSE_ROTATION_Y) + lane);
+    Lanes bz = load(b.channel(POSE_ROTATION_Z) + lane), bw = load(b.channel(POSE_ROTATION_W) + lane);
+    Lanes sign = dot4(ax, ay, az, aw, bx, by, bz, bw);
+    Lanes x = lerp(ax, flipSign(bx, sign), t);
+    Lanes y = lerp(ay, flipSign(by, sign), t);
+    Lanes z = lerp(az, flipSign(bz, sign), t);
+    Lanes w = lerp(aw, flipSign(bw, sign), t);
+    Lanes scale = inverseSqrt(dot4(x, y, z, w, x, y, z, w));
+    store(out.channel(POSE_ROTATION_X) + lane, mul(x, scale));
+    store(out.channel(POSE_ROTATION_Y) + lane, mul(y, scale));
+    store(out.channel(POSE_ROTATION_Z) + lane, mul(z, scale));
+    store(out.channel(POSE_ROTATION_W) + lane, mul(w, scale));
+}
+
+inline void blendTranslations(const Pose& a, const Pose& b, Lanes t, uint32_t lane, Pose& out) {
+    for (uint32_t c = POSE_TRANSLATION_X; c <= POSE_TRANSLATION_Z; c++) {
+        store(out.channel(c) + lane, lerp(load(a.channel(c) + lane), load(b.channel(c) + lane), t));
+    }
+}
+
+}
+
+// out = a blended towards b by weight. out may be a or b
+inline void blendPoses(const Pose& a, const Pose& b, float weight, Pose& out) {
+    detail::Lanes t = detail::splat(weight);
+    for (uint32_t lane = 0; lane < out.laneCount; lane += 4) {
+        detail::blendRotations(a, b, t, lane, out);
+        detail::blendTranslations(a, b, t, lane, out);
+    }
+}
+
+// a looping clip sampled at a fixed rate. every key is a whole pose, the last one is the first again
+class AnimationClip {
+public:
+    AnimationClip(const Skeleton& skeleton, float keysPerSecond) : laneCount_(skeleton.laneCount()), keysPerSecond_(keysPerSecond) {}
+
+    void addKey(const Pose& pose) {
+        if (pose.laneCount != laneCount_) {
+            throw std::runtime_error("failed to add animation key, the pose is for another skeleton!");
+        }
+        keys_.push_back(pose);
+    }
+
+    // closes the loop
+    void finish() {
+        if (keys_.empty()) {
+            throw std::runtime_error("failed to finish animation clip, it has no keys!");
+        }
+        keys_.push_back(keys_.front());
+    }
+
+    float duration() const { return (keys_.size() - 1) / keysPerSecond_; }
+
+    void sample(float time, Pose& out) const {
+        float position = std::fmod(time, duration()) * keysPerSecond_;
+        if (position < 0.0f) position += keys_.size() - 1;
+        uint32_t key = std::min(static_cast<uint32_t>(position), static_cast<uint32_t>(keys_.size()) - 2);
+        blendPoses(keys_[key], keys_[key + 1], position - key, out);
+    }
+
+private:
+    std::vector<Pose> keys_;
+    uint32_t laneCount_;
+    float keysPerSecond_;
+};
+
+// rotation and translation from a pose's joint
+inline Mat4 jointTransform(const Pose& pose, uint32_t joint) {
+    float x = pose.channel(POSE_ROTATION_X)[joint], y = pose.channel(POSE_ROTATION_Y)[joint];
+    float z = pose.channel(POSE_ROTATION_Z)[joint], w = pose.channel(POSE_ROTATION_W)[joint];
+    Mat4 result = Mat4::identity();
+    result.at(0, 0) = 1.0f - 2.0f * (y * y + z * z);
+    result.at(0, 1) = 2.0f * (x * y - z * w);
+    result.at(0, 2) = 2.0f * (x * z + y * w);
+    result.at(1, 0) = 2.0f * (x * y + z * w);
+    result.at(1, 1) = 1.0f - 2.0f * (x * x + z * z);
+    result.at(1, 2) = 2.0f * (y * z - x * w);
+    result.at(2, 0) = 2.0f * (x * z - y * w);
+    result.at(2, 1) = 2.0f * (y * z + x * w);
+    result.at(2, 2) = 1.0f - 2.0f * (x * x + y * y);
+    result.at(0, 3) = pose.channel(POSE_TRANSLATION_X)[joint];
+    result.at(1, 3) = pose.channel(POSE_TRANSLATION_Y)[joint];
+    result.at(2, 3) = pose.channel(POSE_TRANSLATION_Z)[joint];
+    return result;
+}
+
+// walks the hierarchy and writes world * model * inverse bind for every joint. modelScratch holds a matrix per joint
+inline void computeSkinMatrices(const Skeleton& skeleton, const Pose& pose, const Mat4& world, std::vector<Mat4>& modelScratch, JointMatrix* out) {
+    uint32_t jointCount = skeleton.jointCount();
+    modelScratch.resize(jointCount);
+    for (uint32_t joint = 0; joint < jointCount; joint++) {
+        int32_t parent = skeleton.parents[joint];
+        Mat4 local = jointTransform(pose, joint);
+        modelScratch[joint] = parent < 0 ? world * local : modelScratch[parent] * local;
+
+        Mat4 skin = modelScratch[joint] * skeleton.inverseBindMatrices[joint];
+        for (int row = 0; row < 3; row++) {
+            for (int column = 0; column < 4; column++) {
+                out[joint].rows[row][column] = skin.at(row, column);
+            }
+        }
+    }
+}
+
+}
+
+#endif /* Animation_hpp */
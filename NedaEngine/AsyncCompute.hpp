@@ -0,0 +1,101 @@
+//
+//  AsyncCompute.hpp
+//  NedaEngine
+//
+//  Helpers for work that is produced on one queue and consumed on another, like compute results
+//  that the graphics queue draws with.
+
+#ifndef AsyncCompute_hpp
+#define AsyncCompute_hpp
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace neda {
+
+// moves a set of exclusive buffers from the producing queue family to the consuming one. the release is
+// recorded on the producer after its writes and the acquire on the consumer before its reads, with a
+// semaphore between the two submits. when both sides are the same family (the serial fallback) the
+// release is an ordinary barrier and the acquire does nothing
+class BufferHandoff {
+public:
+    BufferHandoff(uint32_t srcFamily, uint32_t dstFamily) : srcFamily_(srcFamily), dstFamily_(dstFamily) {}
+
+    void add(VkBuffer buffer) {
+        buffers_.push_back(buffer);
+    }
+
+    bool crossesFamilies() const { return srcFamily_ != dstFamily_; }
+
+    void release(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess,
+                 VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) const {
+        std::vector<VkBufferMemoryBarrier> barriers = makeBarriers(srcAccess, crossesFamilies() ? 0 : dstAccess);
+        // the consumer's stages don't exist on the producing queue, the acquire carries them instead
+        VkPipelineStageFlags releaseDstStage = crossesFamilies() ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : dstStage;
+        vkCmdPipelineBarrier(commandBuffer, srcStage, releaseDstStage, 0, 0, nullptr,
+                             static_cast<uint32_t>(barriers.size()), barriers.data(), 0, nullptr);
+    }
+
+    void acquire(VkCommandBuffer commandBuffer, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) const {
+        if (!crossesFamilies()) return;
+
+        std::vector<VkBufferMemoryBarrier> barriers = makeBarriers(0, dstAccess);
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, dstStage, 0, 0, nullptr,
+                             static_cast<uint32_t>(barriers.size()), barriers.data(), 0, nullptr);
+    }
+
+private:
+    std::vector<VkBufferMemoryBarrier> makeBarriers(VkAccessFlags srcAccess, VkAccessFlags dstAccess) const {
+        std::vector<VkBufferMemoryBarrier> barriers(buffers_.size());
+        for (size_t i = 0; i < buffers_.size(); i++) {
+            VkBufferMemoryBarrier& barrier = barriers[i];
+            barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            barrier.srcAccessMask = srcAccess;
+            barrier.dstAccessMask = dstAccess;
+            barrier.srcQueueFamilyIndex = crossesFamilies() ? srcFamily_ : VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = crossesFamilies() ? dstFamily_ : VK_QUEUE_FAMILY_IGNORED;
+            barrier.buffer = buffers_[i];
+            barrier.offset = 0;
+            barrier.size = VK_WHOLE_SIZE;
+        }
+        return barriers;
+    }
+
+    uint32_t srcFamily_;
+    uint32_t dstFamily_;
+    std::vector<VkBuffer> buffers_;
+};
+
+// running averages for the async compute benchmark, one slot for each way of running the compute work
+struct OverlapBenchmark {
+    enum Mode { ASYNC = 0, SERIAL = 1, MODE_COUNT };
+
+    static const uint32_t FRAMES_PER_MODE = 120; // the modes alternate in blocks so drift hits both the same
+    static const uint32_t WARMUP_FRAMES = 10; // dropped at the start of every block
+    static const uint32_t ROUNDS = 5;
+
+    bool enabled = false;
+    uint32_t frame = 0;
+    double graphicsMilliseconds[MODE_COUNT] = {};
+    double computeMilliseconds[MODE_COUNT] = {};
+    uint32_t samples[MODE_COUNT] = {};
+
+    Mode currentMode() const { return Mode((frame / FRAMES_PER_MODE) % MODE_COUNT); }
+    bool isWarmingUp() const { return frame % FRAMES_PER_MODE < WARMUP_FRAMES; }
+    bool isFinished() const { return frame >= FRAMES_PER_MODE * MODE_COUNT * ROUNDS; }
+
+    void addSample(Mode mode, double graphics, double compute) {
+        graphicsMilliseconds[mode] += graphics;
+        computeMilliseconds[mode] += compute;
+        samples[mode]++;
+    }
+
+    double averageGraphics(Mode mode) const { return samples[mode] ? graphicsMilliseconds[mode] / samples[mode] : 0.0; }
+    double averageCompute(Mode mode) const { return samples[mode] ? computeMilliseconds[mode] / samples[mode] : 0.0; }
+};
+
+}
+
+#endif /* AsyncCompute_hpp */
@@ -0,0 +1,442 @@
+//
+//  CommandLog.hpp
+//  NedaEngine
+//
+//  Capture and replay of what the engine does, to get a slow frame from a run onto another machine. A capture
+//  writes the resources the engine creates, and for every frame it submits the inputs that drive it (the time
+//  and the extents) followed by its engine level commands: draws, shadow draws and compute dispatches. Records
+//  are a type byte and varints, so a frame costs a few hundred bytes. A replay feeds a capture's inputs back into
+//  the frame loop, which makes the engine build the same frames again, and compares the commands it records with
+//  the captured ones to catch frames that no longer match.
+
+#ifndef CommandLog_hpp
+#define CommandLog_hpp
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace neda {
+
+// the first byte of every record. the fields after it are varints unless noted otherwise
+enum CaptureRecord : uint8_t {
+    CAPTURE_SETTINGS = 1, // flags, swapchain width and height. once, right after the header
+    CAPTURE_CREATE_BUFFER, // size, usage
+    CAPTURE_CREATE_IMAGE, // width, height, format, mip levels, usage
+    CAPTURE_UPLOAD, // size
+    CAPTURE_FRAME, // time as 8 raw bytes, swapchain width and height, render width and height
+    CAPTURE_DRAW, // pipeline, material, mesh, instance count
+    CAPTURE_SHADOW_DRAW, // cascade, mesh, instance count
+    CAPTURE_DISPATCH, // pass, and x, y and z groups
+    CAPTURE_END_FRAME,
+};
+
+// the compute passes CAPTURE_DISPATCH names
+enum CapturePass : uint32_t {
+    CAPTURE_PASS_GPU_CULLING = 0,
+    CAPTURE_PASS_LIGHT_BINNING,
+    CAPTURE_PASS_SKINNING,
+    CAPTURE_PASS_PARTICLES, // x is the emission, the rest is dispatched indirectly
+    CAPTURE_PASS_POST,
+    CAPTURE_PASS_MESHLET_CULLING,
+};
+
+// the features a capture was made with, a replay turns the same ones on
+enum CaptureFlag : uint32_t {
+    CAPTURE_FLAG_PARTICLES = 1,
+    CAPTURE_FLAG_SKINNING = 2,
+    CAPTURE_FLAG_POST_PROCESSING = 4,
+    CAPTURE_FLAG_GPU_CULLING = 8,
+    CAPTURE_FLAG_MESHLETS = 16,
+};
+
+const char CAPTURE_MAGIC[8] = {'N', 'E', 'D', 'A', 'C', 'A', 'P', 'T'};
+const uint32_t CAPTURE_VERSION = 1;
+
+class CommandStream {
+public:
+    void record(CaptureRecord type) { bytes_.push_back(type); }
+
+    // 7 bits at a time, the high bit says another byte follows
+    void varint(uint64_t value) {
+        while (value >= 0x80) {
+            bytes_.push_back(static_cast<uint8_t>(value) | 0x80);
+            value >>= 7;
+        }
+        bytes_.push_back(static_cast<uint8_t>(value));
+    }
+
+    void float64(double value) {
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        for (int i = 0; i < 8; i++) {
+            bytes_.push_back(static_cast<uint8_t>(bits >> (i * 8)));
+        }
+    }
+
+    void clear() { bytes_.clear(); }
+    const std::vector<uint8_t>& bytes() const { return bytes_; }
+
+private:
+    std::vector<uint8_t> bytes_;
+};
+
+class CommandReader {
+public:
+    CommandReader(const uint8_t* data, size_t size) : data_(data), size_(size) {}
+
+    bool atEnd() const { return position_ == size_; }
+    size_t position() const { return position_; }
+
+    uint8_t byte() {
+        if (position_ == size_) {
+            throw std::runtime_error("failed to read capture, it ends in the middle of a record!");
+        }
+        return data_[position_++];
+    }
+
+    uint64_t varint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            uint8_t next = byte();
+            value |= static_cast<uint64_t>(next & 0x7F) << shift;
+            if ((next & 0x80) == 0) return value;
+        }
+        throw std::runtime_error("failed to read capture, a varint is too long!");
+    }
+
+    uint32_t uint32() { return static_cast<uint32_t>(varint()); }
+
+    double float64() {
+        uint64_t bits = 0;
+        for (int i = 0; i < 8; i++) {
+            bits |= static_cast<uint64_t>(byte()) << (i * 8);
+        }
+        double value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+private:
+    const uint8_t* data_;
+    size_t size_;
+    size_t position_ = 0;
+};
+
+// what the engine created, compared as totals since the init tasks create things in any order
+struct CaptureResources {
+    uint32_t bufferCount = 0;
+    uint64_t bufferBytes = 0;
+    uint32_t imageCount = 0;
+    uint64_t uploadBytes = 0;
+
+    bool operator==(const CaptureResources& o) const {
+        return bufferCount == o.bufferCount && bufferBytes == o.bufferBytes && imageCount == o.imageCount && uploadBytes == o.uploadBytes;
+    }
+    bool operator!=(const CaptureResources& o) const { return !(*this == o); }
+};
+
+struct CapturedFrame {
+    double time;
+    uint32_t swapchainWidth;
+    uint32_t swapchainHeight;
+    uint32_t renderWidth;
+    uint32_t renderHeight;
+    std::vector<uint8_t> commands; // the records between CAPTURE_FRAME and CAPTURE_END_FRAME
+};
+
+struct CaptureLog {
+    uint32_t flags = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    CaptureResources resources;
+    std::vector<CapturedFrame> frames;
+
+    static CaptureLog load(const std::string& path) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            throw std::runtime_error("failed to open capture " + path + "!");
+        }
+        std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        if (data.size() < sizeof(CAPTURE_MAGIC) || memcmp(data.data(), CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC)) != 0) {
+            throw std::runtime_error("failed to read capture " + path + ", it isn't one!");
+        }
+
+        CaptureLog log;
+        CommandReader reader(data.data() + sizeof(CAPTURE_MAGIC), data.size() - sizeof(CAPTURE_MAGIC));
+        if (reader.uint32() != CAPTURE_VERSION) {
+            throw std::runtime_error("failed to read capture " + path + ", it was written by another version!");
+        }
+        if (reader.byte() != CAPTURE_SETTINGS) {
+            throw std::runtime_error("failed to read capture " + path + ", its settings are missing!");
+        }
+        log.flags = reader.uint32();
+        log.width = reader.uint32();
+        log.height = reader.uint32();
+
+        // the resources are what init created, the ones a resize creates later depend on the window. a capture that
+        // was cut off keeps the frames before the one it ended in
+        const uint8_t* base = data.data() + sizeof(CAPTURE_MAGIC);
+        try {
+            while (!reader.atEnd()) {
+                uint8_t type = reader.byte();
+                bool initializing = log.frames.empty();
+                if (type == CAPTURE_CREATE_BUFFER) {
+                    uint64_t size = reader.varint();
+                    reader.varint();
+                    if (initializing) {
+                        log.resources.bufferCount++;
+                        log.resources.bufferBytes += size;
+                    }
+                } else if (type == CAPTURE_CREATE_IMAGE) {
+                    for (int i = 0; i < 5; i++) reader.varint();
+                    log.resources.imageCount += initializing ? 1 : 0;
+                } else if (type == CAPTURE_UPLOAD) {
+                    uint64_t size = reader.varint();
+                    log.resources.uploadBytes += initializing ? size : 0;
+                } else if (type == CAPTURE_FRAME) {
+                    CapturedFrame frame;
+                    frame.time = reader.float64();
+                    frame.swapchainWidth = reader.uint32();
+                    frame.swapchainHeight = reader.uint32();
+                    frame.renderWidth = reader.uint32();
+                    frame.renderHeight = reader.uint32();
+                    size_t begin = reader.position();
+                    skipFrameCommands(reader);
+                    frame.commands.assign(base + begin, base + reader.position() - 1);
+                    log.frames.push_back(std::move(frame));
+                } else {
+                    throw std::runtime_error("failed to read capture " + path + ", unknown record!");
+                }
+            }
+        } catch (const std::runtime_error& error) {
+            if (log.frames.empty()) throw;
+            std::cerr << error.what() << " replaying the " << log.frames.size() << " frames before it" << std::endl;
+        }
+        return log;
+    }
+
+private:
+    // up to and with the frame's CAPTURE_END_FRAME
+    static void skipFrameCommands(CommandReader& reader) {
+        for (;;) {
+            uint8_t type = reader.byte();
+            int fields = 0;
+            if (type == CAPTURE_END_FRAME) return;
+            if (type == CAPTURE_DRAW || type == CAPTURE_DISPATCH) fields = 4;
+            else if (type == CAPTURE_SHADOW_DRAW) fields = 3;
+            else throw std::runtime_error("failed to read capture, unknown record in a frame!");
+            for (int i = 0; i < fields; i++) reader.varint();
+        }
+    }
+};
+
+// records what the engine does. resources can come from any thread, the frames only from the one that draws them
+class CommandRecorder {
+public:
+    // everything recorded from here on is written to path
+    void capture(const std::string& path, uint32_t flags, uint32_t width, uint32_t height) {
+        file_.open(path, std::ios::binary | std::ios::trunc);
+        if (!file_) {
+            throw std::runtime_error("failed to create capture " + path + "!");
+        }
+        CommandStream header;
+        header.varint(CAPTURE_VERSION);
+        header.record(CAPTURE_SETTINGS);
+        header.varint(flags);
+        header.varint(width);
+        header.varint(height);
+        file_.write(CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC));
+        write(header);
+        enabled_ = true;
+    }
+
+    // records without a file, for a replay to compare with its capture
+    void record() { enabled_ = true; }
+
+    bool enabled() const { return enabled_; }
+    const CaptureResources& resources() const { return resources_; }
+
+    void createBuffer(uint64_t size, uint32_t usage) {
+        if (!enabled_) return;
+        std::lock_guard<std::mutex> lock(mutex_);
+        resources_.bufferCount++;
+        resources_.bufferBytes += size;
+        CommandStream stream;
+        stream.record(CAPTURE_CREATE_BUFFER);
+        stream.varint(size);
+        stream.varint(usage);
+        write(stream);
+    }
+
+    void createImage(uint32_t width, uint32_t height, uint32_t format, uint32_t mipLevels, uint32_t usage) {
+        if (!enabled_) return;
+        std::lock_guard<std::mutex> lock(mutex_);
+        resources_.imageCount++;
+        CommandStream stream;
+        stream.record(CAPTURE_CREATE_IMAGE);
+        stream.varint(width);
+        stream.varint(height);
+        stream.varint(format);
+        stream.varint(mipLevels);
+        stream.varint(usage);
+        write(stream);
+    }
+
+    void upload(uint64_t size) {
+        if (!enabled_) return;
+        std::lock_guard<std::mutex> lock(mutex_);
+        resources_.uploadBytes += size;
+        CommandStream stream;
+        stream.record(CAPTURE_UPLOAD);
+        stream.varint(size);
+        write(stream);
+    }
+
+    // a frame that isn't submitted in the end is simply replaced by the next one
+    void beginFrame(double time, uint32_t swapchainWidth, uint32_t swapchainHeight, uint32_t renderWidth, uint32_t renderHeight) {
+        if (!enabled_) return;
+        frameHeader_.clear();
+        frameHeader_.record(CAPTURE_FRAME);
+        frameHeader_.float64(time);
+        frameHeader_.varint(swapchainWidth);
+        frameHeader_.varint(swapchainHeight);
+        frameHeader_.varint(renderWidth);
+        frameHeader_.varint(renderHeight);
+        frame_.clear();
+    }
+
+    void draw(uint32_t pipeline, uint32_t material, uint32_t mesh, uint32_t instanceCount) {
+        if (!enabled_) return;
+        frame_.record(CAPTURE_DRAW);
+        frame_.varint(pipeline);
+        frame_.varint(material);
+        frame_.varint(mesh);
+        frame_.varint(instanceCount);
+    }
+
+    void shadowDraw(uint32_t cascade, uint32_t mesh, uint32_t instanceCount) {
+        if (!enabled_) return;
+        frame_.record(CAPTURE_SHADOW_DRAW);
+        frame_.varint(cascade);
+        frame_.varint(mesh);
+        frame_.varint(instanceCount);
+    }
+
+    void dispatch(CapturePass pass, uint32_t x, uint32_t y, uint32_t z) {
+        if (!enabled_) return;
+        frame_.record(CAPTURE_DISPATCH);
+        frame_.varint(pass);
+        frame_.varint(x);
+        frame_.varint(y);
+        frame_.varint(z);
+    }
+
+    // the frame was submitted, it goes to the file
+    void endFrame() {
+        if (!enabled_ || !file_.is_open()) return;
+        std::lock_guard<std::mutex> lock(mutex_);
+        write(frameHeader_);
+        write(frame_);
+        CommandStream end;
+        end.record(CAPTURE_END_FRAME);
+        write(end);
+    }
+
+    // the current frame's commands, in the form CapturedFrame keeps them
+    const std::vector<uint8_t>& frameCommands() const { return frame_.bytes(); }
+
+private:
+    void write(const CommandStream& stream) {
+        if (file_.is_open()) {
+            file_.write(reinterpret_cast<const char*>(stream.bytes().data()), stream.bytes().size());
+        }
+    }
+
+    bool enabled_ = false;
+    std::mutex mutex_;
+    std::ofstream file_;
+    CaptureResources resources_;
+    CommandStream frameHeader_;
+    CommandStream frame_;
+};
+
+// the cpu and gpu time of every replayed frame, and whether it still matched its capture
+class ReplayTimings {
+public:
+    void resize(size_t frameCount) {
+        cpuMilliseconds_.assign(frameCount, -1.0f);
+        gpuMilliseconds_.assign(frameCount, -1.0f);
+    }
+
+    void setCpu(uint32_t frame, float milliseconds) { cpuMilliseconds_[frame] = milliseconds; }
+    void setGpu(uint32_t frame, float milliseconds) { gpuMilliseconds_[frame] = milliseconds; }
+    void addMismatch(uint32_t frame) {
+        if (mismatches_ == 0) firstMismatch_ = frame;
+        mismatches_++;
+    }
+
+    uint32_t mismatches() const { return mismatches_; }
+
+    void print(std::ostream& out) const {
+        out << "replayed " << cpuMilliseconds_.size() << " frames" << std::endl;
+        printSeries(out, "  cpu", cpuMilliseconds_);
+        printSeries(out, "  gpu", gpuMilliseconds_);
+
+        std::vector<uint32_t> slowest;
+        for (uint32_t i = 0; i < gpuMilliseconds_.size(); i++) {
+            if (gpuMilliseconds_[i] >= 0.0f) slowest.push_back(i);
+        }
+        size_t shown = std::min<size_t>(slowest.size(), 5);
+        std::partial_sort(slowest.begin(), slowest.begin() + shown, slowest.end(),
+                          [this](uint32_t a, uint32_t b) { return gpuMilliseconds_[a] > gpuMilliseconds_[b]; });
+        if (shown > 0) {
+            out << "  slowest gpu frames:";
+            for (size_t i = 0; i < shown; i++) {
+                out << " " << slowest[i] << " (" << gpuMilliseconds_[slowest[i]] << " ms)";
+            }
+            out << std::endl;
+        }
+
+        if (mismatches_ == 0) {
+            out << "  every frame matched its capture" << std::endl;
+        } else {
+            out << "  " << mismatches_ << " frames recorded other commands than the capture, the first was frame " << firstMismatch_ << std::endl;
+        }
+    }
+
+private:
+    static void printSeries(std::ostream& out, const char* name, const std::vector<float>& milliseconds) {
+        std::vector<float> sorted;
+        for (float value : milliseconds) {
+            if (value >= 0.0f) sorted.push_back(value);
+        }
+        if (sorted.empty()) {
+            out << name << ": no timings" << std::endl;
+            return;
+        }
+        std::sort(sorted.begin(), sorted.end());
+        double sum = 0.0;
+        for (float value : sorted) sum += value;
+        auto percentile = [&](float p) { return sorted[std::min(sorted.size() - 1, static_cast<size_t>(p * sorted.size()))]; };
+        out << name << ": average " << sum / sorted.size() << " ms, median " << percentile(0.5f) << " ms, 99th percentile "
+            << percentile(0.99f) << " ms, max " << sorted.back() << " ms" << std::endl;
+    }
+
+    std::vector<float> cpuMilliseconds_;
+    std::vector<float> gpuMilliseconds_;
+    uint32_t mismatches_ = 0;
+    uint32_t firstMismatch_ = 0;
+};
+
+}
+
+#endif /* CommandLog_hpp */
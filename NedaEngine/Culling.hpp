@@ -0,0 +1,459 @@
+//
+//  Culling.hpp
+//  NedaEngine
+//
+//  CPU visibility tests for scene objects. Bounds are kept as structure of arrays so
+//  the frustum tests can run 8 objects per instruction with AVX, 4 with SSE or NEON,
+//  and the visible indices get written out compacted. OcclusionBuffer is a small
+//  software rasterized depth buffer of the big occluders for coarse occlusion culling.
+
+#ifndef Culling_hpp
+#define Culling_hpp
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define NEDA_CULLING_AVX 1
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define NEDA_CULLING_SSE 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define NEDA_CULLING_NEON 1
+#endif
+
+#include "Math.hpp"
+
+namespace neda {
+
+// the six planes of a view frustum, normals point inside
+struct Frustum {
+    // planes[i] = (nx, ny, nz, d) where dot(n, p) + d >= 0 for points inside
+    float planes[6][4];
+
+    // Gribb/Hartmann plane extraction, for vulkan's 0 to 1 clip depth the near plane is just the third row
+    static Frustum fromViewProjection(const Mat4& viewProjection) {
+        Frustum frustum;
+        float rows[4][4];
+        for (int row = 0; row < 4; row++) {
+            for (int column = 0; column < 4; column++) {
+                rows[row][column] = viewProjection.at(row, column);
+            }
+        }
+
+        for (int i = 0; i < 4; i++) {
+            frustum.planes[0][i] = rows[3][i] + rows[0][i]; // left
+            frustum.planes[1][i] = rows[3][i] - rows[0][i]; // right
+            frustum.planes[2][i] = rows[3][i] + rows[1][i]; // bottom
+            frustum.planes[3][i] = rows[3][i] - rows[1][i]; // top
+            frustum.planes[4][i] = rows[2][i];              // near
+            frustum.planes[5][i] = rows[3][i] - rows[2][i]; // far
+        }
+
+        for (auto& plane : frustum.planes) {
+            float inverseLength = 1.0f / std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+            for (float& value : plane) {
+                value *= inverseLength;
+            }
+        }
+        return frustum;
+    }
+};
+
+struct BoundingSpheres {
+    std::vector<float> centerX, centerY, centerZ, radius;
+
+    void add(const Vec3& center, float sphereRadius) {
+        centerX.push_back(center.x);
+        centerY.push_back(center.y);
+        centerZ.push_back(center.z);
+        radius.push_back(sphereRadius);
+    }
+
+    void set(uint32_t index, const Vec3& center, float sphereRadius) {
+        centerX[index] = center.x;
+        centerY[index] = center.y;
+        centerZ[index] = center.z;
+        radius[index] = sphereRadius;
+    }
+
+    uint32_t size() const { return static_cast<uint32_t>(radius.size()); }
+};
+
+struct BoundingBoxes {
+    std::vector<float> centerX, centerY, centerZ, extentX, extentY, extentZ;
+
+    void add(const Vec3& center, const Vec3& extent) {
+        centerX.push_back(center.x);
+        centerY.push_back(center.y);
+        centerZ.push_back(center.z);
+        extentX.push_back(extent.x);
+        extentY.push_back(extent.y);
+        extentZ.push_back(extent.z);
+    }
+
+    void set(uint32_t index, const Vec3& center, const Vec3& extent) {
+        centerX[index] = center.x;
+        centerY[index] = center.y;
+        centerZ[index] = center.z;
+        extentX[index] = extent.x;
+        extentY[index] = extent.y;
+        extentZ[index] = extent.z;
+    }
+
+    uint32_t size() const { return static_cast<uint32_t>(centerX.size()); }
+};
+
+namespace detail {
+    inline bool sphereVisible(const Frustum& frustum, float x, float y, float z, float r) {
+        for (const auto& plane : frustum.planes) {
+            if (plane[0] * x + plane[1] * y + plane[2] * z + plane[3] <= -r) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // the box is outside a plane when even its corner furthest along the normal is behind it
+    inline bool boxVisible(const Frustum& frustum, float x, float y, float z, float ex, float ey, float ez) {
+        for (const auto& plane : frustum.planes) {
+            float distance = plane[0] * x + plane[1] * y + plane[2] * z + plane[3];
+            float reach = std::fabs(plane[0]) * ex + std::fabs(plane[1]) * ey + std::fabs(plane[2]) * ez;
+            if (distance + reach <= 0.0f) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // appends the lane indices whose mask bit is set, branch free so unpredictable masks don't cost mispredicts
+    inline uint32_t appendVisible(uint32_t mask, uint32_t laneCount, uint32_t firstIndex, uint32_t* visible, uint32_t count) {
+        for (uint32_t lane = 0; lane < laneCount; lane++) {
+            visible[count] = firstIndex + lane;
+            count += (mask >> lane) & 1u;
+        }
+        return count;
+    }
+}
+
+// writes the indices in [begin, end) of the spheres that touch the frustum into visible, in order,
+// visible needs room for end - begin indices, returns how many were written
+inline uint32_t cullSpheres(const Frustum& frustum, const BoundingSpheres& spheres, uint32_t begin, uint32_t end, uint32_t* visible) {
+    const float* px = spheres.centerX.data();
+    const float* py = spheres.centerY.data();
+    const float* pz = spheres.centerZ.data();
+    const float* pr = spheres.radius.data();
+    uint32_t count = 0;
+    uint32_t i = begin;
+
+#if NEDA_CULLING_AVX
+    __m256 planes[6][4];
+    for (int p = 0; p < 6; p++) {
+        for (int c = 0; c < 4; c++) {
+            planes[p][c] = _mm256_set1_ps(frustum.planes[p][c]);
+        }
+    }
+    for (; i + 8 <= end; i += 8) {
+        __m256 x = _mm256_loadu_ps(px + i);
+        __m256 y = _mm256_loadu_ps(py + i);
+        __m256 z = _mm256_loadu_ps(pz + i);
+        __m256 negativeRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(pr + i));
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int p = 0; p < 6; p++) {
+            __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(planes[p][0], x), _mm256_mul_ps(planes[p][1], y)),
+                                            _mm256_add_ps(_mm256_mul_ps(planes[p][2], z), planes[p][3]));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negativeRadius, _CMP_GT_OQ));
+        }
+        count = detail::appendVisible(static_cast<uint32_t>(_mm256_movemask_ps(inside)), 8, i, visible, count);
+    }
+#elif NEDA_CULLING_SSE
+    __m128 planes[6][4];
+    for (int p = 0; p < 6; p++) {
+        for (int c = 0; c < 4; c++) {
+            planes[p][c] = _mm_set1_ps(frustum.planes[p][c]);
+        }
+    }
+    for (; i + 4 <= end; i += 4) {
+        __m128 x = _mm_loadu_ps(px + i);
+        __m128 y = _mm_loadu_ps(py + i);
+        __m128 z = _mm_loadu_ps(pz + i);
+        __m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(pr + i));
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int p = 0; p < 6; p++) {
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planes[p][0], x), _mm_mul_ps(planes[p][1], y)),
+                                         _mm_add_ps(_mm_mul_ps(planes[p][2], z), planes[p][3]));
+            inside = _mm_and_ps(inside, _mm_cmpgt_ps(distance, negativeRadius));
+        }
+        count = detail::appendVisible(static_cast<uint32_t>(_mm_movemask_ps(inside)), 4, i, visible, count);
+    }
+#elif NEDA_CULLING_NEON
+    static const uint32_t laneBits[4] = {1, 2, 4, 8};
+    const uint32x4_t bits = vld1q_u32(laneBits);
+    float32x4_t planes[6][4];
+    for (int p = 0; p < 6; p++) {
+        for (int c = 0; c < 4; c++) {
+            planes[p][c] = vdupq_n_f32(frustum.planes[p][c]);
+        }
+    }
+    for (; i + 4 <= end; i += 4) {
+        float32x4_t x = vld1q_f32(px + i);
+        float32x4_t y = vld1q_f32(py + i);
+        float32x4_t z = vld1q_f32(pz + i);
+        float32x4_t negativeRadius = vnegq_f32(vld1q_f32(pr + i));
+        uint32x4_t inside = vdupq_n_u32(0xffffffffu);
+        for (int p = 0; p < 6; p++) {
+            float32x4_t distance = vmlaq_f32(vmlaq_f32(vmlaq_f32(planes[p][3], planes[p][0], x), planes[p][1], y), planes[p][2], z);
+            inside = vandq_u32(inside, vcgtq_f32(distance, negativeRadius));
+        }
+        count = detail::appendVisible(vaddvq_u32(vandq_u32(inside, bits)), 4, i, visible, count);
+    }
+#endif
+
+    for (; i < end; i++) {
+        visible[count] = i;
+        count += detail::sphereVisible(frustum, px[i], py[i], pz[i], pr[i]) ? 1 : 0;
+    }
+    return count;
+}
+
+// same as cullSpheres but for axis aligned boxes
+inline uint32_t cullBoxes(const Frustum& frustum, const BoundingBoxes& boxes, uint32_t begin, uint32_t end, uint32_t* visible) {
+    const float* px = boxes.centerX.data();
+    const float* py = boxes.centerY.data();
+    const float* pz = boxes.centerZ.data();
+    const float* ex = boxes.extentX.data();
+    const float* ey = boxes.extentY.data();
+    const float* ez = boxes.extentZ.data();
+    uint32_t count = 0;
+    uint32_t i = begin;
+
+#if NEDA_CULLING_AVX
+    __m256 planes[6][4], absPlanes[6][3];
+    for (int p = 0; p < 6; p++) {
+        for (int c = 0; c < 4; c++) {
+            planes[p][c] = _mm256_set1_ps(frustum.planes[p][c]);
+        }
+        for (int c = 0; c < 3; c++) {
+            absPlanes[p][c] = _mm256_set1_ps(std::fabs(frustum.planes[p][c]));
+        }
+    }
+    for (; i + 8 <= end; i += 8) {
+        __m256 x = _mm256_loadu_ps(px + i), y = _mm256_loadu_ps(py + i), z = _mm256_loadu_ps(pz + i);
+        __m256 sx = _mm256_loadu_ps(ex + i), sy = _mm256_loadu_ps(ey + i), sz = _mm256_loadu_ps(ez + i);
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int p = 0; p < 6; p++) {
+            __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(planes[p][0], x), _mm256_mul_ps(planes[p][1], y)),
+                                            _mm256_add_ps(_mm256_mul_ps(planes[p][2], z), planes[p][3]));
+            __m256 reach = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(absPlanes[p][0], sx), _mm256_mul_ps(absPlanes[p][1], sy)),
+                                         _mm256_mul_ps(absPlanes[p][2], sz));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(distance, reach), _mm256_setzero_ps(), _CMP_GT_OQ));
+        }
+        count = detail::appendVisible(static_cast<uint32_t>(_mm256_movemask_ps(inside)), 8, i, visible, count);
+    }
+#elif NEDA_CULLING_SSE
+    __m128 planes[6][4], absPlanes[6][3];
+    for (int p = 0; p < 6; p++) {
+        for (int c = 0; c < 4; c++) {
+            planes[p][c] = _mm_set1_ps(frustum.planes[p][c]);
+        }
+        for (int c = 0; c < 3; c++) {
+            absPlanes[p][c] = _mm_set1_ps(std::fabs(frustum.planes[p][c]));
+        }
+    }
+    for (; i + 4 <= end; i += 4) {
+        __m128 x = _mm_loadu_ps(px + i), y = _mm_loadu_ps(py + i), z = _mm_loadu_ps(pz + i);
+        __m128 sx = _mm_loadu_ps(ex + i), sy = _mm_loadu_ps(ey + i), sz = _mm_loadu_ps(ez + i);
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int p = 0; p < 6; p++) {
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planes[p][0], x), _mm_mul_ps(planes[p][1], y)),
+                                         _mm_add_ps(_mm_mul_ps(planes[p][2], z), planes[p][3]));
+            __m128 reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(absPlanes[p][0], sx), _mm_mul_ps(absPlanes[p][1], sy)),
+                                      _mm_mul_ps(absPlanes[p][2], sz));
+            inside = _mm_and_ps(inside, _mm_cmpgt_ps(_mm_add_ps(distance, reach), _mm_setzero_ps()));
+        }
+        count = detail::appendVisible(static_cast<uint32_t>(_mm_movemask_ps(inside)), 4, i, visible, count);
+    }
+#elif NEDA_CULLING_NEON
+    static const uint32_t laneBits[4] = {1, 2, 4, 8};
+    const uint32x4_t bits = vld1q_u32(laneBits);
+    float32x4_t planes[6][4], absPlanes[6][3];
+    for (int p = 0; p < 6; p++) {
+        for (int c = 0; c < 4; c++) {
+            planes[p][c] = vdupq_n_f32(frustum.planes[p][c]);
+        }
+        for (int c = 0; c < 3; c++) {
+            absPlanes[p][c] = vdupq_n_f32(std::fabs(frustum.planes[p][c]));
+        }
+    }
+    for (; i + 4 <= end; i += 4) {
+        float32x4_t x = vld1q_f32(px + i), y = vld1q_f32(py + i), z = vld1q_f32(pz + i);
+        float32x4_t sx = vld1q_f32(ex + i), sy = vld1q_f32(ey + i), sz = vld1q_f32(ez + i);
+        uint32x4_t inside = vdupq_n_u32(0xffffffffu);
+        for (int p = 0; p < 6; p++) {
+            float32x4_t distance = vmlaq_f32(vmlaq_f32(vmlaq_f32(planes[p][3], planes[p][0], x), planes[p][1], y), planes[p][2], z);
+            float32x4_t reach = vmlaq_f32(vmlaq_f32(vmulq_f32(absPlanes[p][0], sx), absPlanes[p][1], sy), absPlanes[p][2], sz);
+            inside = vandq_u32(inside, vcgtq_f32(vaddq_f32(distance, reach), vdupq_n_f32(0.0f)));
+        }
+        count = detail::appendVisible(vaddvq_u32(vandq_u32(inside, bits)), 4, i, visible, count);
+    }
+#endif
+
+    for (; i < end; i++) {
+        visible[count] = i;
+        count += detail::boxVisible(frustum, px[i], py[i], pz[i], ex[i], ey[i], ez[i]) ? 1 : 0;
+    }
+    return count;
+}
+
+// coarse depth buffer of the scene's big occluders, rasterized on the CPU.
+// every texel keeps the nearest occluder depth, and each occluder is written at the depth of its furthest
+// corner and only into texels it covers completely, so the buffer never claims something is hidden when it isn't
+class OcclusionBuffer {
+public:
+    OcclusionBuffer(uint32_t width = 256, uint32_t height = 128) : width_(width), height_(height), depth_(width * height, 1.0f) {}
+
+    void clear(const Mat4& viewProjection) {
+        viewProjection_ = viewProjection;
+        std::fill(depth_.begin(), depth_.end(), 1.0f);
+    }
+
+    void rasterizeBox(const Vec3& center, const Vec3& extent) {
+        ScreenPoint corners[8];
+        if (!projectBox(center, extent, corners)) {
+            return; // crosses the near plane, skipping it only means we occlude less
+        }
+
+        // a box covers the convex hull of its corners on screen, rasterizing that instead of its faces' triangles
+        // means there are no seams between triangles that only half cover the texels along them
+        std::sort(corners, corners + 8, [](const ScreenPoint& a, const ScreenPoint& b) {
+            return a.x < b.x || (a.x == b.x && a.y < b.y);
+        });
+        ScreenPoint hull[16];
+        int count = 0;
+        auto turnsLeft = [](const ScreenPoint& o, const ScreenPoint& a, const ScreenPoint& b) {
+            return (a.x - o.x) * (b.y - o.y) - (a.y - o.y) * (b.x - o.x) > 0.0f;
+        };
+        for (int i = 0; i < 8; i++) {
+            while (count >= 2 && !turnsLeft(hull[count - 2], hull[count - 1], corners[i])) count--;
+            hull[count++] = corners[i];
+        }
+        for (int i = 6, lower = count + 1; i >= 0; i--) {
+            while (count >= lower && !turnsLeft(hull[count - 2], hull[count - 1], corners[i])) count--;
+            hull[count++] = corners[i];
+        }
+        count--; // the first corner again
+
+        float depth = corners[0].depth;
+        for (const auto& corner : corners) {
+            depth = std::max(depth, corner.depth);
+        }
+        rasterizeConvex(hull, count, depth);
+    }
+
+    // true if every texel the box covers has an occluder in front of the box's nearest point
+    bool isBoxOccluded(const Vec3& center, const Vec3& extent) const {
+        ScreenPoint corners[8];
+        if (!projectBox(center, extent, corners)) {
+            return false;
+        }
+
+        float minX = corners[0].x, maxX = corners[0].x, minY = corners[0].y, maxY = corners[0].y, nearest = corners[0].depth;
+        for (const auto& corner : corners) {
+            minX = std::min(minX, corner.x);
+            maxX = std::max(maxX, corner.x);
+            minY = std::min(minY, corner.y);
+            maxY = std::max(maxY, corner.y);
+            nearest = std::min(nearest, corner.depth);
+        }
+
+        int x0 = std::max(0, static_cast<int>(std::floor(minX)));
+        int y0 = std::max(0, static_cast<int>(std::floor(minY)));
+        int x1 = std::min(static_cast<int>(width_) - 1, static_cast<int>(std::floor(maxX)));
+        int y1 = std::min(static_cast<int>(height_) - 1, static_cast<int>(std::floor(maxY)));
+        if (x0 > x1 || y0 > y1) {
+            return false; // off screen, leave it to the frustum test
+        }
+
+        for (int y = y0; y <= y1; y++) {
+            const float* row = &depth_[y * width_];
+            for (int x = x0; x <= x1; x++) {
+                if (nearest <= row[x]) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+private:
+    struct ScreenPoint {
+        float x, y, depth;
+    };
+
+    bool projectBox(const Vec3& center, const Vec3& extent, ScreenPoint* corners) const {
+        for (int i = 0; i < 8; i++) {
+            Vec3 corner(center.x + ((i & 1) ? extent.x : -extent.x),
+                        center.y + ((i & 2) ? extent.y : -extent.y),
+                        center.z + ((i & 4) ? extent.z : -extent.z));
+            Vec4 clip = viewProjection_ * Vec4(corner, 1.0f);
+            if (clip.w <= 1e-4f) {
+                return false;
+            }
+            float inverseW = 1.0f / clip.w;
+            corners[i].x = (clip.x * inverseW * 0.5f + 0.5f) * width_;
+            corners[i].y = (clip.y * inverseW * 0.5f + 0.5f) * height_;
+            corners[i].depth = clip.z * inverseW;
+        }
+        return true;
+    }
+
+    // writes depth into the texels inside every edge of a counter clockwise polygon. a texel counts as inside an
+    // edge when its corner nearest the outside is, which is the edge function at its center minus half the edge's
+    // extent along each axis
+    void rasterizeConvex(const ScreenPoint* points, int count, float depth) {
+        if (count < 3) {
+            return;
+        }
+        float minX = points[0].x, maxX = points[0].x, minY = points[0].y, maxY = points[0].y;
+        for (int i = 1; i < count; i++) {
+            minX = std::min(minX, points[i].x);
+            maxX = std::max(maxX, points[i].x);
+            minY = std::min(minY, points[i].y);
+            maxY = std::max(maxY, points[i].y);
+        }
+        int x0 = std::max(0, static_cast<int>(std::floor(minX)));
+        int y0 = std::max(0, static_cast<int>(std::floor(minY)));
+        int x1 = std::min(static_cast<int>(width_) - 1, static_cast<int>(std::ceil(maxX)));
+        int y1 = std::min(static_cast<int>(height_) - 1, static_cast<int>(std::ceil(maxY)));
+
+        for (int y = y0; y <= y1; y++) {
+            float py = y + 0.5f;
+            float* row = &depth_[y * width_];
+            for (int x = x0; x <= x1; x++) {
+                float px = x + 0.5f;
+                bool covered = true;
+                for (int i = 0; i < count && covered; i++) {
+                    const ScreenPoint& a = points[i];
+                    const ScreenPoint& b = points[(i + 1) % count];
+                    float edgeX = b.x - a.x, edgeY = b.y - a.y;
+                    float inside = edgeX * (py - a.y) - edgeY * (px - a.x);
+                    covered = inside >= 0.5f * (std::fabs(edgeX) + std::fabs(edgeY));
+                }
+                if (covered) {
+                    row[x] = std::min(row[x], depth);
+                }
+            }
+        }
+    }
+
+    uint32_t width_, height_;
+    std::vector<float> depth_;
+    Mat4 viewProjection_ = Mat4::identity();
+};
+
+}
+
+#endif /* Culling_hpp */
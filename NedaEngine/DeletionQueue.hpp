@@ -0,0 +1,91 @@
+//
+//  DeletionQueue.hpp
+//  NedaEngine
+//
+//  Destroys gpu resources once the gpu is done with them instead of right away. A released resource
+//  is tagged with the last value submitted on every queue's timeline, and destroyed once all of those
+//  values are reached, so replacing something mid session never needs vkDeviceWaitIdle.
+
+#ifndef DeletionQueue_hpp
+#define DeletionQueue_hpp
+
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <vector>
+
+#include "Timeline.hpp"
+
+namespace neda {
+
+class DeletionQueue {
+public:
+    static const uint32_t MAX_TIMELINES = 4;
+
+    // every queue that could be using a released resource, added once when the timelines are created
+    void addTimeline(const QueueTimeline& timeline) {
+        if (timelines_.size() == MAX_TIMELINES) {
+            throw std::runtime_error("failed to add timeline to deletion queue, it is full!");
+        }
+        timelines_.push_back(&timeline);
+    }
+
+    // call after the last submit that used the resource. everything submitted so far has to finish first,
+    // which is a bit conservative but means the caller never has to know which frame touched it last
+    void release(std::function<void()> destroy) {
+        Entry entry;
+        for (uint32_t i = 0; i < timelines_.size(); i++) {
+            entry.values[i] = timelines_[i]->lastSubmittedValue();
+        }
+        entry.destroy = std::move(destroy);
+        entries_.push_back(std::move(entry));
+    }
+
+    // once a frame, destroys whatever the gpu has retired in the order it was released. returns how many
+    size_t collect() {
+        size_t kept = 0;
+        for (size_t i = 0; i < entries_.size(); i++) {
+            if (isRetired(entries_[i])) {
+                entries_[i].destroy();
+            } else {
+                if (kept != i) {
+                    entries_[kept] = std::move(entries_[i]);
+                }
+                kept++;
+            }
+        }
+        size_t destroyed = entries_.size() - kept;
+        entries_.resize(kept);
+        return destroyed;
+    }
+
+    // only once the device is idle, at shutdown
+    void flush() {
+        for (Entry& entry : entries_) {
+            entry.destroy();
+        }
+        entries_.clear();
+    }
+
+    size_t pending() const { return entries_.size(); }
+
+private:
+    struct Entry {
+        uint64_t values[MAX_TIMELINES] = {};
+        std::function<void()> destroy;
+    };
+
+    bool isRetired(const Entry& entry) const {
+        for (uint32_t i = 0; i < timelines_.size(); i++) {
+            if (!timelines_[i]->isComplete(entry.values[i])) return false;
+        }
+        return true;
+    }
+
+    std::vector<const QueueTimeline*> timelines_;
+    std::vector<Entry> entries_;
+};
+
+}
+
+#endif /* DeletionQueue_hpp */
@@ -0,0 +1,80 @@
+//
+//  DynamicResolution.hpp
+//  NedaEngine
+//
+//  Picks the scale the scene is rendered at from measured gpu frame times. The scene target is allocated
+//  at full size once, a scale only shrinks the viewport, so changing it costs nothing but the next frame.
+
+#ifndef DynamicResolution_hpp
+#define DynamicResolution_hpp
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace neda {
+
+struct DynamicResolutionSettings {
+    float minScale = 0.5f; // of the width and height, so a quarter of the pixels
+    float maxScale = 1.0f;
+    float targetMilliseconds = 1000.0f / 60.0f; // gpu time of a frame
+    float headroom = 0.9f; // aims this far below the target so a spike doesn't miss it right away
+    float tolerance = 0.08f; // frame times this close to the aim don't change the scale
+    uint32_t settleFrames = 4; // samples ignored after a change, the frames in flight still used the old scale
+};
+
+class DynamicResolution {
+public:
+    void configure(const DynamicResolutionSettings& settings) {
+        settings_ = settings;
+        scale_ = settings.maxScale;
+        smoothedMilliseconds_ = 0.0f;
+        settle_ = 0;
+    }
+
+    float scale() const { return scale_; }
+
+    uint32_t scaled(uint32_t size) const {
+        return std::max(1u, static_cast<uint32_t>(size * scale_ + 0.5f));
+    }
+
+    // one finished frame, with the scale it was rendered at. returns true if the scale changed
+    bool addSample(float gpuMilliseconds, float renderedScale) {
+        if (renderedScale != scale_) return false; // from before the last change
+        if (settle_ > 0) {
+            settle_--;
+            return false;
+        }
+        smoothedMilliseconds_ = smoothedMilliseconds_ == 0.0f ? gpuMilliseconds : smoothedMilliseconds_ + (gpuMilliseconds - smoothedMilliseconds_) * SMOOTHING;
+
+        float aim = settings_.targetMilliseconds * settings_.headroom;
+        if (std::fabs(smoothedMilliseconds_ - aim) < aim * settings_.tolerance) return false;
+
+        // the cost mostly scales with the pixel count, so with the square of the scale. big jumps are
+        // halved so one slow frame can't drop it all the way
+        float wanted = scale_ * std::sqrt(aim / smoothedMilliseconds_);
+        float next = scale_ + (wanted - scale_) * 0.5f;
+        next = std::round(next * SCALE_STEPS) / SCALE_STEPS;
+        next = std::min(std::max(next, settings_.minScale), settings_.maxScale);
+        if (next == scale_) return false;
+
+        // the frame time at the new scale is unknown, guess it from the same model so the smoothing starts close
+        smoothedMilliseconds_ *= (next * next) / (scale_ * scale_);
+        scale_ = next;
+        settle_ = settings_.settleFrames;
+        return true;
+    }
+
+private:
+    static constexpr float SMOOTHING = 0.15f;
+    static constexpr float SCALE_STEPS = 64.0f; // scales are multiples of 1/64, so noise doesn't move the viewport every frame
+
+    DynamicResolutionSettings settings_;
+    float scale_ = 1.0f;
+    float smoothedMilliseconds_ = 0.0f;
+    uint32_t settle_ = 0;
+};
+
+}
+
+#endif /* DynamicResolution_hpp */
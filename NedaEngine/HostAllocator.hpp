@@ -0,0 +1,376 @@
+//
+//  HostAllocator.hpp
+//  NedaEngine
+//
+//  VkAllocationCallbacks for the driver's host memory. Command scope allocations only live for the
+//  duration of one vulkan call, so they come from a linear arena that is reset every frame. Small
+//  object scope allocations come from pooled blocks, everything else from the heap. All of it is
+//  counted by scope and by the type of object that was being created.
+
+#ifndef HostAllocator_hpp
+#define HostAllocator_hpp
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+namespace neda {
+
+class HostAllocator {
+public:
+    static const uint32_t SCOPE_COUNT = VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE + 1;
+    static const uint32_t OBJECT_TYPE_COUNT = 29; // the core types plus the surface, swapchain and debug messenger
+
+    struct Counters {
+        std::atomic<uint64_t> allocations{0};
+        std::atomic<uint64_t> reallocations{0};
+        std::atomic<uint64_t> frees{0};
+        std::atomic<int64_t> liveBytes{0};
+        std::atomic<int64_t> peakBytes{0};
+    };
+
+    explicit HostAllocator(size_t arenaCapacity = 1 << 20) : arenaCapacity_(std::min(arenaCapacity, size_t(ARENA_OFFSET_MASK))) {
+        arena_ = static_cast<uint8_t*>(std::malloc(arenaCapacity_));
+        for (uint32_t type = 0; type < OBJECT_TYPE_COUNT; type++) {
+            contexts_[type].allocator = this;
+            contexts_[type].objectType = type;
+
+            VkAllocationCallbacks& callbacks = callbacks_[type];
+            callbacks.pUserData = &contexts_[type];
+            callbacks.pfnAllocation = &HostAllocator::allocationCallback;
+            callbacks.pfnReallocation = &HostAllocator::reallocationCallback;
+            callbacks.pfnFree = &HostAllocator::freeCallback;
+            callbacks.pfnInternalAllocation = &HostAllocator::internalAllocationCallback;
+            callbacks.pfnInternalFree = &HostAllocator::internalFreeCallback;
+        }
+    }
+
+    ~HostAllocator() {
+        std::free(arena_);
+        for (auto& sizeClass : pools_) {
+            for (void* chunk : sizeClass.chunks) {
+                std::free(chunk);
+            }
+        }
+    }
+
+    HostAllocator(const HostAllocator&) = delete;
+    HostAllocator& operator=(const HostAllocator&) = delete;
+
+    // what to pass as pAllocator, the object type is only for the counters. the destroy call has to get
+    // callbacks from the same allocator, the type doesn't have to match
+    const VkAllocationCallbacks* callbacks(VkObjectType objectType) const {
+        return &callbacks_[objectTypeSlot(objectType)];
+    }
+
+    // called once per frame from the thread that drives vulkan. command scope allocations are all freed
+    // by the time their call returns, the check is just in case a driver thread is still inside one. the
+    // offset and the live count are one word, so the reset can't race an allocation that bumped the offset
+    // but hasn't counted itself yet
+    void beginFrame() {
+        frameAllocations_.store(0, std::memory_order_relaxed);
+        uint64_t state = arenaState_.load(std::memory_order_acquire);
+        frameArenaBytes_.store(size_t(state & ARENA_OFFSET_MASK), std::memory_order_relaxed);
+        while ((state >> ARENA_LIVE_SHIFT) == 0) {
+            if (arenaState_.compare_exchange_weak(state, 0, std::memory_order_acq_rel, std::memory_order_acquire)) {
+                return;
+            }
+        }
+        skippedArenaResets_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    const Counters& counters(VkSystemAllocationScope scope, VkObjectType objectType) const {
+        return counters_[scope][objectTypeSlot(objectType)];
+    }
+
+    // every allocation and reallocation since the last beginFrame, the churn this is meant to make visible
+    uint64_t frameAllocations() const { return frameAllocations_.load(std::memory_order_relaxed); }
+    // how much of the arena the previous frame used
+    size_t frameArenaBytes() const { return frameArenaBytes_.load(std::memory_order_relaxed); }
+
+    void printReport(std::ostream& out) const {
+        static const char* scopeNames[SCOPE_COUNT] = {"command", "object", "cache", "device", "instance"};
+
+        out << "host allocations by scope and object type (allocs / reallocs / frees / live bytes / peak bytes)" << std::endl;
+        for (uint32_t scope = 0; scope < SCOPE_COUNT; scope++) {
+            for (uint32_t type = 0; type < OBJECT_TYPE_COUNT; type++) {
+                const Counters& c = counters_[scope][type];
+                if (c.allocations.load() == 0) continue;
+                out << "  " << scopeNames[scope] << " " << objectTypeName(type) << ": " << c.allocations.load() << " / "
+                    << c.reallocations.load() << " / " << c.frees.load() << " / " << c.liveBytes.load() << " / " << c.peakBytes.load() << std::endl;
+            }
+        }
+        out << "  arena overflows to the heap: " << arenaOverflows_.load() << ", skipped arena resets: " << skippedArenaResets_.load() << std::endl;
+        out << "  driver internal allocations: " << internalAllocations_.load() << ", live internal bytes: " << internalLiveBytes_.load() << std::endl;
+    }
+
+private:
+    enum Source : uint32_t { SOURCE_ARENA, SOURCE_POOL, SOURCE_HEAP };
+
+    // sits right in front of every pointer handed to the driver, the free callback only gets the pointer
+    struct Header {
+        uint64_t size;
+        uint32_t offset; // from the start of the underlying block to the user pointer
+        uint32_t source;
+        uint32_t scope;
+        uint32_t objectType;
+        uint32_t sizeClass;
+        uint32_t pad;
+    };
+    static_assert(sizeof(Header) == 32, "the header has to keep 16 byte alignment");
+
+    struct Context {
+        HostAllocator* allocator;
+        uint32_t objectType;
+    };
+
+    // power of two blocks from 64 bytes to 4k, carved out of 64k chunks
+    static const uint32_t POOL_CLASS_COUNT = 7;
+    static const uint32_t MIN_POOL_BLOCK = 64;
+    static const size_t POOL_CHUNK_SIZE = 64 * 1024;
+    static const size_t MAX_POOL_ALIGNMENT = 32; // blocks are 64 aligned and the header takes 32
+
+    struct SizeClass {
+        std::mutex mutex;
+        void* freeList = nullptr; // the first bytes of a free block point to the next one
+        std::vector<void*> chunks;
+    };
+
+    static uint32_t objectTypeSlot(VkObjectType objectType) {
+        if (objectType <= VK_OBJECT_TYPE_COMMAND_POOL) return objectType;
+        switch (objectType) {
+            case VK_OBJECT_TYPE_SURFACE_KHR: return 26;
+            case VK_OBJECT_TYPE_SWAPCHAIN_KHR: return 27;
+            case VK_OBJECT_TYPE_DEBUG_UTILS_MESSENGER_EXT: return 28;
+            default: return VK_OBJECT_TYPE_UNKNOWN;
+        }
+    }
+
+    static const char* objectTypeName(uint32_t slot) {
+        static const char* names[OBJECT_TYPE_COUNT] = {
+            "unknown", "instance", "physical device", "device", "queue", "semaphore", "command buffer", "fence",
+            "device memory", "buffer", "image", "event", "query pool", "buffer view", "image view", "shader module",
+            "pipeline cache", "pipeline layout", "render pass", "pipeline", "descriptor set layout", "sampler",
+            "descriptor pool", "descriptor set", "framebuffer", "command pool", "surface", "swapchain", "debug messenger",
+        };
+        return names[slot];
+    }
+
+    static Header* headerOf(void* memory) {
+        return reinterpret_cast<Header*>(static_cast<uint8_t*>(memory) - sizeof(Header));
+    }
+
+    static uintptr_t alignUp(uintptr_t value, size_t alignment) {
+        return (value + alignment - 1) & ~(uintptr_t(alignment) - 1);
+    }
+
+    static void* allocationCallback(void* userData, size_t size, size_t alignment, VkSystemAllocationScope scope) {
+        Context* context = static_cast<Context*>(userData);
+        return context->allocator->allocate(size, alignment, scope, context->objectType);
+    }
+
+    static void* reallocationCallback(void* userData, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope) {
+        Context* context = static_cast<Context*>(userData);
+        return context->allocator->reallocate(original, size, alignment, scope, context->objectType);
+    }
+
+    static void freeCallback(void* userData, void* memory) {
+        static_cast<Context*>(userData)->allocator->free(memory);
+    }
+
+    static void internalAllocationCallback(void* userData, size_t size, VkInternalAllocationType, VkSystemAllocationScope) {
+        HostAllocator* allocator = static_cast<Context*>(userData)->allocator;
+        allocator->internalAllocations_.fetch_add(1, std::memory_order_relaxed);
+        allocator->internalLiveBytes_.fetch_add(int64_t(size), std::memory_order_relaxed);
+    }
+
+    static void internalFreeCallback(void* userData, size_t size, VkInternalAllocationType, VkSystemAllocationScope) {
+        static_cast<Context*>(userData)->allocator->internalLiveBytes_.fetch_sub(int64_t(size), std::memory_order_relaxed);
+    }
+
+    void* allocate(size_t size, size_t alignment, VkSystemAllocationScope scope, uint32_t objectType) {
+        if (size == 0) return nullptr;
+        alignment = std::max(alignment, size_t(16));
+
+        void* memory = nullptr;
+        if (scope == VK_SYSTEM_ALLOCATION_SCOPE_COMMAND) {
+            memory = allocateFromArena(size, alignment);
+        }
+        if (memory == nullptr && scope == VK_SYSTEM_ALLOCATION_SCOPE_OBJECT) {
+            memory = allocateFromPool(size, alignment);
+        }
+        if (memory == nullptr) {
+            memory = allocateFromHeap(size, alignment);
+            if (memory == nullptr) return nullptr;
+        }
+
+        Header* header = headerOf(memory);
+        header->size = size;
+        header->scope = scope;
+        header->objectType = objectType;
+
+        Counters& c = counters_[scope][objectType];
+        c.allocations.fetch_add(1, std::memory_order_relaxed);
+        addLiveBytes(c, int64_t(size));
+        frameAllocations_.fetch_add(1, std::memory_order_relaxed);
+        return memory;
+    }
+
+    void* reallocate(void* original, size_t size, size_t alignment, VkSystemAllocationScope scope, uint32_t objectType) {
+        if (original == nullptr) return allocate(size, alignment, scope, objectType);
+        if (size == 0) {
+            free(original);
+            return nullptr;
+        }
+
+        Header* oldHeader = headerOf(original);
+        void* memory = allocate(size, alignment, scope, objectType);
+        if (memory == nullptr) return nullptr; // the original stays valid on failure
+        std::memcpy(memory, original, std::min<size_t>(size, oldHeader->size));
+
+        // counted as a reallocation instead of an allocation plus a free
+        Counters& c = counters_[scope][objectType];
+        c.allocations.fetch_sub(1, std::memory_order_relaxed);
+        c.reallocations.fetch_add(1, std::memory_order_relaxed);
+        counters_[oldHeader->scope][oldHeader->objectType].frees.fetch_sub(1, std::memory_order_relaxed);
+        free(original);
+        return memory;
+    }
+
+    void free(void* memory) {
+        if (memory == nullptr) return;
+
+        Header* header = headerOf(memory);
+        Counters& c = counters_[header->scope][header->objectType];
+        c.frees.fetch_add(1, std::memory_order_relaxed);
+        c.liveBytes.fetch_sub(int64_t(header->size), std::memory_order_relaxed);
+
+        uint8_t* block = static_cast<uint8_t*>(memory) - header->offset;
+        switch (header->source) {
+            case SOURCE_ARENA:
+                // the arena is reset as a whole, this just lets beginFrame know nothing points into it anymore
+                arenaState_.fetch_sub(uint64_t(1) << ARENA_LIVE_SHIFT, std::memory_order_release);
+                break;
+            case SOURCE_POOL: {
+                SizeClass& sizeClass = pools_[header->sizeClass];
+                std::lock_guard<std::mutex> lock(sizeClass.mutex);
+                *reinterpret_cast<void**>(block) = sizeClass.freeList;
+                sizeClass.freeList = block;
+                break;
+            }
+            default:
+                std::free(block);
+                break;
+        }
+    }
+
+    void* allocateFromArena(size_t size, size_t alignment) {
+        uintptr_t base = reinterpret_cast<uintptr_t>(arena_);
+        uint64_t state = arenaState_.load(std::memory_order_relaxed);
+        size_t offset;
+        size_t userOffset;
+        size_t end;
+        do {
+            offset = size_t(state & ARENA_OFFSET_MASK);
+            userOffset = alignUp(base + offset + sizeof(Header), alignment) - base;
+            end = userOffset + size;
+            if (end > arenaCapacity_) {
+                arenaOverflows_.fetch_add(1, std::memory_order_relaxed);
+                return nullptr;
+            }
+        } while (!arenaState_.compare_exchange_weak(state, state + (uint64_t(1) << ARENA_LIVE_SHIFT) + (end - offset), std::memory_order_acq_rel));
+
+        void* memory = arena_ + userOffset;
+        Header* header = headerOf(memory);
+        header->offset = uint32_t(userOffset - offset);
+        header->source = SOURCE_ARENA;
+        return memory;
+    }
+
+    void* allocateFromPool(size_t size, size_t alignment) {
+        if (alignment > MAX_POOL_ALIGNMENT) return nullptr;
+
+        uint32_t classIndex = 0;
+        size_t blockSize = MIN_POOL_BLOCK;
+        while (blockSize < size + sizeof(Header)) {
+            blockSize *= 2;
+            classIndex++;
+        }
+        if (classIndex >= POOL_CLASS_COUNT) return nullptr;
+
+        SizeClass& sizeClass = pools_[classIndex];
+        uint8_t* block;
+        {
+            std::lock_guard<std::mutex> lock(sizeClass.mutex);
+            if (sizeClass.freeList == nullptr) {
+                void* chunk = std::malloc(POOL_CHUNK_SIZE + MIN_POOL_BLOCK);
+                if (chunk == nullptr) return nullptr;
+                sizeClass.chunks.push_back(chunk);
+
+                uint8_t* first = reinterpret_cast<uint8_t*>(alignUp(reinterpret_cast<uintptr_t>(chunk), MIN_POOL_BLOCK));
+                for (size_t i = POOL_CHUNK_SIZE / blockSize; i-- > 0;) {
+                    uint8_t* freeBlock = first + i * blockSize;
+                    *reinterpret_cast<void**>(freeBlock) = sizeClass.freeList;
+                    sizeClass.freeList = freeBlock;
+                }
+            }
+            block = static_cast<uint8_t*>(sizeClass.freeList);
+            sizeClass.freeList = *reinterpret_cast<void**>(block);
+        }
+
+        void* memory = block + sizeof(Header);
+        Header* header = headerOf(memory);
+        header->offset = sizeof(Header);
+        header->source = SOURCE_POOL;
+        header->sizeClass = classIndex;
+        return memory;
+    }
+
+    void* allocateFromHeap(size_t size, size_t alignment) {
+        uint8_t* block = static_cast<uint8_t*>(std::malloc(size + alignment + sizeof(Header)));
+        if (block == nullptr) return nullptr;
+
+        void* memory = reinterpret_cast<void*>(alignUp(reinterpret_cast<uintptr_t>(block) + sizeof(Header), alignment));
+        Header* header = headerOf(memory);
+        header->offset = uint32_t(static_cast<uint8_t*>(memory) - block);
+        header->source = SOURCE_HEAP;
+        return memory;
+    }
+
+    static void addLiveBytes(Counters& c, int64_t size) {
+        int64_t live = c.liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+        int64_t peak = c.peakBytes.load(std::memory_order_relaxed);
+        while (live > peak && !c.peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+    }
+
+    VkAllocationCallbacks callbacks_[OBJECT_TYPE_COUNT];
+    Context contexts_[OBJECT_TYPE_COUNT];
+    Counters counters_[SCOPE_COUNT][OBJECT_TYPE_COUNT];
+
+    uint8_t* arena_;
+    size_t arenaCapacity_;
+    // live allocations in the high half, the offset in the low half
+    static const uint32_t ARENA_LIVE_SHIFT = 32;
+    static const uint64_t ARENA_OFFSET_MASK = (uint64_t(1) << ARENA_LIVE_SHIFT) - 1;
+    std::atomic<uint64_t> arenaState_{0};
+    std::atomic<uint64_t> arenaOverflows_{0};
+    std::atomic<uint64_t> skippedArenaResets_{0};
+
+    SizeClass pools_[POOL_CLASS_COUNT];
+
+    std::atomic<uint64_t> frameAllocations_{0};
+    std::atomic<size_t> frameArenaBytes_{0};
+    std::atomic<uint64_t> internalAllocations_{0};
+    std::atomic<int64_t> internalLiveBytes_{0};
+};
+
+}
+
+#endif /* HostAllocator_hpp */
@@ -0,0 +1,436 @@
+//
+//  JobSystem.hpp
+//  NedaEngine
+//
+//  Work-stealing job system: every thread (the main thread is thread 0) owns a
+//  Chase-Lev deque, pushes and pops its own jobs from the bottom, and steals from
+//  the top of other threads' deques when it runs dry. Completion is tracked with
+//  JobCounters, and waiting on a counter runs other jobs instead of blocking.
+
+#ifndef JobSystem_hpp
+#define JobSystem_hpp
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "Profiler.hpp"
+
+namespace neda {
+
+// number of jobs that are scheduled but not finished yet, jobs decrement it when they are done
+struct JobCounter {
+    std::atomic<uint32_t> value{0};
+
+    bool isDone() const { return value.load(std::memory_order_acquire) == 0; }
+};
+
+class JobSystem {
+public:
+    using JobFunction = std::function<void()>;
+
+    // workerCount == 0 picks one worker per hardware thread, minus the main thread
+    explicit JobSystem(uint32_t workerCount = 0) {
+        if (workerCount == 0) {
+            uint32_t hardwareThreads = std::thread::hardware_concurrency();
+            workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+        }
+
+        threadCount_ = workerCount + 1;
+        queues_.reserve(threadCount_);
+        jobPools_.reserve(threadCount_);
+        for (uint32_t i = 0; i < threadCount_; i++) {
+            queues_.emplace_back(new WorkStealingQueue());
+            jobPools_.emplace_back(new JobPool());
+        }
+
+        threadIndex() = 0; // the thread creating the system is the main thread
+        workers_.reserve(workerCount);
+        for (uint32_t i = 1; i < threadCount_; i++) {
+            workers_.emplace_back([this, i] { workerLoop(i); });
+        }
+    }
+
+    ~JobSystem() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex_);
+            running_.store(false);
+        }
+        sleepCondition_.notify_all();
+        for (auto& worker : workers_) {
+            worker.join();
+        }
+    }
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // workers plus the main thread, use this to size per-thread resources like command pools
+    uint32_t threadCount() const { return threadCount_; }
+
+    // 0 on the main thread, 1..threadCount()-1 on the workers
+    static uint32_t currentThreadIndex() { return threadIndex(); }
+
+    // jobs may only be scheduled from the main thread or from inside other jobs
+    void schedule(JobFunction function, JobCounter* counter = nullptr) {
+        if (counter != nullptr) {
+            counter->value.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        uint32_t thread = currentThreadIndex();
+        Job* job = jobPools_[thread]->allocate();
+        if (job == nullptr) {
+            // every slot is queued or still running, so just run it here
+            function();
+            if (counter != nullptr) {
+                counter->value.fetch_sub(1, std::memory_order_release);
+            }
+            return;
+        }
+        job->function = std::move(function);
+        job->counter = counter;
+
+        if (!queues_[thread]->push(job)) {
+            execute(job); // our deque is full, so just run it here
+            return;
+        }
+
+        queuedJobs_.fetch_add(1, std::memory_order_seq_cst);
+        if (sleepingWorkers_.load(std::memory_order_seq_cst) > 0) {
+            std::lock_guard<std::mutex> lock(sleepMutex_);
+            sleepCondition_.notify_one();
+        }
+    }
+
+    // runs other jobs until every job attached to the counter has finished
+    void wait(const JobCounter& counter) {
+        uint32_t thread = currentThreadIndex();
+        while (!counter.isDone()) {
+            Job* job = findJob(thread);
+            if (job != nullptr) {
+                execute(job);
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    // splits [0, count) into batches of at least minBatchSize and runs function(begin, end) on each batch,
+    // the first exception thrown by a batch gets rethrown here once every batch is done
+    void parallelFor(uint32_t count, uint32_t minBatchSize, const std::function<void(uint32_t begin, uint32_t end)>& function) {
+        if (count == 0) return;
+
+        // a few batches per thread so a slow batch can be balanced out by stealing
+        uint32_t batchSize = std::max(minBatchSize, (count + threadCount_ * 4 - 1) / (threadCount_ * 4));
+        if (batchSize >= count) {
+            function(0, count);
+            return;
+        }
+
+        JobCounter counter;
+        ExceptionSlot exception;
+        for (uint32_t begin = 0; begin < count; begin += batchSize) {
+            uint32_t end = std::min(count, begin + batchSize);
+            schedule([&function, &exception, begin, end] {
+                try {
+                    function(begin, end);
+                } catch (...) {
+                    exception.capture();
+                }
+            }, &counter);
+        }
+        wait(counter);
+        exception.rethrow();
+    }
+
+    // keeps the first exception thrown by a group of jobs, an exception escaping a worker would terminate the app
+    class ExceptionSlot {
+    public:
+        void capture() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!exception_) {
+                exception_ = std::current_exception();
+            }
+            failed_.store(true, std::memory_order_release);
+        }
+
+        bool failed() const { return failed_.load(std::memory_order_acquire); }
+
+        void rethrow() {
+            if (failed()) {
+                std::rethrow_exception(exception_);
+            }
+        }
+
+    private:
+        std::mutex mutex_;
+        std::exception_ptr exception_;
+        std::atomic<bool> failed_{false};
+    };
+
+private:
+    struct JobPool;
+
+    struct Job {
+        JobFunction function;
+        JobCounter* counter = nullptr;
+        JobPool* pool = nullptr;
+        Job* next = nullptr; // in the pool's free list
+    };
+
+    // jobs live in a per-thread pool so scheduling doesn't hit the heap. only the owner allocates, but any thread
+    // can finish a job, so finished slots go onto a shared stack that the owner takes over whole once its own
+    // free list runs out. a slot is only handed out again after the job in it has run
+    struct JobPool {
+        static const uint32_t CAPACITY = 4096;
+        Job jobs[CAPACITY];
+        Job* free = nullptr; // owner only
+        std::atomic<Job*> released{nullptr};
+
+        JobPool() {
+            for (uint32_t i = CAPACITY; i > 0; i--) {
+                jobs[i - 1].pool = this;
+                jobs[i - 1].next = free;
+                free = &jobs[i - 1];
+            }
+        }
+
+        // nullptr when every slot is in use
+        Job* allocate() {
+            if (free == nullptr) {
+                free = released.exchange(nullptr, std::memory_order_acquire);
+            }
+            Job* job = free;
+            if (job != nullptr) {
+                free = job->next;
+            }
+            return job;
+        }
+
+        void release(Job* job) {
+            Job* head = released.load(std::memory_order_relaxed);
+            do {
+                job->next = head;
+            } while (!released.compare_exchange_weak(head, job, std::memory_order_release, std::memory_order_relaxed));
+        }
+    };
+
+    // Chase-Lev deque as described in "Correct and Efficient Work-Stealing for Weak Memory Models" (Le et al. 2013)
+    // the owner thread pushes and pops at the bottom, every other thread steals from the top
+    class WorkStealingQueue {
+    public:
+        static const int64_t CAPACITY = 4096;
+
+        bool push(Job* job) {
+            int64_t bottom = bottom_.load(std::memory_order_relaxed);
+            int64_t top = top_.load(std::memory_order_acquire);
+            if (bottom - top >= CAPACITY) {
+                return false;
+            }
+
+            buffer_[bottom & (CAPACITY - 1)].store(job, std::memory_order_relaxed);
+            bottom_.store(bottom + 1, std::memory_order_release);
+            return true;
+        }
+
+        Job* pop() {
+            int64_t bottom = bottom_.load(std::memory_order_relaxed) - 1;
+            bottom_.store(bottom, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t top = top_.load(std::memory_order_relaxed);
+
+            if (top > bottom) { // empty
+                bottom_.store(bottom + 1, std::memory_order_relaxed);
+                return nullptr;
+            }
+
+            Job* job = buffer_[bottom & (CAPACITY - 1)].load(std::memory_order_relaxed);
+            if (top == bottom) { // last job, race the thieves for it
+                if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                    job = nullptr;
+                }
+                bottom_.store(bottom + 1, std::memory_order_relaxed);
+            }
+            return job;
+        }
+
+        Job* steal() {
+            int64_t top = top_.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t bottom = bottom_.load(std::memory_order_acquire);
+
+            if (top >= bottom) {
+                return nullptr;
+            }
+
+            Job* job = buffer_[top & (CAPACITY - 1)].load(std::memory_order_relaxed);
+            if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                return nullptr; // another thief or the owner got it first
+            }
+            return job;
+        }
+
+    private:
+        // keep the owner's end and the thieves' end on separate cache lines
+        std::atomic<int64_t> top_{0};
+        char topPadding_[64 - sizeof(std::atomic<int64_t>)];
+        std::atomic<int64_t> bottom_{0};
+        char bottomPadding_[64 - sizeof(std::atomic<int64_t>)];
+        std::atomic<Job*> buffer_[CAPACITY];
+    };
+
+    static uint32_t& threadIndex() {
+        static thread_local uint32_t index = 0;
+        return index;
+    }
+
+    Job* findJob(uint32_t thread) {
+        Job* job = queues_[thread]->pop();
+        if (job == nullptr) {
+            // start at a random victim so the thieves don't all pile onto the same deque
+            static thread_local std::minstd_rand random(std::random_device{}());
+            uint32_t start = static_cast<uint32_t>(random());
+            for (uint32_t i = 0; i < threadCount_ && job == nullptr; i++) {
+                uint32_t victim = (start + i) % threadCount_;
+                if (victim != thread) {
+                    job = queues_[victim]->steal();
+                }
+            }
+        }
+
+        if (job != nullptr) {
+            queuedJobs_.fetch_sub(1, std::memory_order_relaxed);
+        }
+        return job;
+    }
+
+    void execute(Job* job) {
+        JobCounter* counter = job->counter;
+        job->function();
+        job->function = nullptr; // drop captures now instead of when the slot gets reused
+        job->pool->release(job);
+        if (counter != nullptr) {
+            counter->value.fetch_sub(1, std::memory_order_release);
+        }
+    }
+
+    void workerLoop(uint32_t thread) {
+        threadIndex() = thread;
+        NEDA_PROFILE_THREAD("job worker " + std::to_string(thread), thread);
+
+        while (running_.load(std::memory_order_relaxed)) {
+            Job* job = findJob(thread);
+            if (job != nullptr) {
+                execute(job);
+                continue;
+            }
+
+            // nothing to steal, sleep until a job gets scheduled
+            std::unique_lock<std::mutex> lock(sleepMutex_);
+            sleepingWorkers_.fetch_add(1, std::memory_order_seq_cst);
+            sleepCondition_.wait(lock, [this] {
+                return queuedJobs_.load(std::memory_order_seq_cst) > 0 || !running_.load(std::memory_order_relaxed);
+            });
+            sleepingWorkers_.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+
+    uint32_t threadCount_ = 1;
+    std::vector<std::unique_ptr<WorkStealingQueue>> queues_;
+    std::vector<std::unique_ptr<JobPool>> jobPools_;
+    std::vector<std::thread> workers_;
+
+    std::atomic<bool> running_{true};
+    std::atomic<int32_t> queuedJobs_{0};
+    std::atomic<uint32_t> sleepingWorkers_{0};
+    std::mutex sleepMutex_;
+    std::condition_variable sleepCondition_;
+};
+
+// a graph of tasks with dependency counters, a task gets scheduled once all the tasks before it are done
+class TaskGraph {
+public:
+    using TaskId = uint32_t;
+
+    TaskId addTask(const char* name, JobSystem::JobFunction function) {
+        tasks_.emplace_back(new Task());
+        tasks_.back()->name = name;
+        tasks_.back()->function = std::move(function);
+        return static_cast<TaskId>(tasks_.size() - 1);
+    }
+
+    // makes `after` wait until `before` has finished
+    void precede(TaskId before, TaskId after) {
+        tasks_[before]->successors.push_back(after);
+        tasks_[after]->dependencyCount++;
+    }
+
+    // schedules every task in dependency order and helps run them until the whole graph is done,
+    // if a task throws the tasks that haven't started yet are skipped and the exception is rethrown here
+    void execute(JobSystem& jobSystem) {
+        JobCounter counter;
+        JobSystem::ExceptionSlot exception;
+        exception_ = &exception;
+        for (auto& task : tasks_) {
+            task->remaining.store(task->dependencyCount, std::memory_order_relaxed);
+        }
+        for (TaskId i = 0; i < tasks_.size(); i++) {
+            if (tasks_[i]->dependencyCount == 0) {
+                scheduleTask(jobSystem, i, counter);
+            }
+        }
+        jobSystem.wait(counter);
+        exception_ = nullptr;
+        exception.rethrow();
+    }
+
+    void clear() {
+        tasks_.clear();
+    }
+
+    size_t size() const { return tasks_.size(); }
+
+private:
+    struct Task {
+        const char* name = nullptr;
+        JobSystem::JobFunction function;
+        std::vector<TaskId> successors;
+        uint32_t dependencyCount = 0;
+        std::atomic<uint32_t> remaining{0};
+    };
+
+    void scheduleTask(JobSystem& jobSystem, TaskId id, JobCounter& counter) {
+        jobSystem.schedule([this, &jobSystem, &counter, id] {
+            Task& task = *tasks_[id];
+            if (!exception_->failed()) {
+                NEDA_PROFILE_ZONE(task.name);
+                try {
+                    task.function();
+                } catch (...) {
+                    exception_->capture();
+                }
+            }
+            // successors get scheduled before this job drops the counter, so wait() can't return early
+            for (TaskId successor : task.successors) {
+                if (tasks_[successor]->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    scheduleTask(jobSystem, successor, counter);
+                }
+            }
+        }, &counter);
+    }
+
+    std::vector<std::unique_ptr<Task>> tasks_;
+    JobSystem::ExceptionSlot* exception_ = nullptr;
+};
+
+}
+
+#endif /* JobSystem_hpp */
@@ -0,0 +1,76 @@
+//
+//  Lighting.hpp
+//  NedaEngine
+//
+//  Clustered forward lighting: the view frustum is cut into a grid of clusters, screen tiles in x and y and
+//  exponential depth slices in z. A compute pass bins every light into the clusters it touches, and the
+//  fragment shader only loops over the lights of its own cluster. The structs here match cluster.comp and shader.frag.
+
+#ifndef Lighting_hpp
+#define Lighting_hpp
+
+#include <cmath>
+#include <cstdint>
+
+#include "Math.hpp"
+
+namespace neda {
+
+struct ClusterGrid {
+    static const uint32_t SIZE_X = 16;
+    static const uint32_t SIZE_Y = 9;
+    static const uint32_t SIZE_Z = 24;
+    static const uint32_t COUNT = SIZE_X * SIZE_Y * SIZE_Z;
+    static const uint32_t MAX_LIGHTS_PER_CLUSTER = 256; // lights past this are dropped from the cluster
+    static const uint32_t BINNING_GROUP_SIZE = 128; // clusters per workgroup, also the lights loaded into shared memory at once
+};
+
+// a spot light, point lights have cosOuter = -1 so every direction is inside the cone. std430, 48 bytes
+struct GpuLight {
+    Vec3 position;
+    float radius; // the light reaches exactly 0 here
+    Vec3 color; // premultiplied by the intensity
+    float cosInner;
+    Vec3 direction;
+    float cosOuter;
+};
+static_assert(sizeof(GpuLight) == 48, "GpuLight has to match the shaders' std430 layout");
+
+// per frame uniform for the binning and the shading, std140
+struct ClusterParams {
+    Mat4 view;
+    float projectionScale[2]; // projection[0][0] and [1][1], turns a tile's ndc corners into view space
+    float nearPlane;
+    float farPlane;
+    uint32_t gridSize[3];
+    uint32_t lightCount;
+    float screenSize[2];
+    float sliceScale; // slice = log(depth) * sliceScale + sliceBias
+    float sliceBias;
+};
+static_assert(sizeof(ClusterParams) == 112, "ClusterParams has to match the shaders' std140 layout");
+
+inline ClusterParams makeClusterParams(const Mat4& view, const Mat4& projection, float nearPlane, float farPlane,
+                                       uint32_t lightCount, float screenWidth, float screenHeight) {
+    ClusterParams params{};
+    params.view = view;
+    params.projectionScale[0] = projection.m[0];
+    params.projectionScale[1] = projection.m[5];
+    params.nearPlane = nearPlane;
+    params.farPlane = farPlane;
+    params.gridSize[0] = ClusterGrid::SIZE_X;
+    params.gridSize[1] = ClusterGrid::SIZE_Y;
+    params.gridSize[2] = ClusterGrid::SIZE_Z;
+    params.lightCount = lightCount;
+    params.screenSize[0] = screenWidth;
+    params.screenSize[1] = screenHeight;
+    // exponential slices, every slice is the same factor deeper than the one in front of it
+    float logRange = std::log(farPlane / nearPlane);
+    params.sliceScale = ClusterGrid::SIZE_Z / logRange;
+    params.sliceBias = -ClusterGrid::SIZE_Z * std::log(nearPlane) / logRange;
+    return params;
+}
+
+}
+
+#endif /* Lighting_hpp */
@@ -0,0 +1,121 @@
+//
+//  Math.hpp
+//  NedaEngine
+//
+//  The bits of vector and matrix math the renderer needs. Matrices are column major
+//  like GLSL, and the projection uses Vulkan's clip space (y down, depth 0 to 1).
+
+#ifndef Math_hpp
+#define Math_hpp
+
+#include <cmath>
+
+namespace neda {
+
+const float PI = 3.14159265358979f;
+
+struct Vec3 {
+    float x = 0.0f, y = 0.0f, z = 0.0f;
+
+    Vec3() = default;
+    Vec3(float x, float y, float z) : x(x), y(y), z(z) {}
+
+    Vec3 operator+(const Vec3& o) const { return {x + o.x, y + o.y, z + o.z}; }
+    Vec3 operator-(const Vec3& o) const { return {x - o.x, y - o.y, z - o.z}; }
+    Vec3 operator*(float s) const { return {x * s, y * s, z * s}; }
+    Vec3 operator-() const { return {-x, -y, -z}; }
+    Vec3& operator+=(const Vec3& o) { x += o.x; y += o.y; z += o.z; return *this; }
+};
+
+inline float dot(const Vec3& a, const Vec3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+inline Vec3 cross(const Vec3& a, const Vec3& b) { return {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x}; }
+inline float length(const Vec3& v) { return std::sqrt(dot(v, v)); }
+inline Vec3 normalize(const Vec3& v) { return v * (1.0f / length(v)); }
+
+struct Vec4 {
+    float x = 0.0f, y = 0.0f, z = 0.0f, w = 0.0f;
+
+    Vec4() = default;
+    Vec4(float x, float y, float z, float w) : x(x), y(y), z(z), w(w) {}
+    Vec4(const Vec3& v, float w) : x(v.x), y(v.y), z(v.z), w(w) {}
+
+    Vec3 xyz() const { return {x, y, z}; }
+};
+
+struct Mat4 {
+    float m[16]; // m[column * 4 + row]
+
+    static Mat4 identity() {
+        Mat4 result{};
+        result.m[0] = result.m[5] = result.m[10] = result.m[15] = 1.0f;
+        return result;
+    }
+
+    float& at(int row, int column) { return m[column * 4 + row]; }
+    float at(int row, int column) const { return m[column * 4 + row]; }
+
+    Mat4 operator*(const Mat4& o) const {
+        Mat4 result{};
+        for (int column = 0; column < 4; column++) {
+            for (int row = 0; row < 4; row++) {
+                float sum = 0.0f;
+                for (int k = 0; k < 4; k++) {
+                    sum += at(row, k) * o.at(k, column);
+                }
+                result.at(row, column) = sum;
+            }
+        }
+        return result;
+    }
+
+    Vec4 operator*(const Vec4& v) const {
+        return {
+            m[0] * v.x + m[4] * v.y + m[8] * v.z + m[12] * v.w,
+            m[1] * v.x + m[5] * v.y + m[9] * v.z + m[13] * v.w,
+            m[2] * v.x + m[6] * v.y + m[10] * v.z + m[14] * v.w,
+            m[3] * v.x + m[7] * v.y + m[11] * v.z + m[15] * v.w,
+        };
+    }
+
+    // right handed, depth goes 0 to 1 and y is flipped for vulkan's clip space
+    static Mat4 perspective(float fovY, float aspect, float nearPlane, float farPlane) {
+        float f = 1.0f / std::tan(fovY * 0.5f);
+        Mat4 result{};
+        result.m[0] = f / aspect;
+        result.m[5] = -f;
+        result.m[10] = farPlane / (nearPlane - farPlane);
+        result.m[11] = -1.0f;
+        result.m[14] = (farPlane * nearPlane) / (nearPlane - farPlane);
+        return result;
+    }
+
+    static Mat4 orthographic(float left, float right, float bottom, float top, float nearPlane, float farPlane) {
+        Mat4 result = identity();
+        result.m[0] = 2.0f / (right - left);
+        result.m[5] = -2.0f / (top - bottom);
+        result.m[10] = 1.0f / (nearPlane - farPlane);
+        result.m[12] = -(right + left) / (right - left);
+        result.m[13] = (top + bottom) / (top - bottom);
+        result.m[14] = nearPlane / (nearPlane - farPlane);
+        return result;
+    }
+
+    static Mat4 lookAt(const Vec3& eye, const Vec3& target, const Vec3& up) {
+        Vec3 forward = normalize(target - eye);
+        Vec3 side = normalize(cross(forward, up));
+        Vec3 realUp = cross(side, forward);
+
+        Mat4 result = identity();
+        result.m[0] = side.x;  result.m[4] = side.y;  result.m[8] = side.z;
+        result.m[1] = realUp.x; result.m[5] = realUp.y; result.m[9] = realUp.z;
+        result.m[2] = -forward.x; result.m[6] = -forward.y; result.m[10] = -forward.z;
+        result.m[12] = -dot(side, eye);
+        result.m[13] = -dot(realUp, eye);
+        result.m[14] = dot(forward, eye);
+        return result;
+    }
+};
+
+}
+
+#endif /* Math_hpp */
@@ -0,0 +1,159 @@
+//
+//  Meshlets.hpp
+//  NedaEngine
+//
+//  A big mesh cut into meshlets of at most 64 vertices and 124 triangles, so culling can drop the parts of it that
+//  can't be seen instead of drawing all of it whenever any of it is on screen. Every meshlet has a bounding sphere for
+//  the frustum and a cone around its triangles' normals: when the camera is behind every triangle in it, the whole
+//  meshlet faces away. meshlet_cull.comp runs both tests for every meshlet and writes the triangles of the ones that
+//  pass into one compacted index buffer, drawn with one indexed indirect draw. The limits and the layout, vertex
+//  indices plus byte sized triangle indices, are what mesh shaders are usually fed too. The structs here match
+//  meshlet_cull.comp.
+
+#ifndef Meshlets_hpp
+#define Meshlets_hpp
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "Math.hpp"
+
+namespace neda {
+
+struct MeshletConfig {
+    static const uint32_t MAX_VERTICES = 64;
+    static const uint32_t MAX_TRIANGLES = 124;
+    static const uint32_t GROUP_SIZE = 64; // one group per meshlet, its threads write the triangles
+};
+
+// std430
+struct Meshlet {
+    Vec3 center;
+    float radius;
+    Vec3 coneAxis; // the average of its triangles' normals
+    float coneCutoff; // sin of the angle between the axis and the normal furthest from it, 1 when it can't be culled
+    uint32_t vertexOffset; // into MeshletMesh::vertices
+    uint32_t triangleOffset; // into MeshletMesh::triangles, in bytes
+    uint32_t vertexCount;
+    uint32_t triangleCount;
+};
+static_assert(sizeof(Meshlet) == 48, "Meshlet has to match meshlet_cull.comp");
+
+struct MeshletMesh {
+    std::vector<Meshlet> meshlets;
+    std::vector<uint32_t> vertices; // the mesh's vertices every meshlet uses, one meshlet after the other
+    std::vector<uint8_t> triangles; // three indices into the meshlet's vertices per triangle, padded to whole uint32s
+    uint32_t triangleCount = 0;
+};
+
+struct MeshletCullPushConstants {
+    float planes[6][4];
+    Vec3 cameraPosition;
+    uint32_t meshletCount;
+};
+static_assert(sizeof(MeshletCullPushConstants) == 112, "MeshletCullPushConstants has to match meshlet_cull.comp");
+
+namespace detail {
+
+inline void finishMeshlet(const std::vector<Vec3>& positions, const std::vector<Vec3>& normals, MeshletMesh& mesh) {
+    Meshlet& meshlet = mesh.meshlets.back();
+    const uint32_t* vertices = mesh.vertices.data() + meshlet.vertexOffset;
+
+    // the box's center, which is close enough to the smallest sphere's for culling
+    Vec3 low = positions[vertices[0]];
+    Vec3 high = low;
+    for (uint32_t i = 1; i < meshlet.vertexCount; i++) {
+        const Vec3& p = positions[vertices[i]];
+        low = Vec3(std::min(low.x, p.x), std::min(low.y, p.y), std::min(low.z, p.z));
+        high = Vec3(std::max(high.x, p.x), std::max(high.y, p.y), std::max(high.z, p.z));
+    }
+    meshlet.center = (low + high) * 0.5f;
+    meshlet.radius = 0.0f;
+    for (uint32_t i = 0; i < meshlet.vertexCount; i++) {
+        meshlet.radius = std::max(meshlet.radius, length(positions[vertices[i]] - meshlet.center));
+    }
+
+    Vec3 sum(0.0f, 0.0f, 0.0f);
+    for (const Vec3& normal : normals) {
+        sum += normal;
+    }
+    meshlet.coneAxis = Vec3(0.0f, 1.0f, 0.0f);
+    meshlet.coneCutoff = 1.0f;
+    if (length(sum) < 1e-6f) return;
+    meshlet.coneAxis = normalize(sum);
+    float minimumDot = 1.0f;
+    for (const Vec3& normal : normals) {
+        minimumDot = std::min(minimumDot, dot(normal, meshlet.coneAxis));
+    }
+    // a cone of half a sphere or more has a triangle facing the camera from anywhere
+    if (minimumDot > 0.0f) {
+        meshlet.coneCutoff = std::sqrt(1.0f - minimumDot * minimumDot);
+    }
+}
+
+}
+
+// greedy in index order, a triangle goes into the current meshlet as long as its vertices and triangles fit. so the
+// meshlets are only as compact as the index order, which should keep triangles that are close together close in it
+inline MeshletMesh buildMeshlets(const std::vector<Vec3>& positions, const std::vector<uint32_t>& indices) {
+    const uint8_t UNUSED = 0xFF;
+    MeshletMesh mesh;
+    std::vector<uint8_t> localIndices(positions.size(), UNUSED);
+    std::vector<Vec3> normals; // the current meshlet's, for its cone
+
+    auto startMeshlet = [&] {
+        if (!mesh.meshlets.empty()) {
+            detail::finishMeshlet(positions, normals, mesh);
+            const Meshlet& last = mesh.meshlets.back();
+            for (uint32_t i = 0; i < last.vertexCount; i++) {
+                localIndices[mesh.vertices[last.vertexOffset + i]] = UNUSED;
+            }
+        }
+        Meshlet meshlet{};
+        meshlet.vertexOffset = static_cast<uint32_t>(mesh.vertices.size());
+        meshlet.triangleOffset = static_cast<uint32_t>(mesh.triangles.size());
+        mesh.meshlets.push_back(meshlet);
+        normals.clear();
+    };
+
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        const uint32_t corners[3] = {indices[i], indices[i + 1], indices[i + 2]};
+        uint32_t newVertices = 0;
+        for (uint32_t corner : corners) {
+            newVertices += localIndices[corner] == UNUSED ? 1 : 0;
+        }
+        if (mesh.meshlets.empty() || mesh.meshlets.back().vertexCount + newVertices > MeshletConfig::MAX_VERTICES ||
+            mesh.meshlets.back().triangleCount == MeshletConfig::MAX_TRIANGLES) {
+            startMeshlet();
+        }
+
+        Meshlet& meshlet = mesh.meshlets.back();
+        for (uint32_t corner : corners) {
+            if (localIndices[corner] == UNUSED) {
+                localIndices[corner] = static_cast<uint8_t>(meshlet.vertexCount++);
+                mesh.vertices.push_back(corner);
+            }
+            mesh.triangles.push_back(localIndices[corner]);
+        }
+        meshlet.triangleCount++;
+
+        // degenerate triangles don't face anywhere, they can't keep the meshlet from being culled
+        Vec3 normal = cross(positions[corners[1]] - positions[corners[0]], positions[corners[2]] - positions[corners[0]]);
+        if (length(normal) > 1e-12f) {
+            normals.push_back(normalize(normal));
+        }
+    }
+    if (!mesh.meshlets.empty()) {
+        detail::finishMeshlet(positions, normals, mesh);
+    }
+
+    mesh.triangleCount = static_cast<uint32_t>(mesh.triangles.size() / 3);
+    mesh.triangles.resize((mesh.triangles.size() + 3) & ~size_t(3), 0);
+    return mesh;
+}
+
+}
+
+#endif /* Meshlets_hpp */
@@ -0,0 +1,97 @@
+//
+//  Particles.hpp
+//  NedaEngine
+//
+//  GPU particles. The particles never leave the gpu: a dead list holds the free slots, emission pops from it
+//  and appends to the alive list, and the simulation walks the alive list, pushing survivors onto the other
+//  alive list (they swap every frame) and the dead ones back onto the dead list. The survivors are also
+//  written, compacted, into the frame's draw buffer along with the instance count of its indirect draw, so
+//  the cpu only ever says how many particles to emit. The structs here match particles.comp and particles.vert.
+
+#ifndef Particles_hpp
+#define Particles_hpp
+
+#include <cmath>
+#include <cstdint>
+
+#include "Math.hpp"
+
+namespace neda {
+
+struct ParticleConfig {
+    static const uint32_t CAPACITY = 1u << 20;
+    static const uint32_t GROUP_SIZE = 64; // local size of every pass in particles.comp
+    static const uint32_t EMITTER_COUNT = 4;
+};
+
+// what particles.comp does, picked with its specialization constant
+enum ParticlePass : uint32_t {
+    PARTICLE_PASS_INIT = 0, // once, puts every slot on the dead list
+    PARTICLE_PASS_BEGIN, // one thread, clamps the emission to the dead list and writes the dispatch and draw arguments
+    PARTICLE_PASS_EMIT,
+    PARTICLE_PASS_SIMULATE,
+    PARTICLE_PASS_COUNT,
+};
+
+// std430, 48 bytes
+struct GpuParticle {
+    Vec3 position;
+    float age;
+    Vec3 velocity;
+    float lifetime;
+    float color[4];
+};
+static_assert(sizeof(GpuParticle) == 48, "GpuParticle has to match particles.comp");
+
+// what the draw reads per instance, std430 and a vertex buffer at once
+struct ParticleInstance {
+    Vec3 position;
+    float size;
+    float color[4];
+};
+static_assert(sizeof(ParticleInstance) == 32, "ParticleInstance has to match particles.comp");
+
+// the state the passes share. the dispatch arguments are read by vkCmdDispatchIndirect, so they sit at 16 byte offsets
+struct ParticleCounters {
+    uint32_t aliveCount[2];
+    uint32_t deadCount;
+    uint32_t emitCount;
+    uint32_t emitDispatch[3];
+    uint32_t pad0;
+    uint32_t simulateDispatch[3];
+    uint32_t pad1;
+};
+static_assert(sizeof(ParticleCounters) == 48, "ParticleCounters has to match particles.comp");
+
+// the frame's draw buffer starts with its indirect draw, the instances follow
+const uint32_t PARTICLE_DRAW_HEADER_SIZE = 16;
+
+struct ParticlePushConstants {
+    float emitters[ParticleConfig::EMITTER_COUNT][4]; // xyz position, w how far the spawn spreads
+    float deltaTime;
+    float time;
+    uint32_t emitRequest; // clamped to the dead list on the gpu
+    uint32_t current; // which alive list the frame reads, the other one is written
+};
+static_assert(sizeof(ParticlePushConstants) <= 128, "ParticlePushConstants has to fit the guaranteed push constant size");
+
+// turns an emission rate into whole particles per frame, the fractions carry over
+class ParticleEmission {
+public:
+    explicit ParticleEmission(float particlesPerSecond) : rate_(particlesPerSecond) {}
+
+    uint32_t take(float deltaTime) {
+        carry_ += rate_ * deltaTime;
+        float whole = std::floor(carry_);
+        carry_ -= whole;
+        return static_cast<uint32_t>(whole);
+    }
+
+private:
+    float rate_;
+    float carry_ = 0.0f;
+};
+
+}
+
+#endif /* Particles_hpp */
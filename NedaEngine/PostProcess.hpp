@@ -0,0 +1,114 @@
+//
+//  PostProcess.hpp
+//  NedaEngine
+//
+//  The post chain from the hdr scene target to the swapchain, all in compute. The prefilter thresholds the scene
+//  into the first bloom mip and sums its log luminance for the auto exposure. A downsample per mip follows, then an
+//  upsample per mip back up that adds each level into the one above it. The composite does the rest in one go:
+//  it upscales the scene, adds the bloom, exposes, tonemaps and grades. The downsamples and upsamples load their
+//  source tile and its border into shared memory once, so overlapping filter taps never go back to the image.
+//  The structs here match post.comp.
+
+#ifndef PostProcess_hpp
+#define PostProcess_hpp
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace neda {
+
+struct PostConfig {
+    static const uint32_t GROUP_SIZE = 16; // every pass runs 16x16 groups
+    static const uint32_t MAX_BLOOM_MIPS = 6;
+    static const uint32_t MIN_BLOOM_MIP_SIZE = 8; // no mips smaller than this on the short side
+};
+
+// what post.comp does, picked with its specialization constant
+enum PostPass : uint32_t {
+    POST_PASS_PREFILTER = 0, // scene to the first bloom mip, half the swapchain's size
+    POST_PASS_EXPOSURE, // one thread, adapts the exposure to the prefilter's luminance
+    POST_PASS_DOWNSAMPLE,
+    POST_PASS_UPSAMPLE,
+    POST_PASS_COMPOSITE, // writes the swapchain image, or the image the upscale pass presents
+    POST_PASS_COUNT,
+};
+
+struct PostSettings {
+    float bloomThreshold = 1.0f; // brightest channel, before exposure
+    float bloomKnee = 0.5f; // the threshold fades in over this much below it
+    float bloomIntensity = 0.5f;
+    float exposureCompensation = 0.0f; // stops on top of the auto exposure
+    float adaptationRate = 1.5f; // per second
+    float minLuminance = 0.03f; // the average scene luminance the exposure adapts to is clamped to this range
+    float maxLuminance = 8.0f;
+    // asc cdl after the tonemap, pow(color * slope + offset, power), then the saturation
+    float slope[3] = {1.0f, 1.0f, 1.0f};
+    float offset[3] = {0.0f, 0.0f, 0.0f};
+    float power[3] = {1.0f, 1.0f, 1.0f};
+    float saturation = 1.0f;
+};
+
+// where the auto exposure keeps its state between frames, std430
+struct ExposureState {
+    float adaptedLuminance; // 0 until the first frame, which takes the measured one as is
+    float exposure;
+    uint32_t logLuminanceSum; // fixed point, see post.comp
+    uint32_t sampleCount;
+};
+static_assert(sizeof(ExposureState) == 16, "ExposureState has to match post.comp");
+
+struct PostPushConstants {
+    uint32_t sourceSize[2]; // the bloom mip the pass reads
+    uint32_t targetSize[2]; // what it writes
+    float uvScale[2]; // the rendered part of the scene target, see DynamicResolution.hpp
+    float uvMax[2];
+    float bloomThreshold;
+    float bloomKnee;
+    float bloomIntensity; // divided by the mip count, every mip adds about the same energy
+    float exposureCompensation;
+    float adaptation; // how much of the way to the measured luminance this frame goes
+    float minLuminance;
+    float maxLuminance;
+    float saturation;
+    float slope[4]; // std430 pads the grading to vec4s
+    float offset[4];
+    float power[4];
+};
+static_assert(sizeof(PostPushConstants) <= 128, "PostPushConstants has to fit the guaranteed push constant size");
+
+// the first mip is half the size, the chain stops before the short side gets below MIN_BLOOM_MIP_SIZE
+inline uint32_t bloomMipCount(uint32_t width, uint32_t height) {
+    uint32_t count = 1;
+    uint32_t size = std::min(width, height) / 4;
+    while (count < PostConfig::MAX_BLOOM_MIPS && size >= PostConfig::MIN_BLOOM_MIP_SIZE) {
+        count++;
+        size /= 2;
+    }
+    return count;
+}
+
+inline uint32_t bloomMipSize(uint32_t size, uint32_t mip) {
+    return std::max(1u, size >> (mip + 1));
+}
+
+// everything but the sizes, which change from pass to pass
+inline PostPushConstants makePostPushConstants(const PostSettings& settings, uint32_t mipCount, float deltaTime) {
+    PostPushConstants constants{};
+    constants.bloomThreshold = settings.bloomThreshold;
+    constants.bloomKnee = std::max(settings.bloomKnee, 1e-4f);
+    constants.bloomIntensity = settings.bloomIntensity / mipCount;
+    constants.exposureCompensation = settings.exposureCompensation;
+    constants.adaptation = 1.0f - std::exp(-deltaTime * settings.adaptationRate);
+    constants.minLuminance = settings.minLuminance;
+    constants.maxLuminance = settings.maxLuminance;
+    constants.saturation = settings.saturation;
+    std::copy(settings.slope, settings.slope + 3, constants.slope);
+    std::copy(settings.offset, settings.offset + 3, constants.offset);
+    std::copy(settings.power, settings.power + 3, constants.power);
+    return constants;
+}
+
+}
+
+#endif /* PostProcess_hpp */
@@ -0,0 +1,379 @@
+//
+//  Profiler.hpp
+//  NedaEngine
+//
+//  Scoped cpu zones and gpu timestamp ranges on one timeline, written out as a chrome trace that
+//  chrome://tracing and ui.perfetto.dev can open. Build with NEDA_PROFILING=1 to turn it on,
+//  without it the zone macros expand to nothing.
+
+#ifndef Profiler_hpp
+#define Profiler_hpp
+
+#include <vulkan/vulkan.h>
+
+#include <time.h>
+
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifndef NEDA_PROFILING
+#define NEDA_PROFILING 0
+#endif
+
+namespace neda {
+
+// nanoseconds on the clock vulkan calls CLOCK_MONOTONIC_RAW, so the gpu can be calibrated against it
+inline uint64_t profilerNow() {
+    timespec time;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &time);
+    return uint64_t(time.tv_sec) * 1000000000ull + uint64_t(time.tv_nsec);
+}
+
+// the names have to outlive the profiler, string literals are what the macros get anyway
+struct TraceEvent {
+    const char* name;
+    uint64_t begin;
+    uint64_t end;
+};
+
+// one row in the trace, every thread gets one and so does every gpu queue
+struct TraceTrack {
+    static const size_t MAX_EVENTS = 1 << 20; // about a minute of frames, after that new events are dropped
+
+    std::string name;
+    uint32_t sortIndex = 0; // rows are ordered by this in the viewer
+    std::vector<TraceEvent> events;
+    uint64_t dropped = 0;
+
+    void add(const char* name, uint64_t begin, uint64_t end) {
+        if (events.size() == MAX_EVENTS) {
+            dropped++;
+            return;
+        }
+        events.push_back({name, begin, end});
+    }
+};
+
+class Profiler {
+public:
+    static const bool enabled = NEDA_PROFILING != 0;
+
+    static Profiler& instance() {
+        static Profiler profiler;
+        return profiler;
+    }
+
+    // the calling thread's track, only that thread writes to it so adding events doesn't lock
+    TraceTrack& threadTrack() {
+        static thread_local TraceTrack* track = nullptr;
+        if (track == nullptr) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            tracks_.emplace_back(new TraceTrack());
+            track = tracks_.back().get();
+            track->name = "thread " + std::to_string(tracks_.size() - 1);
+            track->sortIndex = static_cast<uint32_t>(tracks_.size() - 1);
+        }
+        return *track;
+    }
+
+    void nameThread(const std::string& name, uint32_t sortIndex) {
+        TraceTrack& track = threadTrack();
+        track.name = name;
+        track.sortIndex = sortIndex;
+    }
+
+    // for timelines that aren't a thread, like a gpu queue. whoever adds the events has to do it from one thread
+    TraceTrack& addTrack(const std::string& name, uint32_t sortIndex) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tracks_.emplace_back(new TraceTrack());
+        tracks_.back()->name = name;
+        tracks_.back()->sortIndex = sortIndex;
+        return *tracks_.back();
+    }
+
+    // call once nothing records anymore, the tracks are read without locking
+    void writeChromeTrace(const std::string& path) {
+        std::ofstream file(path);
+        if (!file.is_open()) {
+            throw std::runtime_error("failed to open trace file!");
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        bool first = true;
+        uint64_t dropped = 0;
+        for (size_t tid = 0; tid < tracks_.size(); tid++) {
+            const TraceTrack& track = *tracks_[tid];
+            file << (first ? "" : ",\n") << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":0,\"tid\":" << tid
+                 << ",\"args\":{\"name\":\"" << escape(track.name.c_str()) << "\"}}";
+            first = false;
+            file << ",\n{\"ph\":\"M\",\"name\":\"thread_sort_index\",\"pid\":0,\"tid\":" << tid << ",\"args\":{\"sort_index\":" << track.sortIndex << "}}";
+            for (const TraceEvent& event : track.events) {
+                // chrome wants microseconds, the fraction keeps the nanoseconds
+                file << ",\n{\"ph\":\"X\",\"name\":\"" << escape(event.name) << "\",\"pid\":0,\"tid\":" << tid
+                     << ",\"ts\":" << microseconds(since(event.begin)) << ",\"dur\":" << microseconds(event.end > event.begin ? event.end - event.begin : 0) << "}";
+            }
+            dropped += track.dropped;
+        }
+        file << "\n]}\n";
+
+        if (dropped > 0) {
+            std::cout << "trace " << path << " is missing " << dropped << " events, the tracks were full" << std::endl;
+        }
+    }
+
+private:
+    Profiler() : start_(profilerNow()) {}
+
+    uint64_t since(uint64_t time) const { return time > start_ ? time - start_ : 0; }
+
+    static std::string microseconds(uint64_t nanoseconds) {
+        std::string fraction = std::to_string(nanoseconds % 1000);
+        return std::to_string(nanoseconds / 1000) + "." + std::string(3 - fraction.size(), '0') + fraction;
+    }
+
+    static std::string escape(const char* text) {
+        std::string escaped;
+        for (const char* c = text; *c != '\0'; c++) {
+            if (*c == '"' || *c == '\\') {
+                escaped += '\\';
+            }
+            escaped += *c;
+        }
+        return escaped;
+    }
+
+    uint64_t start_; // the trace starts at 0 here
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<TraceTrack>> tracks_;
+};
+
+class CpuZone {
+public:
+    explicit CpuZone(const char* name) : name_(name), begin_(profilerNow()) {}
+    ~CpuZone() { Profiler::instance().threadTrack().add(name_, begin_, profilerNow()); }
+
+    CpuZone(const CpuZone&) = delete;
+    CpuZone& operator=(const CpuZone&) = delete;
+
+private:
+    const char* name_;
+    uint64_t begin_;
+};
+
+// maps gpu timestamps onto profilerNow(). with VK_EXT_calibrated_timestamps both clocks are sampled together,
+// without it the first timestamp that comes back is pinned to the time its submit was made, which is only
+// off by however long the queue took to get to it
+class GpuClock {
+public:
+    // the extension has to be enabled on the device already when supported is true
+    void create(VkInstance instance, VkPhysicalDevice physicalDevice, VkDevice device, float timestampPeriod, bool supported) {
+        device_ = device;
+        period_ = timestampPeriod;
+        if (!supported) return;
+
+        auto getTimeDomains = (PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT) vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceCalibrateableTimeDomainsEXT");
+        getCalibratedTimestamps_ = (PFN_vkGetCalibratedTimestampsEXT) vkGetDeviceProcAddr(device, "vkGetCalibratedTimestampsEXT");
+        if (getTimeDomains == nullptr || getCalibratedTimestamps_ == nullptr) {
+            getCalibratedTimestamps_ = nullptr;
+            return;
+        }
+
+        uint32_t domainCount = 0;
+        getTimeDomains(physicalDevice, &domainCount, nullptr);
+        std::vector<VkTimeDomainEXT> domains(domainCount);
+        getTimeDomains(physicalDevice, &domainCount, domains.data());
+        bool hasDevice = false;
+        bool hasHost = false;
+        for (VkTimeDomainEXT domain : domains) {
+            hasDevice = hasDevice || domain == VK_TIME_DOMAIN_DEVICE_EXT;
+            hasHost = hasHost || domain == VK_TIME_DOMAIN_CLOCK_MONOTONIC_RAW_EXT;
+        }
+        if (!hasDevice || !hasHost) {
+            getCalibratedTimestamps_ = nullptr;
+        }
+    }
+
+    bool isCalibrated() const { return getCalibratedTimestamps_ != nullptr; }
+
+    // the two clocks drift apart slowly, so this gets called every frame
+    void calibrate() {
+        if (!isCalibrated()) return;
+
+        VkCalibratedTimestampInfoEXT infos[2]{};
+        infos[0].sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+        infos[0].timeDomain = VK_TIME_DOMAIN_DEVICE_EXT;
+        infos[1].sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+        infos[1].timeDomain = VK_TIME_DOMAIN_CLOCK_MONOTONIC_RAW_EXT;
+        uint64_t timestamps[2];
+        uint64_t maxDeviation;
+        if (getCalibratedTimestamps_(device_, 2, infos, timestamps, &maxDeviation) != VK_SUCCESS) {
+            throw std::runtime_error("failed to get calibrated timestamps!");
+        }
+        anchorTicks_ = timestamps[0];
+        anchorTime_ = timestamps[1];
+        anchored_ = true;
+    }
+
+    // only used without calibration
+    void anchor(uint64_t ticks, uint64_t time) {
+        if (anchored_) return;
+        anchorTicks_ = ticks;
+        anchorTime_ = time;
+        anchored_ = true;
+    }
+
+    bool isAnchored() const { return anchored_; }
+
+    uint64_t toHost(uint64_t ticks) const {
+        double offset = double(int64_t(ticks - anchorTicks_)) * period_;
+        return uint64_t(int64_t(anchorTime_) + int64_t(offset));
+    }
+
+private:
+    VkDevice device_ = VK_NULL_HANDLE;
+    PFN_vkGetCalibratedTimestampsEXT getCalibratedTimestamps_ = nullptr;
+    float period_ = 1.0f;
+    uint64_t anchorTicks_ = 0;
+    uint64_t anchorTime_ = 0;
+    bool anchored_ = false;
+};
+
+// timestamp ranges in one queue's command buffers, with a query pool per frame in flight. the frame's first
+// command buffer on the queue calls beginFrame, and collect reads the results once the frame slot is done
+class GpuProfiler {
+public:
+    static const uint32_t MAX_ZONES = 32; // per frame, zones past this aren't recorded
+
+    void create(VkDevice device, uint32_t framesInFlight, const char* trackName, uint32_t sortIndex, const VkAllocationCallbacks* allocator) {
+        device_ = device;
+        allocator_ = allocator;
+        track_ = &Profiler::instance().addTrack(trackName, sortIndex);
+
+        VkQueryPoolCreateInfo queryPoolInfo{};
+        queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryPoolInfo.queryCount = MAX_ZONES * 2;
+
+        frames_.resize(framesInFlight);
+        for (Frame& frame : frames_) {
+            if (vkCreateQueryPool(device, &queryPoolInfo, allocator, &frame.queryPool) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create query pool!");
+            }
+        }
+    }
+
+    void destroy() {
+        for (Frame& frame : frames_) {
+            vkDestroyQueryPool(device_, frame.queryPool, allocator_);
+        }
+        frames_.clear();
+    }
+
+    bool isCreated() const { return !frames_.empty(); }
+
+    // outside a render pass, before the frame's first zone on this queue
+    void beginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex) {
+        Frame& frame = frames_[frameIndex];
+        vkCmdResetQueryPool(commandBuffer, frame.queryPool, 0, MAX_ZONES * 2);
+        frame.zones.clear();
+        frame.recording = true;
+        currentFrame_ = frameIndex;
+    }
+
+    // returns UINT32_MAX when the frame has no room left or beginFrame wasn't called this frame
+    uint32_t beginZone(VkCommandBuffer commandBuffer, const char* name) {
+        if (frames_.empty()) return UINT32_MAX;
+        Frame& frame = frames_[currentFrame_];
+        if (!frame.recording || frame.zones.size() == MAX_ZONES) return UINT32_MAX;
+
+        uint32_t zone = static_cast<uint32_t>(frame.zones.size());
+        frame.zones.push_back(name);
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame.queryPool, zone * 2);
+        return zone;
+    }
+
+    void endZone(VkCommandBuffer commandBuffer, uint32_t zone) {
+        if (zone == UINT32_MAX) return;
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frames_[currentFrame_].queryPool, zone * 2 + 1);
+    }
+
+    // right after the frame's submit, only needed when the clock isn't calibrated
+    void submitted() {
+        if (frames_.empty()) return;
+        frames_[currentFrame_].submitTime = profilerNow();
+        frames_[currentFrame_].recording = false;
+    }
+
+    // after the frame slot's submits are done, turns its queries into events on the queue's track
+    void collect(uint32_t frameIndex, GpuClock& clock) {
+        if (frames_.empty()) return;
+        Frame& frame = frames_[frameIndex];
+        if (frame.zones.empty()) return;
+
+        std::vector<uint64_t> timestamps(frame.zones.size() * 2);
+        VkResult result = vkGetQueryPoolResults(device_, frame.queryPool, 0, static_cast<uint32_t>(timestamps.size()),
+                                                timestamps.size() * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+        if (result == VK_SUCCESS) {
+            if (!clock.isCalibrated()) {
+                clock.anchor(timestamps[0], frame.submitTime);
+            }
+            for (size_t i = 0; i < frame.zones.size(); i++) {
+                track_->add(frame.zones[i], clock.toHost(timestamps[i * 2]), clock.toHost(timestamps[i * 2 + 1]));
+            }
+        }
+        frame.zones.clear();
+    }
+
+private:
+    struct Frame {
+        VkQueryPool queryPool = VK_NULL_HANDLE;
+        std::vector<const char*> zones;
+        uint64_t submitTime = 0;
+        bool recording = false;
+    };
+
+    VkDevice device_ = VK_NULL_HANDLE;
+    const VkAllocationCallbacks* allocator_ = nullptr;
+    TraceTrack* track_ = nullptr;
+    std::vector<Frame> frames_;
+    uint32_t currentFrame_ = 0;
+};
+
+class GpuZone {
+public:
+    GpuZone(GpuProfiler& profiler, VkCommandBuffer commandBuffer, const char* name)
+        : profiler_(profiler), commandBuffer_(commandBuffer), zone_(profiler.beginZone(commandBuffer, name)) {}
+    ~GpuZone() { profiler_.endZone(commandBuffer_, zone_); }
+
+    GpuZone(const GpuZone&) = delete;
+    GpuZone& operator=(const GpuZone&) = delete;
+
+private:
+    GpuProfiler& profiler_;
+    VkCommandBuffer commandBuffer_;
+    uint32_t zone_;
+};
+
+}
+
+#define NEDA_PROFILE_CONCAT_INNER(a, b) a##b
+#define NEDA_PROFILE_CONCAT(a, b) NEDA_PROFILE_CONCAT_INNER(a, b)
+
+#if NEDA_PROFILING
+#define NEDA_PROFILE_ZONE(name) neda::CpuZone NEDA_PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define NEDA_PROFILE_THREAD(name, sortIndex) neda::Profiler::instance().nameThread(name, sortIndex)
+#define NEDA_GPU_ZONE(profiler, commandBuffer, name) neda::GpuZone NEDA_PROFILE_CONCAT(gpuZone, __LINE__)(profiler, commandBuffer, name)
+#else
+#define NEDA_PROFILE_ZONE(name)
+#define NEDA_PROFILE_THREAD(name, sortIndex)
+#define NEDA_GPU_ZONE(profiler, commandBuffer, name)
+#endif
+
+#endif /* Profiler_hpp */
@@ -0,0 +1,169 @@
+//
+//  RenderQueue.hpp
+//  NedaEngine
+//
+//  Sorts the frame's draws by a 64 bit key so draws that share state end up next to each other,
+//  then merges runs with the same state into instanced draws.
+
+#ifndef RenderQueue_hpp
+#define RenderQueue_hpp
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+
+namespace neda {
+
+// bit layout from the top: pass 4 | pipeline 8 | material 12 | mesh 16 | depth 24
+// the most expensive state change gets the highest bits, so it changes the least after sorting
+struct SortKey {
+    static const uint32_t PASS_BITS = 4;
+    static const uint32_t PIPELINE_BITS = 8;
+    static const uint32_t MATERIAL_BITS = 12;
+    static const uint32_t MESH_BITS = 16;
+    static const uint32_t DEPTH_BITS = 24;
+
+    static const uint32_t MESH_SHIFT = DEPTH_BITS;
+    static const uint32_t MATERIAL_SHIFT = MESH_SHIFT + MESH_BITS;
+    static const uint32_t PIPELINE_SHIFT = MATERIAL_SHIFT + MATERIAL_BITS;
+    static const uint32_t PASS_SHIFT = PIPELINE_SHIFT + PIPELINE_BITS;
+
+    // everything but the depth, two draws with the same state bits can be drawn as one
+    static const uint64_t STATE_MASK = ~((uint64_t(1) << DEPTH_BITS) - 1);
+
+    static uint64_t make(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, uint32_t depth) {
+        return (uint64_t(pass & ((1u << PASS_BITS) - 1)) << PASS_SHIFT) |
+               (uint64_t(pipeline & ((1u << PIPELINE_BITS) - 1)) << PIPELINE_SHIFT) |
+               (uint64_t(material & ((1u << MATERIAL_BITS) - 1)) << MATERIAL_SHIFT) |
+               (uint64_t(mesh & ((1u << MESH_BITS) - 1)) << MESH_SHIFT) |
+               uint64_t(depth & ((1u << DEPTH_BITS) - 1));
+    }
+
+    static uint32_t pass(uint64_t key) { return uint32_t(key >> PASS_SHIFT) & ((1u << PASS_BITS) - 1); }
+    static uint32_t pipeline(uint64_t key) { return uint32_t(key >> PIPELINE_SHIFT) & ((1u << PIPELINE_BITS) - 1); }
+    static uint32_t material(uint64_t key) { return uint32_t(key >> MATERIAL_SHIFT) & ((1u << MATERIAL_BITS) - 1); }
+    static uint32_t mesh(uint64_t key) { return uint32_t(key >> MESH_SHIFT) & ((1u << MESH_BITS) - 1); }
+    static uint32_t depth(uint64_t key) { return uint32_t(key) & ((1u << DEPTH_BITS) - 1); }
+
+    // front to back for opaque draws, invert it for back to front
+    static uint32_t quantizeDepth(float depth, float maxDepth) {
+        float normalized = std::min(std::max(depth / maxDepth, 0.0f), 1.0f);
+        return uint32_t(normalized * float((1u << DEPTH_BITS) - 1));
+    }
+};
+
+struct RenderItem {
+    uint64_t key;
+    uint32_t object; // whatever the caller uses to find the instance data again
+};
+
+// an instanced draw of every item in [firstItem, firstItem + itemCount), all with the same state
+struct DrawBatch {
+    uint32_t pass;
+    uint32_t pipeline;
+    uint32_t material;
+    uint32_t mesh;
+    uint32_t firstItem;
+    uint32_t itemCount;
+};
+
+// what the recording actually did, summed over all the recording jobs
+struct RenderStats {
+    uint32_t pipelineBinds = 0;
+    uint32_t materialBinds = 0;
+    uint32_t vertexBufferBinds = 0;
+    uint32_t drawCalls = 0; // api calls, an indirect draw with several commands counts once
+    uint32_t instances = 0;
+
+    RenderStats& operator+=(const RenderStats& o) {
+        pipelineBinds += o.pipelineBinds;
+        materialBinds += o.materialBinds;
+        vertexBufferBinds += o.vertexBufferBinds;
+        drawCalls += o.drawCalls;
+        instances += o.instances;
+        return *this;
+    }
+};
+
+// lsd radix sort on the key, 8 bits per pass. passes where every key has the same byte are skipped,
+// which with the layout above is most of the high ones. stable, so equal keys keep their submit order
+inline void radixSort(std::vector<RenderItem>& items, std::vector<RenderItem>& scratch) {
+    size_t count = items.size();
+    scratch.resize(count);
+    if (count < 2) return;
+
+    uint32_t histograms[8][256];
+    std::memset(histograms, 0, sizeof(histograms));
+    for (const RenderItem& item : items) {
+        for (int pass = 0; pass < 8; pass++) {
+            histograms[pass][(item.key >> (pass * 8)) & 0xff]++;
+        }
+    }
+
+    RenderItem* source = items.data();
+    RenderItem* destination = scratch.data();
+    for (int pass = 0; pass < 8; pass++) {
+        uint32_t* histogram = histograms[pass];
+        if (histogram[(source[0].key >> (pass * 8)) & 0xff] == count) continue;
+
+        uint32_t offset = 0;
+        for (int bucket = 0; bucket < 256; bucket++) {
+            uint32_t bucketCount = histogram[bucket];
+            histogram[bucket] = offset;
+            offset += bucketCount;
+        }
+        for (size_t i = 0; i < count; i++) {
+            destination[histogram[(source[i].key >> (pass * 8)) & 0xff]++] = source[i];
+        }
+        std::swap(source, destination);
+    }
+
+    if (source != items.data()) {
+        items.swap(scratch);
+    }
+}
+
+// filled in parallel with one slot per draw, then sorted and batched on one thread
+class RenderQueue {
+public:
+    void reset(size_t itemCount) {
+        items_.resize(itemCount);
+        batches_.clear();
+    }
+
+    // safe to call from several threads as long as every index is written once
+    void set(size_t index, uint64_t key, uint32_t object) {
+        items_[index] = {key, object};
+    }
+
+    void sort() {
+        radixSort(items_, scratch_);
+    }
+
+    // turns every run of items with the same state into one batch. without merging every item is its own batch,
+    // which is what drawing in submit order costs
+    void buildBatches(bool merge = true) {
+        batches_.clear();
+        for (uint32_t i = 0; i < items_.size(); i++) {
+            uint64_t key = items_[i].key;
+            if (merge && !batches_.empty() && ((items_[i - 1].key ^ key) & SortKey::STATE_MASK) == 0) {
+                batches_.back().itemCount++;
+                continue;
+            }
+            batches_.push_back({SortKey::pass(key), SortKey::pipeline(key), SortKey::material(key), SortKey::mesh(key), i, 1});
+        }
+    }
+
+    const std::vector<RenderItem>& items() const { return items_; }
+    const std::vector<DrawBatch>& batches() const { return batches_; }
+
+private:
+    std::vector<RenderItem> items_;
+    std::vector<RenderItem> scratch_;
+    std::vector<DrawBatch> batches_;
+};
+
+}
+
+#endif /* RenderQueue_hpp */
@@ -0,0 +1,172 @@
+//
+//  Shadows.hpp
+//  NedaEngine
+//
+//  Cascaded shadow maps for the sun. The view frustum up to maxDistance is cut into cascades, each one gets
+//  an orthographic shadow map fitted around a bounding sphere of its slice. The sphere only depends on the
+//  split depths and the projection, so a cascade's size never changes while the camera moves, and its center
+//  is snapped to a coarse grid in light space. A cascade whose snapped position, light and contents are the
+//  same as last time keeps its map from the frame that rendered it. The structs here match shader.frag.
+
+#ifndef Shadows_hpp
+#define Shadows_hpp
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+
+#include "Math.hpp"
+
+namespace neda {
+
+const uint32_t MAX_SHADOW_CASCADES = 4;
+
+struct ShadowSettings {
+    uint32_t cascadeCount = 4;
+    uint32_t resolution = 2048; // of every cascade's map
+    float splitLambda = 0.75f; // 0 splits the range evenly, 1 logarithmically
+    float maxDistance = 120.0f; // view depth where shadows end
+    float casterDistance = 80.0f; // how far towards the sun from a cascade casters are still picked up
+    bool caching = true; // false re-renders every cascade every frame
+};
+
+// per frame uniform for shader.frag, std140
+struct ShadowParams {
+    Mat4 cascadeViewProjections[MAX_SHADOW_CASCADES];
+    float splitDepths[MAX_SHADOW_CASCADES]; // view depth where each cascade ends
+    float normalOffsets[MAX_SHADOW_CASCADES]; // one texel in world units, receivers are pushed out along the normal by it
+    Vec3 lightDirection; // the way the light travels
+    uint32_t cascadeCount;
+    Vec3 lightColor;
+    float texelSize; // 1 / resolution, the pcf step
+};
+static_assert(sizeof(ShadowParams) == 320, "ShadowParams has to match the shaders' std140 layout");
+
+struct ShadowCascade {
+    Mat4 viewProjection = Mat4::identity(); // what the map was rendered with, only changes when it is re-rendered
+    float splitNear = 0.0f;
+    float splitFar = 0.0f;
+    float radius = 0.0f; // half the width the map covers
+    float snapStep = 0.0f;
+    int32_t snappedCenter[3] = {};
+    uint64_t contentVersion = 0;
+    bool valid = false;
+};
+
+class CascadedShadows {
+public:
+    void configure(const ShadowSettings& settings) {
+        if (settings.cascadeCount == 0 || settings.cascadeCount > MAX_SHADOW_CASCADES) {
+            throw std::runtime_error("failed to configure shadows, unsupported cascade count!");
+        }
+        settings_ = settings;
+        invalidate();
+    }
+
+    const ShadowSettings& settings() const { return settings_; }
+    const ShadowCascade& cascade(uint32_t index) const { return cascades_[index]; }
+
+    // forces every cascade to be rendered again, e.g. after the maps themselves were recreated
+    void invalidate() {
+        for (ShadowCascade& cascade : cascades_) {
+            cascade.valid = false;
+        }
+    }
+
+    // fits the cascades to the camera, returns a bit for every cascade that has to be rendered this frame.
+    // contentVersion is bumped by the caller whenever a shadow caster is added, removed or moved
+    uint32_t update(const Vec3& cameraPosition, const Vec3& cameraForward, float fovY, float aspect, float nearPlane,
+                    const Vec3& lightDirection, uint64_t contentVersion) {
+        bool lightChanged = lightDirection.x != lightDirection_.x || lightDirection.y != lightDirection_.y ||
+                            lightDirection.z != lightDirection_.z;
+        lightDirection_ = lightDirection;
+
+        Vec3 up = std::fabs(lightDirection.y) > 0.99f ? Vec3(1.0f, 0.0f, 0.0f) : Vec3(0.0f, 1.0f, 0.0f);
+        Mat4 lightView = Mat4::lookAt(Vec3(), lightDirection, up);
+
+        float tanHalfY = std::tan(fovY * 0.5f);
+        float tanHalfX = tanHalfY * aspect;
+        float cornerSlope = tanHalfX * tanHalfX + tanHalfY * tanHalfY; // squared distance from the view axis per unit of depth, squared
+
+        uint32_t renderMask = 0;
+        float splitNear = nearPlane;
+        for (uint32_t i = 0; i < settings_.cascadeCount; i++) {
+            ShadowCascade& cascade = cascades_[i];
+            float splitFar = splitDepth(i + 1, nearPlane);
+
+            // smallest sphere around the slice, centered on the view axis. for long slices it is the far cap's circle
+            float centerDepth = std::min(0.5f * (splitNear + splitFar) * (1.0f + cornerSlope), splitFar);
+            float sliceRadius = std::sqrt((splitFar - centerDepth) * (splitFar - centerDepth) + splitFar * splitFar * cornerSlope);
+
+            // the center moves in steps of about a quarter of the radius, and the map covers that much more so the
+            // slice stays inside it in between. steps are whole texels so the rasterization doesn't shimmer
+            float coarseStep = sliceRadius * 0.25f;
+            float radius = sliceRadius + coarseStep;
+            float texel = 2.0f * radius / settings_.resolution;
+            float snapStep = std::max(std::floor(coarseStep / texel), 1.0f) * texel;
+
+            Vec3 center = cameraPosition + cameraForward * centerDepth;
+            Vec4 lightSpaceCenter = lightView * Vec4(center, 1.0f);
+            int32_t snapped[3] = {
+                static_cast<int32_t>(std::floor(lightSpaceCenter.x / snapStep + 0.5f)),
+                static_cast<int32_t>(std::floor(lightSpaceCenter.y / snapStep + 0.5f)),
+                static_cast<int32_t>(std::floor(lightSpaceCenter.z / snapStep + 0.5f)),
+            };
+
+            bool moved = snapped[0] != cascade.snappedCenter[0] || snapped[1] != cascade.snappedCenter[1] ||
+                         snapped[2] != cascade.snappedCenter[2] || radius != cascade.radius;
+            bool dirty = !settings_.caching || !cascade.valid || lightChanged || moved || contentVersion != cascade.contentVersion;
+
+            cascade.splitNear = splitNear;
+            cascade.splitFar = splitFar;
+            if (dirty) {
+                float x = snapped[0] * snapStep;
+                float y = snapped[1] * snapStep;
+                float depth = -snapped[2] * snapStep; // light space looks down -z
+                Mat4 projection = Mat4::orthographic(x - radius, x + radius, y - radius, y + radius,
+                                                     depth - radius - settings_.casterDistance, depth + radius);
+                cascade.viewProjection = projection * lightView;
+                cascade.radius = radius;
+                cascade.snapStep = snapStep;
+                std::copy(snapped, snapped + 3, cascade.snappedCenter);
+                cascade.contentVersion = contentVersion;
+                cascade.valid = true;
+                renderMask |= 1u << i;
+            }
+            splitNear = splitFar;
+        }
+        return renderMask;
+    }
+
+    ShadowParams params(const Vec3& lightColor) const {
+        ShadowParams params{};
+        for (uint32_t i = 0; i < settings_.cascadeCount; i++) {
+            params.cascadeViewProjections[i] = cascades_[i].viewProjection;
+            params.splitDepths[i] = cascades_[i].splitFar;
+            params.normalOffsets[i] = 2.0f * cascades_[i].radius / settings_.resolution;
+        }
+        params.lightDirection = lightDirection_;
+        params.cascadeCount = settings_.cascadeCount;
+        params.lightColor = lightColor;
+        params.texelSize = 1.0f / settings_.resolution;
+        return params;
+    }
+
+private:
+    // the practical split scheme, a blend of logarithmic splits (even texel density) and uniform ones
+    float splitDepth(uint32_t index, float nearPlane) const {
+        float fraction = static_cast<float>(index) / settings_.cascadeCount;
+        float logarithmic = nearPlane * std::pow(settings_.maxDistance / nearPlane, fraction);
+        float uniform = nearPlane + (settings_.maxDistance - nearPlane) * fraction;
+        return settings_.splitLambda * logarithmic + (1.0f - settings_.splitLambda) * uniform;
+    }
+
+    ShadowSettings settings_;
+    ShadowCascade cascades_[MAX_SHADOW_CASCADES];
+    Vec3 lightDirection_;
+};
+
+}
+
+#endif /* Shadows_hpp */
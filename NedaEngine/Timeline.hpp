@@ -0,0 +1,179 @@
+//
+//  Timeline.hpp
+//  NedaEngine
+//
+//  One timeline semaphore per queue. Every submit to a queue signals the next value of its timeline,
+//  so waiting on the cpu, waiting on another queue and checking if a resource is still in use
+//  all come down to comparing against one number.
+
+#ifndef Timeline_hpp
+#define Timeline_hpp
+
+#include <vulkan/vulkan.h>
+
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+namespace neda {
+
+// the instance is created for vulkan 1.0, so the loader doesn't export these and they have to come from the device
+struct TimelineFunctions {
+    PFN_vkWaitSemaphoresKHR waitSemaphores = nullptr;
+    PFN_vkGetSemaphoreCounterValueKHR getSemaphoreCounterValue = nullptr;
+
+    void load(VkDevice device) {
+        waitSemaphores = (PFN_vkWaitSemaphoresKHR) vkGetDeviceProcAddr(device, "vkWaitSemaphoresKHR");
+        getSemaphoreCounterValue = (PFN_vkGetSemaphoreCounterValueKHR) vkGetDeviceProcAddr(device, "vkGetSemaphoreCounterValueKHR");
+        if (waitSemaphores == nullptr || getSemaphoreCounterValue == nullptr) {
+            throw std::runtime_error("failed to load the timeline semaphore functions!");
+        }
+    }
+};
+
+class QueueTimeline {
+public:
+    void create(VkDevice device, const TimelineFunctions& functions, VkQueue queue, const VkAllocationCallbacks* allocator = nullptr) {
+        device_ = device;
+        functions_ = &functions;
+        queue_ = queue;
+        allocator_ = allocator;
+
+        VkSemaphoreTypeCreateInfoKHR typeInfo{};
+        typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+        typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+        typeInfo.initialValue = 0;
+
+        VkSemaphoreCreateInfo semaphoreInfo{};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        semaphoreInfo.pNext = &typeInfo;
+
+        if (vkCreateSemaphore(device, &semaphoreInfo, allocator, &semaphore_) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create timeline semaphore!");
+        }
+    }
+
+    void destroy() {
+        vkDestroySemaphore(device_, semaphore_, allocator_);
+    }
+
+    VkSemaphore semaphore() const { return semaphore_; }
+    VkQueue queue() const { return queue_; }
+
+    // reserves the value the next submit signals. values only go up, 0 is "nothing submitted yet" and is always complete
+    uint64_t nextSignalValue() { return ++lastSubmitted_; }
+    uint64_t lastSubmittedValue() const { return lastSubmitted_; }
+
+    // asks the driver, and remembers the answer so isComplete() can usually skip the call
+    uint64_t completedValue() const {
+        uint64_t value = 0;
+        if (functions_->getSemaphoreCounterValue(device_, semaphore_, &value) != VK_SUCCESS) {
+            throw std::runtime_error("failed to read timeline semaphore value!");
+        }
+        uint64_t known = completed_.load(std::memory_order_relaxed);
+        while (value > known && !completed_.compare_exchange_weak(known, value, std::memory_order_relaxed)) {}
+        return value;
+    }
+
+    bool isComplete(uint64_t value) const {
+        return value <= completed_.load(std::memory_order_relaxed) || value <= completedValue();
+    }
+
+    void wait(uint64_t value) const {
+        if (value <= completed_.load(std::memory_order_relaxed)) return;
+
+        VkSemaphoreWaitInfoKHR waitInfo{};
+        waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+        waitInfo.semaphoreCount = 1;
+        waitInfo.pSemaphores = &semaphore_;
+        waitInfo.pValues = &value;
+
+        if (functions_->waitSemaphores(device_, &waitInfo, UINT64_MAX) != VK_SUCCESS) {
+            throw std::runtime_error("failed to wait for timeline semaphore!");
+        }
+        uint64_t known = completed_.load(std::memory_order_relaxed);
+        while (value > known && !completed_.compare_exchange_weak(known, value, std::memory_order_relaxed)) {}
+    }
+
+    // everything submitted so far, what vkQueueWaitIdle would do for this queue
+    void waitIdle() const { wait(lastSubmitted_); }
+
+private:
+    VkDevice device_ = VK_NULL_HANDLE;
+    const TimelineFunctions* functions_ = nullptr;
+    const VkAllocationCallbacks* allocator_ = nullptr;
+    VkQueue queue_ = VK_NULL_HANDLE;
+    VkSemaphore semaphore_ = VK_NULL_HANDLE;
+    std::atomic<uint64_t> lastSubmitted_{0};
+    mutable std::atomic<uint64_t> completed_{0};
+};
+
+// collects the waits and signals of one vkQueueSubmit. binary semaphores (the swapchain ones) and timelines
+// can be mixed, the binary ones just get a value that is ignored
+class QueueSubmission {
+public:
+    void waitBinary(VkSemaphore semaphore, VkPipelineStageFlags stage) {
+        waitSemaphores_.push_back(semaphore);
+        waitValues_.push_back(0);
+        waitStages_.push_back(stage);
+    }
+
+    void waitTimeline(const QueueTimeline& timeline, uint64_t value, VkPipelineStageFlags stage) {
+        if (value == 0) return;
+        waitSemaphores_.push_back(timeline.semaphore());
+        waitValues_.push_back(value);
+        waitStages_.push_back(stage);
+    }
+
+    void signalBinary(VkSemaphore semaphore) {
+        signalSemaphores_.push_back(semaphore);
+        signalValues_.push_back(0);
+    }
+
+    void addCommandBuffer(VkCommandBuffer commandBuffer) {
+        commandBuffers_.push_back(commandBuffer);
+    }
+
+    // submits to the timeline's queue and signals its next value, which is returned
+    uint64_t submit(QueueTimeline& timeline) {
+        uint64_t value = timeline.nextSignalValue();
+        signalSemaphores_.push_back(timeline.semaphore());
+        signalValues_.push_back(value);
+
+        VkTimelineSemaphoreSubmitInfoKHR timelineInfo{};
+        timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+        timelineInfo.waitSemaphoreValueCount = static_cast<uint32_t>(waitValues_.size());
+        timelineInfo.pWaitSemaphoreValues = waitValues_.data();
+        timelineInfo.signalSemaphoreValueCount = static_cast<uint32_t>(signalValues_.size());
+        timelineInfo.pSignalSemaphoreValues = signalValues_.data();
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.pNext = &timelineInfo;
+        submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores_.size());
+        submitInfo.pWaitSemaphores = waitSemaphores_.data();
+        submitInfo.pWaitDstStageMask = waitStages_.data();
+        submitInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers_.size());
+        submitInfo.pCommandBuffers = commandBuffers_.data();
+        submitInfo.signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores_.size());
+        submitInfo.pSignalSemaphores = signalSemaphores_.data();
+
+        if (vkQueueSubmit(timeline.queue(), 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+            throw std::runtime_error("failed to submit command buffer!");
+        }
+        return value;
+    }
+
+private:
+    std::vector<VkSemaphore> waitSemaphores_;
+    std::vector<uint64_t> waitValues_;
+    std::vector<VkPipelineStageFlags> waitStages_;
+    std::vector<VkSemaphore> signalSemaphores_;
+    std::vector<uint64_t> signalValues_;
+    std::vector<VkCommandBuffer> commandBuffers_;
+};
+
+}
+
+#endif /* Timeline_hpp */
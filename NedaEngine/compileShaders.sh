@@ -1,5 +1,17 @@
 #! /bin/bash
+set -e # a shader that fails to compile should fail the build, not leave a stale .spv behind
 ../../../macOS/bin/glslangValidator shaders/shader.vert 
 ../../../macOS/bin/glslangValidator shaders/shader.frag 
 ../../../macOS/bin/glslc shaders/shader.vert -o ./shaders/vert.spv
 ../../../macOS/bin/glslc shaders/shader.frag -o ./shaders/frag.spv
+../../../macOS/bin/glslc shaders/cull.comp -o ./shaders/cull.spv
+../../../macOS/bin/glslc shaders/cluster.comp -o ./shaders/cluster.spv
+../../../macOS/bin/glslc shaders/particles.comp -o ./shaders/particles.spv
+../../../macOS/bin/glslc shaders/particles.vert -o ./shaders/particlesVert.spv
+../../../macOS/bin/glslc shaders/particles.frag -o ./shaders/particlesFrag.spv
+../../../macOS/bin/glslc shaders/upscale.vert -o ./shaders/upscaleVert.spv
+../../../macOS/bin/glslc shaders/upscale.frag -o ./shaders/upscaleFrag.spv
+../../../macOS/bin/glslc shaders/post.comp -o ./shaders/post.spv
+../../../macOS/bin/glslc -DSWAPCHAIN_OUTPUT shaders/post.comp -o ./shaders/postSwapchain.spv
+../../../macOS/bin/glslc shaders/skin.comp -o ./shaders/skin.spv
+../../../macOS/bin/glslc shaders/meshlet_cull.comp -o ./shaders/meshletCull.spv
@@ -16,6 +16,27 @@
 #include <optional>
 #include <set>
 #include <fstream>
+#include <cstring>
+#include <random>
+#include <chrono>
+
+#include "JobSystem.hpp"
+#include "Math.hpp"
+#include "Culling.hpp"
+#include "RenderQueue.hpp"
+#include "Timeline.hpp"
+#include "AsyncCompute.hpp"
+#include "HostAllocator.hpp"
+#include "Profiler.hpp"
+#include "DeletionQueue.hpp"
+#include "Lighting.hpp"
+#include "Shadows.hpp"
+#include "Particles.hpp"
+#include "DynamicResolution.hpp"
+#include "PostProcess.hpp"
+#include "Animation.hpp"
+#include "CommandLog.hpp"
+#include "Meshlets.hpp"
 
 
 const uint32_t WIDTH = 800;
@@ -27,6 +48,15 @@ const std::vector<const char*> validationLayers = {
 
 
 const bool enableValidationLayers = true;
+const bool enableOcclusionCulling = true; // rasterizes the big occluders on the cpu and skips what is hidden behind them
+const bool enableDrawSorting = true; // turn off to see what drawing in scene order costs in binds and draws
+const bool enableShadowCaching = true; // cascades whose view and casters didn't change keep their shadow map
+const bool enableParticles = true; // a million gpu simulated particles from a few fountains, on the async compute queue if there is one
+const bool enableDynamicResolution = true; // scales the scene's resolution to hold 60 fps on the gpu, needs timestamps
+const bool enablePostProcessing = true; // hdr scene with bloom, auto exposure, tonemapping and grading in compute
+const bool enableSkinning = true; // a crowd of animated characters, posed on the cpu in parallel and skinned once per frame in compute
+const bool enableMeshlets = true; // hills around the field cut into meshlets, culled on the gpu so only the parts in view get drawn
+const bool enableGpuCulling = false; // frustum culls on the (async) compute queue instead of the cpu, --benchmark turns it on
 
 VkResult CreateDebugUtilsMessengerEXT(VkInstance instance, const VkDebugUtilsMessengerCreateInfoEXT* pCreateInfo, const VkAllocationCallbacks* pAllocator, VkDebugUtilsMessengerEXT* pDebugMessenger) {
     auto func = (PFN_vkCreateDebugUtilsMessengerEXT) vkGetInstanceProcAddr(instance, "vkCreateDebugUtilsMessengerEXT");
@@ -46,7 +76,44 @@ void DestroyDebugUtilsMessengerEXT(VkInstance instance, VkDebugUtilsMessengerEXT
 
 class HelloTriangleApplication {
 public:
+    // alternates async and serial compute for a while, prints the gpu times and quits
+    void enableBenchmark() {
+        benchmark.enabled = true;
+        useGpuCulling = true;
+        useParticles = false; // they would share the compute submit the benchmark times
+        useDynamicResolution = false; // the graphics times have to stay comparable
+    }
+    
+    // only does something in builds with NEDA_PROFILING
+    void setTracePath(const std::string& path) {
+        tracePath = path;
+    }
+    
+    // writes what every frame does to a file, see CommandLog.hpp
+    void setCapturePath(const std::string& path) {
+        capturePath = path;
+    }
+    
+    // runs a capture's frames again instead of following the clock, times them and checks they still do what was captured
+    void setReplayPath(const std::string& path) {
+        replayPath = path;
+    }
+    
+    // presents to a headless surface instead of a window, for replays on machines without a display
+    void enableHeadless() {
+        headless = true;
+    }
+    
+    // whether every replayed frame recorded what its capture did, a ci run fails on anything else
+    bool replayMatched() const {
+        return replayTimings.mismatches() == 0;
+    }
+
     void run() {
+        NEDA_PROFILE_THREAD("main thread", 0);
+        if (!replayPath.empty()) {
+            loadReplay();
+        }
         initWindow();
         initVulkan();
         mainLoop();
@@ -54,50 +121,471 @@ public:
     }
 
 private:
-    GLFWwindow* window;
+    GLFWwindow* window = nullptr; // stays null when headless
     VkInstance instance;
     
+    // every pAllocator comes from here, so the driver's host allocations show up in the counters
+    neda::HostAllocator hostAllocator;
+    
     VkPhysicalDevice physicalDevice = VK_NULL_HANDLE; // this is the real graphics card
     VkDevice device; // this is our logical device
     VkQueue graphicsQueue;
+    VkQueue computeQueue; // the graphics queue when the device has no other queue that can do compute
     VkDebugUtilsMessengerEXT debugMessenger;
 
     VkSurfaceKHR surface;
     VkQueue presentQueue;
-    VkSwapchainKHR swapChain;
+    VkSwapchainKHR swapChain = VK_NULL_HANDLE;
     std::vector<VkImage> swapChainImages;
     std::vector<VkImageView> swapChainImageViews;
     VkFormat swapChainImageFormat;
     VkExtent2D swapChainExtent;
     VkPipelineLayout pipelineLayout;
     VkRenderPass renderPass;
-    VkPipeline graphicsPipeline;
-    std::vector<VkFramebuffer> swapChainFramebuffers;
+    // same shaders, different fixed function state
+    enum PipelineId : uint32_t {
+        PIPELINE_OPAQUE = 0,
+        PIPELINE_DOUBLE_SIDED,
+        PIPELINE_COUNT
+    };
+    std::vector<VkPipeline> graphicsPipelines;
+    std::vector<VkFramebuffer> swapChainFramebuffers; // the upscale pass's
     
     // command pool manages the memory that command buffer use
-    VkCommandPool commandPool;
-    std::vector<VkCommandBuffer> commandBuffers;
+    // every frame in flight gets its own pools so they can be reset once the frame's fence is signaled,
+    // and every job system thread gets its own pool since a pool can't be used by two threads at once
+    struct ThreadCommandPool {
+        VkCommandPool pool;
+        std::vector<VkCommandBuffer> secondaryBuffers;
+        uint32_t usedSecondaryBuffers = 0;
+    };
+    struct FrameCommands {
+        VkCommandPool primaryPool;
+        VkCommandBuffer primaryBuffer;
+        std::vector<ThreadCommandPool> threadPools;
+    };
+    std::vector<FrameCommands> frameCommands;
+
+    // runs the per frame task graph, the main thread only builds the graph and submits
+    neda::JobSystem jobSystem;
+
+    const uint32_t MIN_DRAWS_PER_RECORDING_JOB = 64; // below this a secondary command buffer costs more than it saves
+    const uint32_t CULLING_BATCH_SIZE = 256;
+
+    struct Vertex {
+        neda::Vec3 position;
+        neda::Vec3 color;
+        neda::Vec3 normal;
+    };
+
+    // per instance vertex data, written by the recording jobs for every visible object
+    struct InstanceData {
+        neda::Vec3 position;
+        neda::Vec3 scale;
+        neda::Vec3 color;
+    };
+
+    struct Mesh {
+        uint32_t firstVertex;
+        uint32_t vertexCount;
+        neda::Vec3 extent; // half size of the mesh at scale 1
+    };
+
+    // push constants that follow the view projection, binding a material means pushing them
+    struct MaterialConstants {
+        float tint[4];
+    };
+    struct Material {
+        PipelineId pipeline;
+        MaterialConstants constants;
+    };
+
+    struct SceneObject {
+        uint32_t mesh;
+        uint32_t material;
+        neda::Vec3 position;
+        neda::Vec3 scale;
+        neda::Vec3 color;
+        bool isOccluder;
+    };
+
+    std::vector<Vertex> vertices;
+    std::vector<Mesh> meshes;
+    std::vector<Material> materials;
+    std::vector<SceneObject> sceneObjects;
+    std::vector<uint32_t> occluderObjects;
+    neda::BoundingBoxes objectBounds; // world space, same order as sceneObjects
 
-    std::vector<VkSemaphore> imageAvailableSemaphores;
-    std::vector<VkSemaphore> renderFinishedSemaphores;
+    neda::Mat4 viewProjection;
+    neda::Mat4 viewMatrix;
+    neda::Mat4 projectionMatrix;
+    neda::Vec3 cameraPosition;
+    neda::Vec3 cameraForward;
+    const float CAMERA_FOV_Y = 60.0f * neda::PI / 180.0f;
+    const float CAMERA_NEAR_PLANE = 0.1f;
+    const float CAMERA_FAR_PLANE = 250.0f;
+    neda::OcclusionBuffer occlusionBuffer;
+    std::vector<uint32_t> visibleObjects; // indices into sceneObjects, in scene order
+    std::vector<uint32_t> cullingScratch;
+    
+    const uint32_t RENDER_PASS_OPAQUE = 0;
+    neda::RenderQueue renderQueue;
+    neda::RenderStats renderStats; // of the last recorded frame
+
+    // clustered lighting: the lights move on the cpu, every frame a compute pass bins them into the cluster grid
+    // and the fragment shader reads its cluster's list. the buffers are per frame in flight
+    struct AnimatedLight {
+        neda::GpuLight light;
+        neda::Vec3 orbitCenter;
+        float orbitRadius;
+        float orbitSpeed;
+        float phase;
+    };
+    const uint32_t LIGHT_COUNT = 2048;
+    std::vector<AnimatedLight> lights;
+    VkDescriptorSetLayout lightingDescriptorSetLayout; // the binning pass and the scene pipelines share it
+    VkDescriptorPool lightingDescriptorPool;
+    std::vector<VkDescriptorSet> lightingDescriptorSets;
+    std::vector<VkBuffer> lightBuffers; // persistently mapped
+    std::vector<VkDeviceMemory> lightBuffersMemory;
+    std::vector<neda::GpuLight*> lightBuffersMapped;
+    std::vector<VkBuffer> clusterParamBuffers; // persistently mapped
+    std::vector<VkDeviceMemory> clusterParamBuffersMemory;
+    std::vector<neda::ClusterParams*> clusterParamBuffersMapped;
+    std::vector<VkBuffer> clusterBuffers; // light count of every cluster, then MAX_LIGHTS_PER_CLUSTER indices per cluster
+    std::vector<VkDeviceMemory> clusterBuffersMemory;
+    VkPipelineLayout lightBinningPipelineLayout;
+    VkPipeline lightBinningPipeline;
+
+    // cascaded shadows from the sun. the maps live in one layered image shared by the frames in flight, a cascade is
+    // only rendered again when Shadows.hpp says its view or its casters changed
+    struct ShadowDraw {
+        uint32_t cascade;
+        uint32_t mesh;
+        uint32_t firstInstance;
+        uint32_t instanceCount;
+    };
+    neda::CascadedShadows shadows;
+    neda::Vec3 sunDirection = neda::normalize(neda::Vec3(-0.4f, -1.0f, -0.3f));
+    neda::Vec3 sunColor = neda::Vec3(1.0f, 0.95f, 0.85f) * 0.6f;
+    uint64_t staticSceneVersion = 1; // bump when a shadow caster is added, removed or moved
+    uint32_t shadowStaticMask = 0; // cascades whose static casters are rendered again this frame
+    uint32_t shadowRenderMask = 0; // cascades put together again this frame, the static ones plus any with characters now or last frame
+    uint32_t shadowCharacterMask = 0; // cascades with characters in them last frame, their shadows have to be cleared out
+    std::vector<ShadowDraw> shadowDraws; // this frame's, grouped by cascade
+    uint32_t shadowCascadesRendered = 0; // since the last title update
+    VkFormat shadowFormat;
+    VkRenderPass shadowRenderPass; // the characters on top of a copy of the static casters
+    VkRenderPass shadowStaticRenderPass; // the static casters alone, compatible with shadowRenderPass
+    VkPipeline shadowPipeline;
+    VkImage shadowImage;
+    VkDeviceMemory shadowImageMemory;
+    VkImageView shadowArrayView; // all cascades, what the fragment shader samples
+    std::vector<VkImageView> shadowLayerViews; // one per cascade to render into
+    std::vector<VkFramebuffer> shadowFramebuffers;
+    // only the static casters, what the caching keeps. every frame a cascade changes it gets copied into shadowImage
+    VkImage shadowStaticImage;
+    VkDeviceMemory shadowStaticImageMemory;
+    std::vector<VkImageView> shadowStaticLayerViews;
+    std::vector<VkFramebuffer> shadowStaticFramebuffers;
+    VkSampler shadowSampler;
+    std::vector<VkBuffer> shadowParamBuffers; // persistently mapped
+    std::vector<VkDeviceMemory> shadowParamBuffersMemory;
+    std::vector<neda::ShadowParams*> shadowParamBuffersMapped;
+    std::vector<VkBuffer> shadowInstanceBuffers; // persistently mapped, room for every object in every cascade
+    std::vector<VkDeviceMemory> shadowInstanceBuffersMemory;
+    std::vector<InstanceData*> shadowInstanceBuffersMapped;
+
+    VkBuffer vertexBuffer;
+    VkDeviceMemory vertexBufferMemory;
+    // one per frame in flight, persistently mapped
+    std::vector<VkBuffer> instanceBuffers;
+    std::vector<VkDeviceMemory> instanceBuffersMemory;
+    std::vector<InstanceData*> instanceBuffersMapped;
+    // same, holds the commands for the multi draws. only used if the device supports multiDrawIndirect
+    bool multiDrawIndirectSupported = false;
+    std::vector<VkBuffer> indirectBuffers;
+    std::vector<VkDeviceMemory> indirectBuffersMemory;
+    std::vector<VkDrawIndirectCommand*> indirectBuffersMapped;
+    // the characters' commands, the scene pass's first and then one range per cascade, each CHARACTER_COUNT long
+    std::vector<VkBuffer> characterIndirectBuffers;
+    std::vector<VkDeviceMemory> characterIndirectBuffersMemory;
+    std::vector<VkDrawIndirectCommand*> characterIndirectBuffersMapped;
+    VkCommandPool uploadCommandPool;
+
+    VkImage depthImage;
+    VkDeviceMemory depthImageMemory;
+    VkImageView depthImageView;
+    VkFormat depthFormat;
+    
+    // the scene renders into its own color target at renderExtent and the upscale pass stretches that over the swapchain
+    // image. the target is as big as the swapchain, dynamic resolution only shrinks the area that gets rendered
+    VkFormat sceneColorFormat;
+    VkImage sceneColorImage;
+    VkDeviceMemory sceneColorImageMemory;
+    VkImageView sceneColorImageView;
+    VkFramebuffer sceneFramebuffer;
+    VkExtent2D renderExtent;
+    VkRenderPass upscaleRenderPass;
+    VkDescriptorSetLayout upscaleDescriptorSetLayout;
+    VkDescriptorPool upscaleDescriptorPool; // comes and goes with the scene target, so its set never changes while in use
+    VkDescriptorSet upscaleDescriptorSet;
+    VkSampler upscaleSampler;
+    VkPipelineLayout upscalePipelineLayout;
+    VkPipeline upscalePipeline;
+    
+    // the controller gets the graphics submit's gpu time once the frame slot comes around again
+    bool useDynamicResolution = enableDynamicResolution;
+    neda::DynamicResolution dynamicResolution;
+    std::vector<VkQueryPool> frameTimeQueries; // start and end of the graphics submit
+    std::vector<bool> frameHasFrameTime;
+    std::vector<float> frameRenderScales; // what the frame was rendered at
+    
+    // the post chain, see PostProcess.hpp. it reads the hdr scene target and writes the swapchain image from compute
+    // when the surface allows storage, otherwise an hdr image that the upscale pass copies over. the bloom mips and
+    // the descriptor sets that point at them come and go with the swapchain, there is one set per pass of the chain
+    bool usePostProcessing = enablePostProcessing;
+    bool storageSwapchainSupported = false; // the composite writes the swapchain image
+    neda::PostSettings postSettings;
+    VkDescriptorSetLayout postDescriptorSetLayout;
+    VkPipelineLayout postPipelineLayout;
+    VkPipeline postPipelines[neda::POST_PASS_COUNT];
+    VkBuffer exposureBuffer;
+    VkDeviceMemory exposureBufferMemory;
+    bool exposureInitialized = false;
+    double lastPostUpdate = 0.0;
+    VkImage bloomImage;
+    VkDeviceMemory bloomImageMemory;
+    uint32_t bloomMipCount = 0;
+    std::vector<VkImageView> bloomMipViews;
+    VkImage postOutputImage = VK_NULL_HANDLE; // only without a storage swapchain
+    VkDeviceMemory postOutputImageMemory = VK_NULL_HANDLE;
+    VkImageView postOutputImageView = VK_NULL_HANDLE;
+    VkDescriptorPool postDescriptorPool;
+    VkDescriptorSet postPrefilterSet; // the exposure pass uses it too
+    std::vector<VkDescriptorSet> postDownsampleSets; // the one for mip i writes mip i, from 1 on
+    std::vector<VkDescriptorSet> postUpsampleSets; // the one for mip i reads mip i + 1
+    std::vector<VkDescriptorSet> postCompositeSets; // one per swapchain image with a storage swapchain, one otherwise
+
+    // for the stats in the window title
+    double lastTitleUpdate = 0.0;
+    uint32_t framesSinceTitleUpdate = 0;
+
+    // the binary semaphores are only for the swapchain, which can't use timelines
+    std::vector<VkSemaphore> imageAvailableSemaphores; // per frame in flight
+    std::vector<VkSemaphore> renderFinishedSemaphores; // per swapchain image, the presentation engine holds on to it until the image comes back
+    // a replaced swapchain and its renderFinished semaphores. a present can still be waiting on those after the submit that
+    // signaled them is done, so they only go to the deletion queue once the new swapchain has presented MAX_FRAMES_IN_FLIGHT times
+    std::vector<std::function<void()>> presentationHeldResources;
+    int presentsUntilReleased = 0;
     const int MAX_FRAMES_IN_FLIGHT = 2;
-    std::vector<VkFence> inFlightFences;
     size_t currentFrame = 0;
-    std::vector<VkFence> imagesInFlight;
+    
+    // everything else waits on the queue's timeline. a frame slot can be reused once the value its last submit signaled is reached
+    neda::TimelineFunctions timelineFunctions;
+    neda::QueueTimeline graphicsTimeline;
+    std::vector<uint64_t> frameTimelineValues;
+    neda::QueueTimeline computeTimeline; // only created with async compute
+    std::vector<uint64_t> frameComputeValues; // normally done with the graphics value, unless the frame stopped at the acquire
+    
+    // whatever gets replaced while frames are in flight, like everything that belongs to the swapchain on a resize
+    neda::DeletionQueue deletionQueue;
+    bool framebufferResized = false;
+    
+    // compute work goes to its own queue so it can overlap with the graphics queue. without one, or while
+    // the benchmark runs the serial half, it is recorded into the frame's graphics commands instead
+    uint32_t graphicsQueueFamily;
+    uint32_t computeQueueFamily;
+    bool asyncComputeSupported = false;
+    bool useAsyncCompute = true;
+    
+    struct ComputeFrame {
+        VkCommandPool pool;
+        VkCommandBuffer commandBuffer;
+        VkQueryPool timestamps; // start and end of the compute submit
+    };
+    std::vector<ComputeFrame> computeFrames;
+    
+    // gpu particles, see Particles.hpp. they are simulated on the async compute queue when there is one and in front
+    // of the render pass otherwise, either way only that queue touches the particle state. the graphics queue only
+    // reads the frame's draw buffer, handed over like the gpu culling results
+    bool useParticles = enableParticles;
+    VkDescriptorSetLayout particleDescriptorSetLayout;
+    VkDescriptorPool particleDescriptorPool;
+    std::vector<VkDescriptorSet> particleDescriptorSets;
+    VkPipelineLayout particleComputePipelineLayout;
+    VkPipeline particleComputePipelines[neda::PARTICLE_PASS_COUNT];
+    VkPipelineLayout particleRenderPipelineLayout;
+    VkPipeline particleRenderPipeline;
+    VkBuffer particleBuffer;
+    VkDeviceMemory particleBufferMemory;
+    VkBuffer particleDeadListBuffer;
+    VkDeviceMemory particleDeadListBufferMemory;
+    VkBuffer particleAliveListBuffer; // both alive lists
+    VkDeviceMemory particleAliveListBufferMemory;
+    VkBuffer particleCounterBuffer;
+    VkDeviceMemory particleCounterBufferMemory;
+    std::vector<VkBuffer> particleDrawBuffers; // per frame, the indirect draw and then the instances
+    std::vector<VkDeviceMemory> particleDrawBuffersMemory;
+    bool particlesInitialized = false;
+    uint32_t particleAliveList = 0; // the one the next simulation reads
+    neda::ParticleEmission particleEmission{200000.0f};
+    double lastParticleUpdate = 0.0;
+    
+    // skinned characters, see Animation.hpp. their poses are sampled and blended on the cpu by a job per group of
+    // characters, then skin.comp skins every character once into the frame's skinned vertex buffer in front of the
+    // shadow cascades. the cascades and the scene pass draw them from there with the usual pipelines, the world
+    // transform is part of the skinning so their instances only carry the tint
+    struct Character {
+        neda::Vec3 position;
+        float heading;
+        float scale;
+        float timeOffset;
+        float blendRate; // how fast it drifts between the two clips
+        neda::Vec3 color;
+    };
+    const uint32_t CHARACTER_COUNT = 256;
+    const uint32_t CHARACTERS_PER_ANIMATION_JOB = 16;
+    bool useSkinning = enableSkinning;
+    neda::Skeleton characterSkeleton;
+    std::vector<neda::AnimationClip> characterClips; // blended two at a time
+    std::vector<neda::SkinVertex> characterVertices; // the bind pose of one character
+    std::vector<Character> characters;
+    neda::BoundingSpheres characterBounds; // around the roots, as far as the joints reach
+    std::vector<uint32_t> visibleCharacters; // this frame's, for the scene pass
+    std::vector<uint32_t> shadowCharacters[neda::MAX_SHADOW_CASCADES]; // this frame's, for the cascades that get rendered
+    VkBuffer bindPoseBuffer;
+    VkDeviceMemory bindPoseBufferMemory;
+    VkBuffer characterInstanceBuffer;
+    VkDeviceMemory characterInstanceBufferMemory;
+    std::vector<VkBuffer> jointBuffers; // persistently mapped, every character's joint matrices
+    std::vector<VkDeviceMemory> jointBuffersMemory;
+    std::vector<neda::JointMatrix*> jointBuffersMapped;
+    std::vector<VkBuffer> skinnedVertexBuffers; // every character's vertices in world space, a vertex buffer in the Vertex layout
+    std::vector<VkDeviceMemory> skinnedVertexBuffersMemory;
+    VkDescriptorSetLayout skinDescriptorSetLayout;
+    VkDescriptorPool skinDescriptorPool;
+    std::vector<VkDescriptorSet> skinDescriptorSets;
+    VkPipelineLayout skinPipelineLayout;
+    VkPipeline skinPipeline;
+    
+    // the terrain is the one mesh big enough to be only partly in view, so it is cut into meshlets when it is built and
+    // a compute pass culls those into a compacted index buffer every frame, see Meshlets.hpp. it is drawn with one
+    // indexed indirect draw from the shared vertex buffer, and gets shadows without casting any, its slopes are gentle
+    const uint32_t TERRAIN_QUADS = 256; // along each side
+    const float TERRAIN_SIZE = 512.0f;
+    const uint32_t TERRAIN_TILE = 7; // 7x7 quads are 64 vertices, the index order goes tile by tile so every tile is a meshlet
+    bool useMeshlets = enableMeshlets;
+    neda::MeshletMesh terrainMeshlets;
+    uint32_t terrainFirstVertex;
+    VkBuffer terrainInstanceBuffer;
+    VkDeviceMemory terrainInstanceBufferMemory;
+    VkBuffer meshletBuffer;
+    VkDeviceMemory meshletBufferMemory;
+    VkBuffer meshletVertexBuffer;
+    VkDeviceMemory meshletVertexBufferMemory;
+    VkBuffer meshletTriangleBuffer;
+    VkDeviceMemory meshletTriangleBufferMemory;
+    std::vector<VkBuffer> meshletIndexBuffers; // this frame's visible triangles
+    std::vector<VkDeviceMemory> meshletIndexBuffersMemory;
+    std::vector<VkBuffer> meshletDrawBuffers; // VkDrawIndexedIndirectCommand
+    std::vector<VkDeviceMemory> meshletDrawBuffersMemory;
+    VkDescriptorSetLayout meshletDescriptorSetLayout;
+    VkDescriptorPool meshletDescriptorPool;
+    std::vector<VkDescriptorSet> meshletDescriptorSets;
+    VkPipelineLayout meshletPipelineLayout;
+    VkPipeline meshletPipeline;
+    
+    // gpu culling: every object gets a bucket (its pipeline, material and mesh) with room for all its objects,
+    // the compute shader appends the visible ones and counts them in the bucket's indirect draw
+    struct GpuCullObject {
+        neda::Vec3 center;
+        uint32_t bucket;
+        neda::Vec3 extent;
+        uint32_t firstInstance;
+        neda::Vec3 position;
+        float pad0;
+        neda::Vec3 scale;
+        float pad1;
+        neda::Vec3 color;
+        float pad2;
+    };
+    struct CullPushConstants {
+        float planes[6][4];
+        uint32_t objectCount;
+    };
+    bool gpuCullingSupported = false; // needs drawIndirectFirstInstance
+    bool useGpuCulling = enableGpuCulling;
+    std::vector<neda::DrawBatch> gpuCullBuckets; // the batches of the whole scene sorted once, firstItem is the instance range
+    VkBuffer gpuCullObjectBuffer;
+    VkDeviceMemory gpuCullObjectBufferMemory;
+    VkBuffer gpuCullDrawTemplateBuffer; // the buckets' draws with instanceCount 0, copied over the frame's draws before culling
+    VkDeviceMemory gpuCullDrawTemplateBufferMemory;
+    std::vector<VkBuffer> gpuCullInstanceBuffers; // per frame in flight, written by the compute shader
+    std::vector<VkDeviceMemory> gpuCullInstanceBuffersMemory;
+    std::vector<VkBuffer> gpuCullDrawBuffers;
+    std::vector<VkDeviceMemory> gpuCullDrawBuffersMemory;
+    VkDescriptorSetLayout cullDescriptorSetLayout;
+    VkDescriptorPool cullDescriptorPool;
+    std::vector<VkDescriptorSet> cullDescriptorSets;
+    VkPipelineLayout cullPipelineLayout;
+    VkPipeline cullPipeline;
+    
+    // timestamps of the graphics submit: frame start, frame end, and the compute part when it runs serially
+    std::vector<VkQueryPool> graphicsTimestamps;
+    std::vector<bool> frameHasTimestamps;
+    std::vector<neda::OverlapBenchmark::Mode> frameBenchmarkModes;
+    float timestampPeriod = 1.0f; // nanoseconds per tick
+    neda::OverlapBenchmark benchmark;
+    
+    // profiling builds put the gpu work of both queues into the trace next to the cpu zones
+    bool gpuProfilingSupported = false; // needs timestamps on both queues
+    bool calibratedTimestampsSupported = false;
+    bool physicalDeviceProperties2Enabled = false; // what timeline semaphores and calibrated timestamps need on a 1.0 instance
+    neda::GpuClock gpuClock;
+    neda::GpuProfiler graphicsProfiler;
+    neda::GpuProfiler computeProfiler; // only created with async compute
+    std::string tracePath = "trace.json";
+    
+    // a capture records the inputs and the engine level commands of every frame, a replay feeds the inputs back in and
+    // compares what gets recorded with the capture. see CommandLog.hpp
+    neda::CommandRecorder commandRecorder;
+    std::string capturePath;
+    std::string replayPath;
+    neda::CaptureLog replayLog;
+    bool replaying = false;
+    bool headless = false;
+    uint32_t replayFrame = 0; // the next captured frame
+    std::vector<uint32_t> frameReplayFrames; // the captured frame each slot's submit replays, for its gpu time
+    neda::ReplayTimings replayTimings;
+    double frameTime = 0.0; // what everything animates with this frame, the captured time when replaying
+    bool frameTimeSupported = false; // the graphics queue has timestamps
+    uint32_t visibleCharacterCount = 0;
 
     
     const std::vector<const char*> deviceExtensions = {
-        VK_KHR_SWAPCHAIN_EXTENSION_NAME
+        VK_KHR_SWAPCHAIN_EXTENSION_NAME,
+        VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME
     };
 
     
 
     void initWindow(){
+        if (headless) return;
         glfwInit();
         glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-        glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+        glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
         
-        window = glfwCreateWindow(WIDTH, HEIGHT, "NedaEngine", nullptr, nullptr);
+        // a replay in a window starts at the captured size
+        window = glfwCreateWindow(replaying ? replayLog.width : WIDTH, replaying ? replayLog.height : HEIGHT, "NedaEngine", nullptr, nullptr);
+        glfwSetWindowUserPointer(window, this);
+        glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
+    }
+    
+    // not every platform reports out of date on a resize, so the flag makes sure the swapchain gets recreated anyway
+    static void framebufferResizeCallback(GLFWwindow* window, int width, int height) {
+        auto app = reinterpret_cast<HelloTriangleApplication*>(glfwGetWindowUserPointer(window));
+        app->framebufferResized = true;
     }
     
     void initVulkan() {
@@ -108,58 +596,274 @@ private:
         createLogicalDevice();
         createSwapChain();
         createImageViews();
+        // everything created from here on is part of a capture, and what a replay compares with it
+        if (!capturePath.empty()) {
+            commandRecorder.capture(capturePath, captureFlags(), swapChainExtent.width, swapChainExtent.height);
+        } else if (replaying) {
+            commandRecorder.record();
+        }
+        depthFormat = findDepthFormat();
+        shadowFormat = findShadowFormat();
+        // hdr when the post chain tonemaps it, otherwise it is presented as is
+        sceneColorFormat = usePostProcessing ? VK_FORMAT_R16G16B16A16_SFLOAT : swapChainImageFormat;
         createRenderPass();
-        createGraphicsPipeline();
-        createFramebuffers();
-        createCommandPool();
-        createCommandBuffers();
+        createUpscaleRenderPass();
+        createShadowRenderPasses();
+        createLightingDescriptorSetLayout(); // the scene pipelines' layout needs it
+        createScene();
+        createCharacters();
+        createTerrain();
+
+        // compiling the pipeline is the slow part of startup, so it runs on a worker while the rest gets created
+        neda::TaskGraph initGraph;
+        initGraph.addTask("createGraphicsPipeline", [this] { createGraphicsPipeline(); });
+        neda::TaskGraph::TaskId depthResources = initGraph.addTask("createDepthResources", [this] { createDepthResources(); });
+        neda::TaskGraph::TaskId framebuffers = initGraph.addTask("createFramebuffers", [this] { createFramebuffers(); });
+        neda::TaskGraph::TaskId upscalePipeline = initGraph.addTask("createUpscalePipeline", [this] { createUpscalePipeline(); });
+        neda::TaskGraph::TaskId sceneColor = initGraph.addTask("createSceneColorResources", [this] { createSceneColorResources(); });
+        neda::TaskGraph::TaskId postPipelines = initGraph.addTask("createPostPipelines", [this] { createPostPipelines(); });
+        neda::TaskGraph::TaskId postResources = initGraph.addTask("createPostResources", [this] { createPostResources(); });
+        neda::TaskGraph::TaskId commandPools = initGraph.addTask("createCommandPool", [this] { createCommandPool(); });
+        neda::TaskGraph::TaskId commandBuffers = initGraph.addTask("createCommandBuffers", [this] { createCommandBuffers(); });
+        neda::TaskGraph::TaskId vertexBuffers = initGraph.addTask("createVertexBuffer", [this] { createVertexBuffer(); });
+        initGraph.addTask("createInstanceBuffers", [this] { createInstanceBuffers(); });
+        initGraph.addTask("createIndirectBuffers", [this] { createIndirectBuffers(); });
+        initGraph.addTask("createComputeCommands", [this] { createComputeCommands(); });
+        initGraph.addTask("createParticleResources", [this] { createParticleResources(); });
+        neda::TaskGraph::TaskId skinningResources = initGraph.addTask("createSkinningResources", [this] { createSkinningResources(); });
+        neda::TaskGraph::TaskId meshletResources = initGraph.addTask("createMeshletResources", [this] { createMeshletResources(); });
+        neda::TaskGraph::TaskId shadowResources = initGraph.addTask("createShadowResources", [this] { createShadowResources(); });
+        neda::TaskGraph::TaskId lightingResources = initGraph.addTask("createLightingResources", [this] { createLightingResources(); });
+        neda::TaskGraph::TaskId gpuCulling = initGraph.addTask("createGpuCullingResources", [this] { createGpuCullingResources(); });
+        initGraph.precede(depthResources, framebuffers);
+        initGraph.precede(upscalePipeline, sceneColor); // the target's descriptor set needs the layout and sampler
+        initGraph.precede(sceneColor, framebuffers);
+        initGraph.precede(sceneColor, postResources); // the scene target and the upscale sampler go into the sets
+        initGraph.precede(postPipelines, postResources);
+        initGraph.precede(commandPools, commandBuffers);
+        initGraph.precede(commandPools, vertexBuffers);
+        initGraph.precede(vertexBuffers, gpuCulling); // both upload through the same pool
+        initGraph.precede(vertexBuffers, skinningResources); // the bind pose goes into the descriptor sets
+        initGraph.precede(vertexBuffers, meshletResources); // and the meshlets
+        initGraph.precede(shadowResources, lightingResources); // the lighting descriptors point at the shadow maps
+        initGraph.execute(jobSystem);
+        if (replaying && commandRecorder.resources() != replayLog.resources) {
+            std::cout << "the replay created other resources than the capture, its frames are unlikely to match" << std::endl;
+        }
+
         createSyncObjects();
     }
     
     void mainLoop() {
-        while(!glfwWindowShouldClose(window)){
-            glfwPollEvents();
-            drawFrame();;
+        // a replay stops at the end of its capture
+        while (headless || !glfwWindowShouldClose(window)) {
+            if (replaying && replayFrame == replayLog.frames.size()) break;
+            if (!headless) {
+                glfwPollEvents();
+            }
+            drawFrame();
+            if (!headless) {
+                updateWindowTitle();
+            }
         }
         
         vkDeviceWaitIdle(device);
+        
+        if (replaying) {
+            finishReplay();
+        }
+        if (neda::Profiler::enabled) {
+            writeTrace();
+        }
     }
     
     void cleanup() {
         
-          for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-                 vkDestroySemaphore(device, renderFinishedSemaphores[i], nullptr);
-                 vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
-                 vkDestroyFence(device, inFlightFences[i], nullptr);
+          // the device is idle by now, so flushing destroys the swapchain and anything still waiting right away
+          releaseSwapChainResources();
+          releasePresentationHeldResources();
+          deletionQueue.flush();
+        
+          for (auto semaphore : imageAvailableSemaphores) {
+                 vkDestroySemaphore(device, semaphore, hostAllocator.callbacks(VK_OBJECT_TYPE_SEMAPHORE));
+             }
+             graphicsTimeline.destroy();
+             if (asyncComputeSupported) {
+                 computeTimeline.destroy();
+             }
+             for (auto& computeFrame : computeFrames) {
+                 vkDestroyCommandPool(device, computeFrame.pool, hostAllocator.callbacks(VK_OBJECT_TYPE_COMMAND_POOL));
+                 vkDestroyQueryPool(device, computeFrame.timestamps, hostAllocator.callbacks(VK_OBJECT_TYPE_QUERY_POOL));
+             }
+             for (auto queryPool : graphicsTimestamps) {
+                 vkDestroyQueryPool(device, queryPool, hostAllocator.callbacks(VK_OBJECT_TYPE_QUERY_POOL));
+             }
+             for (auto queryPool : frameTimeQueries) {
+                 vkDestroyQueryPool(device, queryPool, hostAllocator.callbacks(VK_OBJECT_TYPE_QUERY_POOL));
+             }
+             graphicsProfiler.destroy();
+             computeProfiler.destroy();
+             
+             if (gpuCullingSupported) {
+                 vkDestroyPipeline(device, cullPipeline, hostAllocator.callbacks(VK_OBJECT_TYPE_PIPELINE));
+                 vkDestroyPipelineLayout(device, cullPipelineLayout, hostAllocator.callbacks(VK_OBJECT_TYPE_PIPELINE_LAYOUT));
+                 vkDestroyDescriptorPool(device, cullDescriptorPool, hostAllocator.callbacks(VK_OBJECT_TYPE_DESCRIPTOR_POOL));
+                 vkDestroyDescriptorSetLayout(device, cullDescriptorSetLayout, hostAllocator.callbacks(VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT));
+                 for (size_t i = 0; i < gpuCullInstanceBuffers.size(); i++) {
+                     vkDestroyBuffer(device, gpuCullInstanceBuffers[i], hostAllocator.callbacks(VK_OBJECT_TYPE_BUFFER));
+                     vkFreeMemory(device, gpuCullInstanceBuffersMemory[i], hostAllocator.callbacks(VK_OBJECT_TYPE_DEVICE_MEMORY));
+                     vkDestroyBuffer(device, gpuCullDrawBuffers[i], hostAllocator.callbacks(VK_OBJECT_TYPE_BUFFER));
+                     vkFreeMemory(device, gpuCullDrawBuffersMemory[i], hostAllocator.callbacks(VK_OBJECT_TYPE_DEVICE_MEMORY));
+                 }
+                 vkDestroyBuffer(device, gpuCullObjectBuffer, hostAllocator.callbacks(VK_OBJECT_TYPE_BUFFER));
+                 vkFreeMemory(device, gpuCullObjectBufferMemory, hostAllocator.callbacks(VK_OBJECT_TYPE_DEVICE_MEMORY));
+                 vkDestroyBuffer(device, gpuCullDrawTemplateBuffer, hostAllocator.callbacks(VK_OBJECT_TYPE_BUFFER));
+                 vkFreeMemory(device, gpuCullDrawTemplateBufferMemory, hostAllocator.callbacks(VK_OBJECT_TYPE_DEVICE_MEMORY));
+             }
+
+             for (auto pipeline : particleComputePipelines) {
+                 vkDestroyPipeline(device, pipeline, hostAllocator.callbacks(VK_OBJECT_TYPE_PIPELINE));
+             }
+             vkDestroyPipelineLayout(device, particleComputePipelineLayout, hostAllocator.callbacks(VK_OBJECT_TYPE_PIPELINE_LAYOUT));
+             vkDestroyPipeline(device, particleRenderPipeline, hostAllocator.callbacks(VK_OBJECT_TYPE_PIPELINE));
+             vkDestroyPipelineLayout(device, particleRenderPipelineLayout, hostAllocator.callbacks(VK_OBJECT_TYPE_PIPELINE_LAYOUT));
+             vkDestroyDescriptorPool(device, particleDescriptorPool, hostAllocator.callbacks(VK_OBJECT_TYPE_DESCRIPTOR_POOL));
+             vkDestroyDescriptorSetLayout(device, particleDescriptorSetLayout, hostAllocator.callbacks(VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT));
+             VkBuffer particleStateBuffers[] = {particleBuffer, particleDeadListBuffer, particleAliveListBuffer, particleCounterBuffer};
+             VkDeviceMemory particleStateMemory[] = {particleBufferMemory, particleDeadListBufferMemory, particleAliveListBufferMemory, particleCounterBufferMemory};
+             for (size_t i = 0; i < 4; i++) {
+                 vkDestroyBuffer(device, particleStateBuffers[i], hostAllocator.callbacks(VK_OBJECT_TYPE_BUFFER));
+                 vkFreeMemory(device, particleStateMemory[i], hostAllocator.callbacks(VK_OBJECT_TYPE_DEVICE_MEMORY));
+             }
+             for (size_t i = 0; i < particleDrawBuffers.size(); i++) {
+                 vkDestroyBuffer(device, particleDrawBuffers[i], hostAllocator.callbacks(VK_OBJECT_TYPE_BUFFER));
+                 vkFreeMemory(device, particleDrawBuffersMemory[i], hostAllocator.callbacks(VK_OBJECT_TYPE_DEVICE_MEMORY));
+             }
+
+             vkDestroyPipeline(device, skinPipeline, hostAllocator.callbacks(VK_OBJECT_TYPE_PIPELINE));
+             vkDestroyPipelineLayout(device, skinPipelineLayout, hostAllocator.callbacks(VK_OBJECT_TYPE_PIPELINE_LAYOUT));
+             vkDestroyDescriptorPool(device, skinDescriptorPool, hostAllocator.callbacks(VK_OBJECT_TYPE_DESCRIPTOR_POOL));
+             vkDestroyDescriptorSetLayout(device, skinDescriptorSetLayout, hostAllocator.callbacks(VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT));
+             for (size_t i = 0; i < jointBuffers.size(); i++) {
+                 vkDestroyBuffer(device, jointBuffers[i], hostAllocator.callbacks(VK_OBJECT_TYPE_BUFFER));
+                 vkFreeMemory(device, jointBuffersMemory[i], hostAllocator.callbacks(VK_OBJECT_TYPE_DEVICE_MEMORY));
+                 vkDestroyBuffer(device, skinnedVertexBuffers[i], hostAllocator.callbacks(VK_OBJECT_TYPE_BUFFER));
+                 vkFreeMemory(device, skinnedVertexBuffersMemory[i], hostAllocator.callbacks(VK_OBJECT_TYPE_DEVICE_MEMORY));
+             }
+             vkDestroyBuffer(device, bindPoseBuffer, hostAllocator.callbacks(VK_OBJECT_TYPE_BUFFER));
+             vkFreeMemory(device, bindPoseBufferMemory, hostAllocator.callbacks(VK_OBJECT_TYPE_DEVICE_MEMORY));
+             vkDestroyBuffer(device, characterInstanceBuffer, hostAllocator.callbacks(VK_OBJECT_TYPE_BUFFER));
+             vkFreeMemory(device, characterInstanceBufferMemory, hostAllocator.callbacks(VK_OBJECT_TYPE_DEVICE_MEMORY));
+             
+             vkDestroyPipeline(device, meshletPipeline, hostAllocator.callbacks(VK_OBJECT_TYPE_PIPELINE));
+             vkDestroyPipelineLayout(device, meshletPipelineLayout, hostAllocator.callbacks(VK_OBJECT_TYPE_PIPELINE_LAYOUT));
+             vkDestroyDescriptorPool(device, meshletDescriptorPool, hostAllocator.callbacks(VK_OBJECT_TYPE_DESCRIPTOR_POOL));
+             vkDestroyDescriptorSetLayout(device, meshletDescriptorSetLayout, hostAllocator.callbacks(VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT));
+             for (size_t i = 0; i < meshletIndexBuffers.size(); i++) {
+                 vkDestroyBuffer(device, meshletIndexBuffers[i], hostAllocator.callbacks(VK_OBJECT_TYPE_BUFFER));
+                 vkFreeMemory(device, meshletIndexBuffersMemory[i], hostAllocator.callbacks(VK_OBJECT_TYPE_DEVICE_MEMORY));
+                 vkDestroyBuffer(device, meshletDrawBuffers[i], hostAllocator.callbacks(VK_OBJECT_TYPE_BUFFER));
+                 vkFreeMemory(device, meshletDrawBuffersMemory[i], hostAllocator.callbacks(VK_OBJECT_TYPE_DEVICE_MEMORY));
+             }
+             VkBuffer terrainBuffers[] = {terrainInstanceBuffer, meshletBuffer, meshletVertexBuffer, meshletTriangleBuffer};
+             VkDeviceMemory terrainMemory[] = {terrainInstanceBufferMemory, meshletBufferMemory, meshletVertexBufferMemory, meshletTriangleBufferMemory};
+             for (size_t i = 0; i < 4; i++) {
+                 vkDestroyBuffer(device, terrainBuffers[i], hostAllocator.callbacks(VK_OBJECT_TYPE_BUFFER));
+                 vkFreeMemory(device, terrainMemory[i], hostAllocator.callbacks(VK_OBJECT_TYPE_DEVICE_MEMORY));
+             }
+
+             vkDestroyPipeline(device, shadowPipeline, hostAllocator.callbacks(VK_OBJECT_TYPE_PIPELINE));
+             vkDestroyRenderPass(device, shadowRenderPass, hostAllocator.callbacks(VK_OBJECT_TYPE_RENDER_PASS));
+             vkDestroyRenderPass(device, shadowStaticRenderPass, hostAllocator.callbacks(VK_OBJECT_TYPE_RENDER_PASS));
+             for (size_t i = 0; i < shadowFramebuffers.size(); i++) {
+                 vkDestroyFramebuffer(device, shadowFramebuffers[i], hostAllocator.callbacks(VK_OBJECT_TYPE_FRAMEBUFFER));
+                 vkDestroyImageView(device, shadowLayerViews[i], hostAllocator.callbacks(VK_OBJECT_TYPE_IMAGE_VIEW));
+                 vkDestroyFramebuffer(device, shadowStaticFramebuffers[i], hostAllocator.callbacks(VK_OBJECT_TYPE_FRAMEBUFFER));
+                 vkDestroyImageView(device, shadowStaticLayerViews[i], hostAllocator.callbacks(VK_OBJECT_TYPE_IMAGE_VIEW));
+             }
+             vkDestroyImage(device, shadowStaticImage, hostAllocator.callbacks(VK_OBJECT_TYPE_IMAGE));
+             vkFreeMemory(device, shadowStaticImageMemory, hostAllocator.callbacks(VK_OBJECT_TYPE_DEVICE_MEMORY));
+             vkDestroyImageView(device, shadowArrayView, hostAllocator.callbacks(VK_OBJECT_TYPE_IMAGE_VIEW));
+             vkDestroyImage(device, shadowImage, hostAllocator.callbacks(VK_OBJECT_TYPE_IMAGE));
+             vkFreeMemory(device, shadowImageMemory, hostAllocator.callbacks(VK_OBJECT_TYPE_DEVICE_MEMORY));
+             vkDestroySampler(device, shadowSampler, hostAllocator.callbacks(VK_OBJECT_TYPE_SAMPLER));
+             for (size_t i = 0; i < shadowParamBuffers.size(); i++) {
+                 vkDestroyBuffer(device, shadowParamBuffers[i], hostAllocator.callbacks(VK_OBJECT_TYPE_BUFFER));
+                 vkFreeMemory(device, shadowParamBuffersMemory[i], hostAllocator.callbacks(VK_OBJECT_TYPE_DEVICE_MEMORY));
+                 vkDestroyBuffer(device, shadowInstanceBuffers[i], hostAllocator.callbacks(VK_OBJECT_TYPE_BUFFER));
+                 vkFreeMemory(device, shadowInstanceBuffersMemory[i], hostAllocator.callbacks(VK_OBJECT_TYPE_DEVICE_MEMORY));
              }
 
-             vkDestroyCommandPool(device, commandPool, nullptr);
+             vkDestroyPipeline(device, lightBinningPipeline, hostAllocator.callbacks(VK_OBJECT_TYPE_PIPELINE));
+             vkDestroyPipelineLayout(device, lightBinningPipelineLayout, hostAllocator.callbacks(VK_OBJECT_TYPE_PIPELINE_LAYOUT));
+             vkDestroyDescriptorPool(device, lightingDescriptorPool, hostAllocator.callbacks(VK_OBJECT_TYPE_DESCRIPTOR_POOL));
+             vkDestroyDescriptorSetLayout(device, lightingDescriptorSetLayout, hostAllocator.callbacks(VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT));
+             for (size_t i = 0; i < lightBuffers.size(); i++) {
+                 vkDestroyBuffer(device, lightBuffers[i], hostAllocator.callbacks(VK_OBJECT_TYPE_BUFFER));
+                 vkFreeMemory(device, lightBuffersMemory[i], hostAllocator.callbacks(VK_OBJECT_TYPE_DEVICE_MEMORY));
+                 vkDestroyBuffer(device, clusterParamBuffers[i], hostAllocator.callbacks(VK_OBJECT_TYPE_BUFFER));
+                 vkFreeMemory(device, clusterParamBuffersMemory[i], hostAllocator.callbacks(VK_OBJECT_TYPE_DEVICE_MEMORY));
+                 vkDestroyBuffer(device, clusterBuffers[i], hostAllocator.callbacks(VK_OBJECT_TYPE_BUFFER));
+                 vkFreeMemory(device, clusterBuffersMemory[i], hostAllocator.callbacks(VK_OBJECT_TYPE_DEVICE_MEMORY));
+             }
 
-             for (auto framebuffer : swapChainFramebuffers) {
-                 vkDestroyFramebuffer(device, framebuffer, nullptr);
+             vkDestroyCommandPool(device, uploadCommandPool, hostAllocator.callbacks(VK_OBJECT_TYPE_COMMAND_POOL));
+             for (auto& frame : frameCommands) {
+                 vkDestroyCommandPool(device, frame.primaryPool, hostAllocator.callbacks(VK_OBJECT_TYPE_COMMAND_POOL));
+                 for (auto& threadPool : frame.threadPools) {
+                     vkDestroyCommandPool(device, threadPool.pool, hostAllocator.callbacks(VK_OBJECT_TYPE_COMMAND_POOL));
+                 }
              }
 
-             vkDestroyPipeline(device, graphicsPipeline, nullptr);
-             vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
-             vkDestroyRenderPass(device, renderPass, nullptr);
+             for (size_t i = 0; i < instanceBuffers.size(); i++) {
+                 vkDestroyBuffer(device, instanceBuffers[i], hostAllocator.callbacks(VK_OBJECT_TYPE_BUFFER));
+                 vkFreeMemory(device, instanceBuffersMemory[i], hostAllocator.callbacks(VK_OBJECT_TYPE_DEVICE_MEMORY));
+             }
+             for (size_t i = 0; i < indirectBuffers.size(); i++) {
+                 vkDestroyBuffer(device, indirectBuffers[i], hostAllocator.callbacks(VK_OBJECT_TYPE_BUFFER));
+                 vkFreeMemory(device, indirectBuffersMemory[i], hostAllocator.callbacks(VK_OBJECT_TYPE_DEVICE_MEMORY));
+                 vkDestroyBuffer(device, characterIndirectBuffers[i], hostAllocator.callbacks(VK_OBJECT_TYPE_BUFFER));
+                 vkFreeMemory(device, characterIndirectBuffersMemory[i], hostAllocator.callbacks(VK_OBJECT_TYPE_DEVICE_MEMORY));
+             }
+             vkDestroyBuffer(device, vertexBuffer, hostAllocator.callbacks(VK_OBJECT_TYPE_BUFFER));
+             vkFreeMemory(device, vertexBufferMemory, hostAllocator.callbacks(VK_OBJECT_TYPE_DEVICE_MEMORY));
 
-             for (auto imageView : swapChainImageViews) {
-                 vkDestroyImageView(device, imageView, nullptr);
+             for (auto pipeline : graphicsPipelines) {
+                 vkDestroyPipeline(device, pipeline, hostAllocator.callbacks(VK_OBJECT_TYPE_PIPELINE));
+             }
+             vkDestroyPipelineLayout(device, pipelineLayout, hostAllocator.callbacks(VK_OBJECT_TYPE_PIPELINE_LAYOUT));
+             vkDestroyRenderPass(device, renderPass, hostAllocator.callbacks(VK_OBJECT_TYPE_RENDER_PASS));
+             vkDestroyPipeline(device, upscalePipeline, hostAllocator.callbacks(VK_OBJECT_TYPE_PIPELINE));
+             vkDestroyPipelineLayout(device, upscalePipelineLayout, hostAllocator.callbacks(VK_OBJECT_TYPE_PIPELINE_LAYOUT));
+             vkDestroyDescriptorSetLayout(device, upscaleDescriptorSetLayout, hostAllocator.callbacks(VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT));
+             vkDestroySampler(device, upscaleSampler, hostAllocator.callbacks(VK_OBJECT_TYPE_SAMPLER));
+             vkDestroyRenderPass(device, upscaleRenderPass, hostAllocator.callbacks(VK_OBJECT_TYPE_RENDER_PASS));
+             if (usePostProcessing) {
+                 for (VkPipeline pipeline : postPipelines) {
+                     vkDestroyPipeline(device, pipeline, hostAllocator.callbacks(VK_OBJECT_TYPE_PIPELINE));
+                 }
+                 vkDestroyPipelineLayout(device, postPipelineLayout, hostAllocator.callbacks(VK_OBJECT_TYPE_PIPELINE_LAYOUT));
+                 vkDestroyDescriptorSetLayout(device, postDescriptorSetLayout, hostAllocator.callbacks(VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT));
+                 vkDestroyBuffer(device, exposureBuffer, hostAllocator.callbacks(VK_OBJECT_TYPE_BUFFER));
+                 vkFreeMemory(device, exposureBufferMemory, hostAllocator.callbacks(VK_OBJECT_TYPE_DEVICE_MEMORY));
              }
 
-             vkDestroySwapchainKHR(device, swapChain, nullptr);
-             vkDestroyDevice(device, nullptr);
+             vkDestroyDevice(device, hostAllocator.callbacks(VK_OBJECT_TYPE_DEVICE));
 
              if (enableValidationLayers) {
-                 DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
+                 DestroyDebugUtilsMessengerEXT(instance, debugMessenger, hostAllocator.callbacks(VK_OBJECT_TYPE_DEBUG_UTILS_MESSENGER_EXT));
              }
 
-             vkDestroySurfaceKHR(instance, surface, nullptr);
-             vkDestroyInstance(instance, nullptr);
-
-             glfwDestroyWindow(window);
+             vkDestroySurfaceKHR(instance, surface, hostAllocator.callbacks(VK_OBJECT_TYPE_SURFACE_KHR));
+             vkDestroyInstance(instance, hostAllocator.callbacks(VK_OBJECT_TYPE_INSTANCE));
+             
+             // anything still live here is a leak in the driver or in the cleanup above
+             hostAllocator.printReport(std::cout);
 
-             glfwTerminate();
+             if (!headless) {
+                 glfwDestroyWindow(window);
+                 glfwTerminate();
+             }
     }
     void createInstance(){
             if (enableValidationLayers && !checkValidationLayerSupport()) {
@@ -210,7 +914,7 @@ private:
     //        }
             
             
-            if (vkCreateInstance(&createInfo, nullptr, &instance) != VK_SUCCESS) {
+            if (vkCreateInstance(&createInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_INSTANCE), &instance) != VK_SUCCESS) {
                 throw std::runtime_error("failed to create instance!");
             }
     }
@@ -230,18 +934,32 @@ private:
         VkDebugUtilsMessengerCreateInfoEXT createInfo;
         populateDebugMessengerCreateInfo(createInfo);
 
-        if (CreateDebugUtilsMessengerEXT(instance, &createInfo, nullptr, &debugMessenger) != VK_SUCCESS) {
+        if (CreateDebugUtilsMessengerEXT(instance, &createInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_DEBUG_UTILS_MESSENGER_EXT), &debugMessenger) != VK_SUCCESS) {
             throw std::runtime_error("failed to set up debug messenger!");
         }
     }
 
     
     void createSurface(){
-          VkResult result = glfwCreateWindowSurface(instance, window, nullptr, &surface) ;
+          if (headless) {
+              createHeadlessSurface();
+              return;
+          }
+          VkResult result = glfwCreateWindowSurface(instance, window, hostAllocator.callbacks(VK_OBJECT_TYPE_SURFACE_KHR), &surface) ;
           if( result != VK_SUCCESS){
               throw std:: runtime_error("failed to create window surface");
           }
       }
+    
+    // a surface that presents nowhere, so everything after it runs exactly like with a window
+    void createHeadlessSurface() {
+        auto func = (PFN_vkCreateHeadlessSurfaceEXT) vkGetInstanceProcAddr(instance, "vkCreateHeadlessSurfaceEXT");
+        VkHeadlessSurfaceCreateInfoEXT createInfo{};
+        createInfo.sType = VK_STRUCTURE_TYPE_HEADLESS_SURFACE_CREATE_INFO_EXT;
+        if (func == nullptr || func(instance, &createInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_SURFACE_KHR), &surface) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create headless surface!");
+        }
+    }
       
     void pickPhysicalDevice(){
 
@@ -252,6 +970,10 @@ private:
         if (deviceCount == 0){
             throw std::runtime_error("no GPU's with Vulkan Support!");
         }
+        // the timeline semaphore feature can only be queried through it
+        if (!physicalDeviceProperties2Enabled) {
+            throw std::runtime_error("failed to find VK_KHR_get_physical_device_properties2, timeline semaphores need it!");
+        }
         
         std::vector<VkPhysicalDevice> devices(deviceCount);
         vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
@@ -270,35 +992,68 @@ private:
     
     void createLogicalDevice(){
         QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
-        float queuePriority = 1.0f;
+        float queuePriorities[] = {1.0f, 1.0f};
         
         std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-        std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily, indices.presentFamily};
+        std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily, indices.presentFamily, indices.computeFamily};
         
         for(auto queueFamily : uniqueQueueFamilies){ // loop through all the different queue families we want
             VkDeviceQueueCreateInfo queueCreateInfo{};
             queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
             queueCreateInfo.queueFamilyIndex = queueFamily;
-            queueCreateInfo.queueCount = 1;
-            queueCreateInfo.pQueuePriorities = &queuePriority;
+            queueCreateInfo.queueCount = queueFamily == indices.computeFamily ? indices.computeQueueIndex + 1 : 1; // the compute queue can be a second queue of the graphics family
+            queueCreateInfo.pQueuePriorities = queuePriorities;
             
             queueCreateInfos.push_back(queueCreateInfo);
 
         }
 
         /// specific device feature we might need
+        VkPhysicalDeviceFeatures supportedFeatures;
+        vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+        
+        // lets the render queue put several meshes that share a pipeline and material into one draw
+        multiDrawIndirectSupported = supportedFeatures.multiDrawIndirect && supportedFeatures.drawIndirectFirstInstance;
+        // the gpu culled buckets start at their own instance, which only indirect draws with firstInstance can do
+        gpuCullingSupported = supportedFeatures.drawIndirectFirstInstance;
+        useGpuCulling = useGpuCulling && gpuCullingSupported;
+        
+        // the post chain's composite can write the swapchain image directly if the surface takes storage usage in a
+        // format that allows it. those are bgra or rgba unorm, and the shader can only write bgra without a format
+        SwapChainSupportDetails swapChainSupport = querySwapChainSupport(physicalDevice);
+        VkSurfaceFormatKHR storageFormat;
+        storageSwapchainSupported = usePostProcessing && supportedFeatures.shaderStorageImageWriteWithoutFormat &&
+                                    (swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_STORAGE_BIT) &&
+                                    findStorageSurfaceFormat(swapChainSupport.formats, storageFormat);
+        
         VkPhysicalDeviceFeatures deviceFeatures{};
+        deviceFeatures.multiDrawIndirect = multiDrawIndirectSupported ? VK_TRUE : VK_FALSE;
+        deviceFeatures.drawIndirectFirstInstance = gpuCullingSupported ? VK_TRUE : VK_FALSE;
+        deviceFeatures.shaderStorageImageWriteWithoutFormat = storageSwapchainSupported ? VK_TRUE : VK_FALSE;
+        
+        // isDeviceSuitable made sure the feature is there
+        VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures{};
+        timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+        timelineFeatures.timelineSemaphore = VK_TRUE;
         
         VkDeviceCreateInfo createInfo{};
         createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+        createInfo.pNext = &timelineFeatures;
         createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
         createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
         createInfo.pEnabledFeatures = &deviceFeatures;
         
         //this is for other extensions we might be using like swap
-        createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-        createInfo.ppEnabledExtensionNames = deviceExtensions.data(); // add the extensions
+        std::vector<const char*> enabledExtensions = deviceExtensions;
+        // without it the trace pins the gpu timestamps to their submits instead, see GpuClock
+        calibratedTimestampsSupported = neda::Profiler::enabled && physicalDeviceProperties2Enabled &&
+                                        isDeviceExtensionSupported(physicalDevice, VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
+        if (calibratedTimestampsSupported) {
+            enabledExtensions.push_back(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
+        }
+        createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+        createInfo.ppEnabledExtensionNames = enabledExtensions.data(); // add the extensions
 
         if (enableValidationLayers) {
             createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
@@ -308,13 +1063,61 @@ private:
         }
         
         
-        if (vkCreateDevice(physicalDevice, &createInfo, nullptr, &device) != VK_SUCCESS) {
+        if (vkCreateDevice(physicalDevice, &createInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_DEVICE), &device) != VK_SUCCESS) {
             throw std::runtime_error("failed to create logical device!");
         }
         
         // the different queues got created, now we just have to get the handle
         vkGetDeviceQueue(device, indices.graphicsFamily, 0, &graphicsQueue);
         vkGetDeviceQueue(device, indices.presentFamily, 0, &presentQueue);
+        
+        vkGetDeviceQueue(device, indices.computeFamily, indices.computeQueueIndex, &computeQueue);
+        graphicsQueueFamily = indices.graphicsFamily;
+        computeQueueFamily = indices.computeFamily;
+        asyncComputeSupported = computeQueue != graphicsQueue;
+        useAsyncCompute = asyncComputeSupported;
+        
+        // created with the device since the uploads during init already submit through it
+        timelineFunctions.load(device);
+        graphicsTimeline.create(device, timelineFunctions, graphicsQueue, hostAllocator.callbacks(VK_OBJECT_TYPE_SEMAPHORE));
+        deletionQueue.addTimeline(graphicsTimeline);
+        if (asyncComputeSupported) {
+            computeTimeline.create(device, timelineFunctions, computeQueue, hostAllocator.callbacks(VK_OBJECT_TYPE_SEMAPHORE));
+            deletionQueue.addTimeline(computeTimeline);
+        }
+        
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+        timestampPeriod = properties.limits.timestampPeriod;
+        
+        uint32_t queueFamilyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+        if (benchmark.enabled && (queueFamilies[graphicsQueueFamily].timestampValidBits == 0 || queueFamilies[computeQueueFamily].timestampValidBits == 0)) {
+            throw std::runtime_error("failed to start benchmark, the queues don't support timestamps!");
+        }
+        if (benchmark.enabled && !gpuCullingSupported) {
+            throw std::runtime_error("failed to start benchmark, gpu culling isn't supported!");
+        }
+        
+        frameTimeSupported = queueFamilies[graphicsQueueFamily].timestampValidBits != 0;
+        if (replaying && !frameTimeSupported) {
+            std::cout << "no timestamps on the graphics queue, the replay only times the cpu" << std::endl;
+        }
+        if (useDynamicResolution && !frameTimeSupported) {
+            std::cout << "no timestamps on the graphics queue, rendering at full resolution" << std::endl;
+            useDynamicResolution = false;
+        }
+        
+        gpuProfilingSupported = neda::Profiler::enabled && queueFamilies[graphicsQueueFamily].timestampValidBits != 0 &&
+                                queueFamilies[computeQueueFamily].timestampValidBits != 0;
+        if (gpuProfilingSupported) {
+            gpuClock.create(instance, physicalDevice, device, timestampPeriod, calibratedTimestampsSupported);
+            if (!gpuClock.isCalibrated()) {
+                std::cout << "no calibrated timestamps, the gpu zones in the trace are only roughly lined up with the cpu ones" << std::endl;
+            }
+        }
     }
     
     void createSwapChain(){
@@ -337,8 +1140,8 @@ private:
         createInfo.imageFormat = surfaceFormat.format;
         createInfo.imageExtent = extent;
         createInfo.imageArrayLayers = 1; // 1 unless we want to make a 3d app
-        // if we want to do post proccesing we need to do dst_bit instead and not write dircetly to here;
-        createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        // the upscale pass renders to it, or the post chain writes it from compute
+        createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | (storageSwapchainSupported ? VK_IMAGE_USAGE_STORAGE_BIT : 0);
         
         QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
         uint32_t queueFamilyIndices[] = {indices.graphicsFamily, indices.presentFamily};
@@ -357,10 +1160,10 @@ private:
         createInfo.presentMode = presentMode;
         createInfo.clipped = VK_TRUE;
         
-        createInfo.oldSwapchain = VK_NULL_HANDLE; // incase the window is resized, we need a new swap chain so this is a refrence to the old one
+        createInfo.oldSwapchain = swapChain; // incase the window is resized, we need a new swap chain so this is a refrence to the old one
         
         
-        if(vkCreateSwapchainKHR(device, &createInfo, nullptr, &swapChain) != VK_SUCCESS){
+        if(vkCreateSwapchainKHR(device, &createInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_SWAPCHAIN_KHR), &swapChain) != VK_SUCCESS){
             throw std::runtime_error("failed to create swap chain!!");
         }
         
@@ -395,7 +1198,7 @@ private:
              createInfo.subresourceRange.baseArrayLayer = 0;
              createInfo.subresourceRange.layerCount = 1;
              
-             if (vkCreateImageView(device, &createInfo, nullptr, &swapChainImageViews[i]) != VK_SUCCESS) {
+             if (vkCreateImageView(device, &createInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_IMAGE_VIEW), &swapChainImageViews[i]) != VK_SUCCESS) {
                  throw std::runtime_error("failed to create image views!");
              }
          }
@@ -403,49 +1206,179 @@ private:
      }
     void createRenderPass(){ // this lets us tell vulkun have many frambuffer atachemts we will use when rendering
            VkAttachmentDescription colorAttachment{};
-           colorAttachment.format = swapChainImageFormat;
+           colorAttachment.format = sceneColorFormat;
            colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
            colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
            colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
            colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
            colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
            colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-           colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+           colorAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL; // the post chain or the upscale pass samples it
+           
+           VkAttachmentDescription depthAttachment{};
+           depthAttachment.format = depthFormat;
+           depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+           depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+           depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE; // nobody reads it after the pass
+           depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+           depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+           depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+           depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
            
-           VkSubpassDependency dependency{};
-           dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-           dependency.dstSubpass = 0;
-           dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-           dependency.srcAccessMask = 0;
-           dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-           dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+           // the depth and scene color images are shared by the frames in flight, so the previous frame's depth writes
+           // and its post chain or upscale reads have to be done too. those sample the color once this pass is done
+           VkSubpassDependency dependencies[2]{};
+           dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+           dependencies[0].dstSubpass = 0;
+           dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT |
+                                          VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+           dependencies[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+           dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+           dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+           dependencies[1].srcSubpass = 0;
+           dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+           dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+           dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+           dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+           dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
            
            
            VkAttachmentReference colorAttachmentRef{};
            colorAttachmentRef.attachment = 0;
            colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
            
+           VkAttachmentReference depthAttachmentRef{};
+           depthAttachmentRef.attachment = 1;
+           depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+           
            VkSubpassDescription subpass{};
            subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
            
            subpass.colorAttachmentCount = 1;
            subpass.pColorAttachments = &colorAttachmentRef;
+           subpass.pDepthStencilAttachment = &depthAttachmentRef;
            
+           VkAttachmentDescription attachments[] = {colorAttachment, depthAttachment};
            VkRenderPassCreateInfo renderPassInfo{};
            renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-           renderPassInfo.attachmentCount = 1;
-           renderPassInfo.pAttachments = &colorAttachment;
+           renderPassInfo.attachmentCount = 2;
+           renderPassInfo.pAttachments = attachments;
            renderPassInfo.subpassCount = 1;
            renderPassInfo.pSubpasses = &subpass;
            
-           renderPassInfo.dependencyCount = 1;
-           renderPassInfo.pDependencies = &dependency;
+           renderPassInfo.dependencyCount = 2;
+           renderPassInfo.pDependencies = dependencies;
 
-           if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
+           if (vkCreateRenderPass(device, &renderPassInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_RENDER_PASS), &renderPass) != VK_SUCCESS) {
                throw std::runtime_error("failed to create render pass!");
            }
        }
     
+    // stretches the scene target over the swapchain image, every pixel gets written so nothing is loaded
+    void createUpscaleRenderPass() {
+        VkAttachmentDescription colorAttachment{};
+        colorAttachment.format = swapChainImageFormat;
+        colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+        colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        
+        VkAttachmentReference colorAttachmentRef{};
+        colorAttachmentRef.attachment = 0;
+        colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        
+        VkSubpassDescription subpass{};
+        subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass.colorAttachmentCount = 1;
+        subpass.pColorAttachments = &colorAttachmentRef;
+        
+        // the image available semaphore is waited on at color output, the layout change has to come after it
+        VkSubpassDependency dependency{};
+        dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+        dependency.dstSubpass = 0;
+        dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        dependency.srcAccessMask = 0;
+        dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        
+        VkRenderPassCreateInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        renderPassInfo.attachmentCount = 1;
+        renderPassInfo.pAttachments = &colorAttachment;
+        renderPassInfo.subpassCount = 1;
+        renderPassInfo.pSubpasses = &subpass;
+        renderPassInfo.dependencyCount = 1;
+        renderPassInfo.pDependencies = &dependency;
+        
+        if (vkCreateRenderPass(device, &renderPassInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_RENDER_PASS), &upscaleRenderPass) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create upscale render pass!");
+        }
+    }
+    
+    // depth only, one cascade each. the static pass clears and leaves the static casters for the copy into the map,
+    // the other one loads that copy, adds the characters and leaves the map ready for the scene pass to sample
+    void createShadowRenderPasses() {
+        // the copy out of the last static render may still be reading it
+        createShadowRenderPass(VK_ATTACHMENT_LOAD_OP_CLEAR, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                               VK_PIPELINE_STAGE_TRANSFER_BIT, 0, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+                               shadowStaticRenderPass);
+        createShadowRenderPass(VK_ATTACHMENT_LOAD_OP_LOAD, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                               VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+                               shadowRenderPass);
+    }
+    
+    void createShadowRenderPass(VkAttachmentLoadOp loadOp, VkImageLayout initialLayout, VkImageLayout finalLayout,
+                                VkPipelineStageFlags srcStageMask, VkAccessFlags srcAccessMask,
+                                VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask, VkRenderPass& renderPass) {
+        VkAttachmentDescription depthAttachment{};
+        depthAttachment.format = shadowFormat;
+        depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+        depthAttachment.loadOp = loadOp;
+        depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        depthAttachment.initialLayout = initialLayout;
+        depthAttachment.finalLayout = finalLayout;
+        
+        VkAttachmentReference depthAttachmentRef{};
+        depthAttachmentRef.attachment = 0;
+        depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        
+        VkSubpassDescription subpass{};
+        subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass.pDepthStencilAttachment = &depthAttachmentRef;
+        
+        VkSubpassDependency dependencies[2]{};
+        dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+        dependencies[0].dstSubpass = 0;
+        dependencies[0].srcStageMask = srcStageMask;
+        dependencies[0].srcAccessMask = srcAccessMask;
+        dependencies[0].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        dependencies[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        dependencies[1].srcSubpass = 0;
+        dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+        dependencies[1].srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        dependencies[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        dependencies[1].dstStageMask = dstStageMask;
+        dependencies[1].dstAccessMask = dstAccessMask;
+        
+        VkRenderPassCreateInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        renderPassInfo.attachmentCount = 1;
+        renderPassInfo.pAttachments = &depthAttachment;
+        renderPassInfo.subpassCount = 1;
+        renderPassInfo.pSubpasses = &subpass;
+        renderPassInfo.dependencyCount = 2;
+        renderPassInfo.pDependencies = dependencies;
+        
+        if (vkCreateRenderPass(device, &renderPassInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_RENDER_PASS), &renderPass) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create shadow render pass!");
+        }
+    }
+    
     
     void createGraphicsPipeline(){
         auto vertShaderCode = readFile("vert.spv");
@@ -471,40 +1404,47 @@ private:
         VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
         
         // this specifies the type of input data for the vertext shader
+        // binding 0 is the mesh vertices, binding 1 steps once per instance
+        VkVertexInputBindingDescription bindingDescriptions[2]{};
+        bindingDescriptions[0].binding = 0;
+        bindingDescriptions[0].stride = sizeof(Vertex);
+        bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+        bindingDescriptions[1].binding = 1;
+        bindingDescriptions[1].stride = sizeof(InstanceData);
+        bindingDescriptions[1].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+        
+        VkVertexInputAttributeDescription attributeDescriptions[] = {
+            {0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, position)},
+            {1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, color)},
+            {2, 1, VK_FORMAT_R32G32B32_SFLOAT, offsetof(InstanceData, position)},
+            {3, 1, VK_FORMAT_R32G32B32_SFLOAT, offsetof(InstanceData, scale)},
+            {4, 1, VK_FORMAT_R32G32B32_SFLOAT, offsetof(InstanceData, color)},
+            {5, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, normal)},
+        };
+        
         VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
         vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-        vertexInputInfo.vertexBindingDescriptionCount = 0;
-        vertexInputInfo.pVertexBindingDescriptions = nullptr; // Optional
-        vertexInputInfo.vertexAttributeDescriptionCount = 0;
-        vertexInputInfo.pVertexAttributeDescriptions = nullptr; // Optional
+        vertexInputInfo.vertexBindingDescriptionCount = 2;
+        vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions;
+        vertexInputInfo.vertexAttributeDescriptionCount = 6;
+        vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions;
         
         VkPipelineInputAssemblyStateCreateInfo inputAssembly{}; // here we can do how it makes the triagnles from vertasies
         inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
         inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
         inputAssembly.primitiveRestartEnable = VK_FALSE;
         
-        // what section of framebuffer we want to render to
-        VkViewport viewport{};
-        viewport.x = 0.0f;
-        viewport.y = 0.0f;
-        viewport.width = (float) swapChainExtent.width;
-        viewport.height = (float) swapChainExtent.height;
-        viewport.minDepth = 0.0f;
-        viewport.maxDepth = 1.0f;
-        
-        // this lets you cut something off
-        VkRect2D scissor{};
-        scissor.offset = {0, 0};
-        scissor.extent = swapChainExtent;
-        
-        
-        // this puts the previous two things together
+        // the viewport and scissor are set while recording, so a resize doesn't have to rebuild the pipelines
         VkPipelineViewportStateCreateInfo viewportState{};
         viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
         viewportState.viewportCount = 1;
-        viewportState.pViewports = &viewport;
         viewportState.scissorCount = 1;
-        viewportState.pScissors = &scissor;
+        
+        VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+        VkPipelineDynamicStateCreateInfo dynamicState{};
+        dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+        dynamicState.dynamicStateCount = 2;
+        dynamicState.pDynamicStates = dynamicStates;
         
         // options fo the rasteriser
         VkPipelineRasterizationStateCreateInfo rasterizer{};
@@ -515,7 +1455,7 @@ private:
         rasterizer.polygonMode = VK_POLYGON_MODE_FILL;// how the polygons aref filled
         rasterizer.lineWidth = 1.0f;
         rasterizer.cullMode = VK_CULL_MODE_BACK_BIT; // culling
-        rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
+        rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE; // the meshes are wound counter clockwise
         
         rasterizer.depthBiasEnable = VK_FALSE; // sometimes used for somethign called shaddow mapping
         
@@ -538,10 +1478,27 @@ private:
         colorBlending.blendConstants[1] = 0.0f;
         colorBlending.blendConstants[2] = 0.0f;
         colorBlending.blendConstants[3] = 0.0f;
+        
+        VkPipelineDepthStencilStateCreateInfo depthStencil{};
+        depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+        depthStencil.depthTestEnable = VK_TRUE;
+        depthStencil.depthWriteEnable = VK_TRUE;
+        depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+        
+        // the camera's view projection matrix followed by the material
+        VkPushConstantRange pushConstantRange{};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = sizeof(neda::Mat4) + sizeof(MaterialConstants);
+        
         VkPipelineLayoutCreateInfo pipelineLayoutInfo{}; // using this we can setup uniferom varibles to pass to the shader
         pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &lightingDescriptorSetLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 
-        if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+        if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_PIPELINE_LAYOUT), &pipelineLayout) != VK_SUCCESS) {
             throw std::runtime_error("failed to create pipeline layout!");
         }
         
@@ -554,19 +1511,48 @@ private:
         pipelineInfo.pViewportState = &viewportState;
         pipelineInfo.pRasterizationState = &rasterizer;
         pipelineInfo.pMultisampleState = &multisampling;
-        pipelineInfo.pDepthStencilState = nullptr; // Optional
+        pipelineInfo.pDepthStencilState = &depthStencil;
         pipelineInfo.pColorBlendState = &colorBlending;
-        pipelineInfo.pDynamicState = nullptr; // Optional
+        pipelineInfo.pDynamicState = &dynamicState;
         
         pipelineInfo.layout = pipelineLayout;
         pipelineInfo.renderPass = renderPass;
         pipelineInfo.subpass = 0;
 
-        if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS) {
+        // the double sided one is for the walls, only the culling differs
+        VkGraphicsPipelineCreateInfo pipelineInfos[PIPELINE_COUNT] = {pipelineInfo, pipelineInfo};
+        VkPipelineRasterizationStateCreateInfo doubleSidedRasterizer = rasterizer;
+        doubleSidedRasterizer.cullMode = VK_CULL_MODE_NONE;
+        pipelineInfos[PIPELINE_DOUBLE_SIDED].pRasterizationState = &doubleSidedRasterizer;
+        
+        graphicsPipelines.resize(PIPELINE_COUNT);
+        if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, PIPELINE_COUNT, pipelineInfos, hostAllocator.callbacks(VK_OBJECT_TYPE_PIPELINE), graphicsPipelines.data()) != VK_SUCCESS) {
             throw std::runtime_error("failed to create graphics pipeline!");
         }
-        vkDestroyShaderModule(device, fragShaderModule, nullptr);
-        vkDestroyShaderModule(device, vertShaderModule, nullptr);
+        
+        // the shadow casters go through the same vertex shader with the cascade's matrix pushed instead of the camera's.
+        // no fragment shader, both sides are drawn so the walls cast, and the bias keeps the lit faces from shadowing themselves
+        VkPipelineRasterizationStateCreateInfo shadowRasterizer = rasterizer;
+        shadowRasterizer.cullMode = VK_CULL_MODE_NONE;
+        shadowRasterizer.depthBiasEnable = VK_TRUE;
+        shadowRasterizer.depthBiasConstantFactor = 1.25f;
+        shadowRasterizer.depthBiasSlopeFactor = 1.75f;
+        
+        VkPipelineColorBlendStateCreateInfo shadowColorBlending = colorBlending;
+        shadowColorBlending.attachmentCount = 0;
+        shadowColorBlending.pAttachments = nullptr;
+        
+        VkGraphicsPipelineCreateInfo shadowPipelineInfo = pipelineInfo;
+        shadowPipelineInfo.stageCount = 1;
+        shadowPipelineInfo.pStages = &vertShaderStageInfo;
+        shadowPipelineInfo.pRasterizationState = &shadowRasterizer;
+        shadowPipelineInfo.pColorBlendState = &shadowColorBlending;
+        shadowPipelineInfo.renderPass = shadowRenderPass;
+        if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &shadowPipelineInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_PIPELINE), &shadowPipeline) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create shadow pipeline!");
+        }
+        vkDestroyShaderModule(device, fragShaderModule, hostAllocator.callbacks(VK_OBJECT_TYPE_SHADER_MODULE));
+        vkDestroyShaderModule(device, vertShaderModule, hostAllocator.callbacks(VK_OBJECT_TYPE_SHADER_MODULE));
         
     }
     
@@ -574,25 +1560,36 @@ private:
            swapChainFramebuffers.resize(swapChainImageViews.size());
            
            for (size_t i = 0; i < swapChainImageViews.size(); i++) {
-               VkImageView attachments[] = {
-                   swapChainImageViews[i]
-               };
-
                VkFramebufferCreateInfo framebufferInfo{};
                framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-               framebufferInfo.renderPass = renderPass;
+               framebufferInfo.renderPass = upscaleRenderPass;
                framebufferInfo.attachmentCount = 1;
-               framebufferInfo.pAttachments = attachments;
+               framebufferInfo.pAttachments = &swapChainImageViews[i];
                framebufferInfo.width = swapChainExtent.width;
                framebufferInfo.height = swapChainExtent.height;
                framebufferInfo.layers = 1;
 
-               if (vkCreateFramebuffer(device, &framebufferInfo, nullptr, &swapChainFramebuffers[i]) != VK_SUCCESS) {
+               if (vkCreateFramebuffer(device, &framebufferInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_FRAMEBUFFER), &swapChainFramebuffers[i]) != VK_SUCCESS) {
                    throw std::runtime_error("failed to create framebuffer!");
                }
            }
            
-           
+           // the scene renders into the top left renderExtent of it
+           VkImageView attachments[] = {
+               sceneColorImageView,
+               depthImageView
+           };
+           VkFramebufferCreateInfo framebufferInfo{};
+           framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+           framebufferInfo.renderPass = renderPass;
+           framebufferInfo.attachmentCount = 2;
+           framebufferInfo.pAttachments = attachments;
+           framebufferInfo.width = swapChainExtent.width;
+           framebufferInfo.height = swapChainExtent.height;
+           framebufferInfo.layers = 1;
+           if (vkCreateFramebuffer(device, &framebufferInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_FRAMEBUFFER), &sceneFramebuffer) != VK_SUCCESS) {
+               throw std::runtime_error("failed to create framebuffer!");
+           }
        }
        
     
@@ -602,168 +1599,3273 @@ private:
           VkCommandPoolCreateInfo poolInfo{};
           poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
           poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily;
-          poolInfo.flags = 0; // Optional
+          poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT; // everything gets re-recorded each frame
 
-          if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+          if (vkCreateCommandPool(device, &poolInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_COMMAND_POOL), &uploadCommandPool) != VK_SUCCESS) {
               throw std::runtime_error("failed to create command pool!");
           }
+
+          frameCommands.resize(MAX_FRAMES_IN_FLIGHT);
+          for (auto& frame : frameCommands) {
+              if (vkCreateCommandPool(device, &poolInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_COMMAND_POOL), &frame.primaryPool) != VK_SUCCESS) {
+                  throw std::runtime_error("failed to create command pool!");
+              }
+
+              frame.threadPools.resize(jobSystem.threadCount());
+              for (auto& threadPool : frame.threadPools) {
+                  if (vkCreateCommandPool(device, &poolInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_COMMAND_POOL), &threadPool.pool) != VK_SUCCESS) {
+                      throw std::runtime_error("failed to create command pool!");
+                  }
+              }
+          }
       }
     
     void createCommandBuffers() {
-           commandBuffers.resize(swapChainFramebuffers.size());
-           VkCommandBufferAllocateInfo allocInfo{};
-           allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-           allocInfo.commandPool = commandPool;
-           allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-           allocInfo.commandBufferCount = (uint32_t) commandBuffers.size();
-
-           if (vkAllocateCommandBuffers(device, &allocInfo, commandBuffers.data()) != VK_SUCCESS) {
-               throw std::runtime_error("failed to allocate command buffers!");
-           }
-           
-           for (size_t i = 0; i < commandBuffers.size(); i++) {
-               VkCommandBufferBeginInfo beginInfo{};
-               beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+           // only the primary buffers are allocated up front, the secondary ones get allocated by the recording jobs as needed
+           for (auto& frame : frameCommands) {
+               VkCommandBufferAllocateInfo allocInfo{};
+               allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+               allocInfo.commandPool = frame.primaryPool;
+               allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+               allocInfo.commandBufferCount = 1;
 
-               if (vkBeginCommandBuffer(commandBuffers[i], &beginInfo) != VK_SUCCESS) {
-                   throw std::runtime_error("failed to begin recording command buffer!");
-               }
-               
-               
-               VkRenderPassBeginInfo renderPassInfo{};
-               renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-               renderPassInfo.renderPass = renderPass;
-               renderPassInfo.framebuffer = swapChainFramebuffers[i];
-               renderPassInfo.renderArea.offset = {0, 0};
-               renderPassInfo.renderArea.extent = swapChainExtent;
-               
-               VkClearValue clearColor = {0.0f, 0.0f, 0.0f, 1.0f};
-               renderPassInfo.clearValueCount = 1;
-               renderPassInfo.pClearValues = &clearColor;
-               
-               vkCmdBeginRenderPass(commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-               
-               vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
-               vkCmdDraw(commandBuffers[i], 3, 1, 0, 0);
-               
-               vkCmdEndRenderPass(commandBuffers[i]);
-               
-               if (vkEndCommandBuffer(commandBuffers[i]) != VK_SUCCESS) {
-                   throw std::runtime_error("failed to record command buffer!");
+               if (vkAllocateCommandBuffers(device, &allocInfo, &frame.primaryBuffer) != VK_SUCCESS) {
+                   throw std::runtime_error("failed to allocate command buffers!");
                }
-
-               
-               
            }
-           
-           
        }
-     
-    void createSyncObjects() {
-        imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-        renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-        inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-        imagesInFlight.resize(swapChainImages.size(), VK_NULL_HANDLE);
-
-        VkSemaphoreCreateInfo semaphoreInfo{};
-        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-
-        VkFenceCreateInfo fenceInfo{};
-        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-        fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-        
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-            if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) != VK_SUCCESS ||
-                vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS ||
-                vkCreateFence(device, &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS) {
-
-                throw std::runtime_error("failed to create synchronization objects for a frame!");
-            }
+    
+    // the pools of the current frame are free to reuse once its fence is signaled
+    void resetFrameCommands(FrameCommands& frame) {
+        vkResetCommandPool(device, frame.primaryPool, 0);
+        for (auto& threadPool : frame.threadPools) {
+            vkResetCommandPool(device, threadPool.pool, 0);
+            threadPool.usedSecondaryBuffers = 0;
         }
     }
-    void drawFrame() {
-        vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
-
-        uint32_t imageIndex;
-        vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
-
-        if (imagesInFlight[imageIndex] != VK_NULL_HANDLE) {
-            vkWaitForFences(device, 1, &imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
-        }
-        imagesInFlight[imageIndex] = inFlightFences[currentFrame];
-
-        VkSubmitInfo submitInfo{};
-        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-
-        VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame]};
-        VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-        submitInfo.waitSemaphoreCount = 1;
-        submitInfo.pWaitSemaphores = waitSemaphores;
-        submitInfo.pWaitDstStageMask = waitStages;
-
-        submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &commandBuffers[imageIndex];
-
-        VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame]};
-        submitInfo.signalSemaphoreCount = 1;
-        submitInfo.pSignalSemaphores = signalSemaphores;
-
-        vkResetFences(device, 1, &inFlightFences[currentFrame]);
+    
+    // hands out a secondary buffer from the pool of the thread that is calling
+    VkCommandBuffer acquireSecondaryCommandBuffer(FrameCommands& frame) {
+        ThreadCommandPool& threadPool = frame.threadPools[neda::JobSystem::currentThreadIndex()];
+        
+        if (threadPool.usedSecondaryBuffers == threadPool.secondaryBuffers.size()) {
+            VkCommandBufferAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.commandPool = threadPool.pool;
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+            allocInfo.commandBufferCount = 1;
 
-        if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS) {
-            throw std::runtime_error("failed to submit draw command buffer!");
+            VkCommandBuffer commandBuffer;
+            if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+                throw std::runtime_error("failed to allocate command buffers!");
+            }
+            threadPool.secondaryBuffers.push_back(commandBuffer);
         }
-
-        VkPresentInfoKHR presentInfo{};
-        presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-
-        presentInfo.waitSemaphoreCount = 1;
-        presentInfo.pWaitSemaphores = signalSemaphores;
-
-        VkSwapchainKHR swapChains[] = {swapChain};
-        presentInfo.swapchainCount = 1;
-        presentInfo.pSwapchains = swapChains;
-
-        presentInfo.pImageIndices = &imageIndex;
-
-        vkQueuePresentKHR(presentQueue, &presentInfo);
-
-        currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+        
+        return threadPool.secondaryBuffers[threadPool.usedSecondaryBuffers++];
     }
-    VkShaderModule createShaderModule(const std::vector<char>& code) {
-        VkShaderModuleCreateInfo createInfo{};
-        createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-        createInfo.codeSize = code.size();
-        createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
-
-        VkShaderModule shaderModule;
-        if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
-            throw std::runtime_error("failed to create shader module!");
+    
+    // splits the render queue's batches into chunks and records every chunk into its own secondary buffer on the job system,
+    // the returned buffers are in draw order. state is only bound when it changes from the previous batch
+    std::vector<VkCommandBuffer> recordSceneCommands(FrameCommands& frame) {
+        // gpu culled buckets draw however many instances the compute shader counted, straight from its draw buffer
+        const std::vector<neda::DrawBatch>& batches = useGpuCulling ? gpuCullBuckets : renderQueue.batches();
+        VkBuffer instanceBuffer = useGpuCulling ? gpuCullInstanceBuffers[currentFrame] : instanceBuffers[currentFrame];
+        uint32_t batchCount = static_cast<uint32_t>(batches.size());
+        uint32_t chunkCount = std::max(1u, std::min(jobSystem.threadCount(), batchCount / MIN_DRAWS_PER_RECORDING_JOB));
+        uint32_t batchesPerChunk = (batchCount + chunkCount - 1) / chunkCount;
+        std::vector<VkCommandBuffer> chunkBuffers(chunkCount);
+        std::vector<neda::RenderStats> chunkStats(chunkCount);
+        VkDrawIndirectCommand* indirectCommands = multiDrawIndirectSupported ? indirectBuffersMapped[currentFrame] : nullptr;
+        
+        VkCommandBufferInheritanceInfo inheritanceInfo{};
+        inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritanceInfo.renderPass = renderPass;
+        inheritanceInfo.subpass = 0;
+        inheritanceInfo.framebuffer = sceneFramebuffer;
+        
+        VkViewport viewport{0.0f, 0.0f, (float) renderExtent.width, (float) renderExtent.height, 0.0f, 1.0f};
+        VkRect2D scissor{{0, 0}, renderExtent};
+        
+        jobSystem.parallelFor(chunkCount, 1, [&](uint32_t firstChunk, uint32_t lastChunk) {
+            for (uint32_t chunk = firstChunk; chunk < lastChunk; chunk++) {
+                NEDA_PROFILE_ZONE("recordChunk");
+                VkCommandBuffer commandBuffer = acquireSecondaryCommandBuffer(frame);
+                neda::RenderStats& stats = chunkStats[chunk];
+                
+                VkCommandBufferBeginInfo beginInfo{};
+                beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+                beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+                beginInfo.pInheritanceInfo = &inheritanceInfo;
+                
+                if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+                    throw std::runtime_error("failed to begin recording command buffer!");
+                }
+                
+                // every mesh lives in the same vertex buffer, so a secondary buffer only binds it once
+                VkBuffer vertexBuffers[] = {vertexBuffer, instanceBuffer};
+                VkDeviceSize offsets[] = {0, 0};
+                vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, offsets);
+                stats.vertexBufferBinds++;
+                // all the pipelines share one layout, so the push constants survive pipeline binds
+                vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(neda::Mat4), &viewProjection);
+                // dynamic state isn't inherited from the primary buffer, every secondary one sets its own
+                vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+                vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &lightingDescriptorSets[currentFrame], 0, nullptr);
+                
+                uint32_t boundPipeline = UINT32_MAX;
+                uint32_t boundMaterial = UINT32_MAX;
+                uint32_t lastBatch = std::min(batchCount, (chunk + 1) * batchesPerChunk);
+                uint32_t i = chunk * batchesPerChunk;
+                while (i < lastBatch) {
+                    const neda::DrawBatch& batch = batches[i];
+                    if (batch.pipeline != boundPipeline) {
+                        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipelines[batch.pipeline]);
+                        boundPipeline = batch.pipeline;
+                        stats.pipelineBinds++;
+                    }
+                    if (batch.material != boundMaterial) {
+                        vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, sizeof(neda::Mat4), sizeof(MaterialConstants), &materials[batch.material].constants);
+                        boundMaterial = batch.material;
+                        stats.materialBinds++;
+                    }
+                    
+                    // the batches after this one with the same pipeline and material only differ by mesh
+                    uint32_t runEnd = i + 1;
+                    while (runEnd < lastBatch && batches[runEnd].pipeline == batch.pipeline && batches[runEnd].material == batch.material) {
+                        runEnd++;
+                    }
+                    
+                    if (useGpuCulling) {
+                        if (multiDrawIndirectSupported) {
+                            vkCmdDrawIndirect(commandBuffer, gpuCullDrawBuffers[currentFrame], i * sizeof(VkDrawIndirectCommand), runEnd - i, sizeof(VkDrawIndirectCommand));
+                            stats.drawCalls++;
+                        } else {
+                            for (uint32_t b = i; b < runEnd; b++) {
+                                vkCmdDrawIndirect(commandBuffer, gpuCullDrawBuffers[currentFrame], b * sizeof(VkDrawIndirectCommand), 1, sizeof(VkDrawIndirectCommand));
+                                stats.drawCalls++;
+                            }
+                        }
+                    } else if (multiDrawIndirectSupported && runEnd - i > 1) {
+                        // the command for batch b goes into slot b, so the run is already contiguous in the buffer
+                        for (uint32_t b = i; b < runEnd; b++) {
+                            const Mesh& mesh = meshes[batches[b].mesh];
+                            indirectCommands[b] = {mesh.vertexCount, batches[b].itemCount, mesh.firstVertex, batches[b].firstItem};
+                            stats.instances += batches[b].itemCount;
+                        }
+                        vkCmdDrawIndirect(commandBuffer, indirectBuffers[currentFrame], i * sizeof(VkDrawIndirectCommand), runEnd - i, sizeof(VkDrawIndirectCommand));
+                        stats.drawCalls++;
+                    } else {
+                        for (uint32_t b = i; b < runEnd; b++) {
+                            const Mesh& mesh = meshes[batches[b].mesh];
+                            vkCmdDraw(commandBuffer, mesh.vertexCount, batches[b].itemCount, mesh.firstVertex, batches[b].firstItem);
+                            stats.instances += batches[b].itemCount;
+                            stats.drawCalls++;
+                        }
+                    }
+                    i = runEnd;
+                }
+                
+                if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+                    throw std::runtime_error("failed to record command buffer!");
+                }
+                chunkBuffers[chunk] = commandBuffer;
+            }
+        });
+        
+        renderStats = neda::RenderStats();
+        for (const auto& stats : chunkStats) {
+            renderStats += stats;
         }
-
-        return shaderModule;
+        return chunkBuffers;
     }
     
-    // swap surface format == color depth
-    VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats) {
-        for (const auto& availableFormat : availableFormats) { // we want SRGB, but if we cant have that is doenst reallly matter
-            if (availableFormat.format == VK_FORMAT_B8G8R8A8_SRGB && availableFormat.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) {
-                return availableFormat;
+    // keys every visible object, sorts them and writes the instance data in sorted order,
+    // so a batch's instances are next to each other in the instance buffer
+    void buildRenderQueue() {
+        uint32_t visibleCount = static_cast<uint32_t>(visibleObjects.size());
+        renderQueue.reset(visibleCount);
+        
+        jobSystem.parallelFor(visibleCount, CULLING_BATCH_SIZE, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; i++) {
+                uint32_t index = visibleObjects[i];
+                const SceneObject& object = sceneObjects[index];
+                uint32_t depth = neda::SortKey::quantizeDepth(neda::length(object.position - cameraPosition), CAMERA_FAR_PLANE);
+                uint64_t key = neda::SortKey::make(RENDER_PASS_OPAQUE, materials[object.material].pipeline, object.material, object.mesh, depth);
+                renderQueue.set(i, key, index);
             }
+        });
+        
+        if (enableDrawSorting) {
+            renderQueue.sort();
         }
-        return availableFormats[0];
-
-    }
-    VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes) {
-        return VK_PRESENT_MODE_FIFO_KHR; // this is just were the swap chain acts as a quueue and if queue is full program has to wait
+        renderQueue.buildBatches(enableDrawSorting);
+        
+        InstanceData* instances = instanceBuffersMapped[currentFrame];
+        const std::vector<neda::RenderItem>& items = renderQueue.items();
+        jobSystem.parallelFor(visibleCount, CULLING_BATCH_SIZE, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; i++) {
+                const SceneObject& object = sceneObjects[items[i].object];
+                instances[i] = {object.position, object.scale, object.color};
+            }
+        });
     }
     
-    //swap extent == resolution of swap chain images
-    VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities) {
-        if (capabilities.currentExtent.width != UINT32_MAX) {
-            return capabilities.currentExtent;
+    // builds and runs this frame's task graph, then stitches the recorded secondary buffers into the primary one
+    // with gpu culling the async compute work is already submitted by now, otherwise it goes in front of the render pass
+    void recordFrame(FrameCommands& frame, uint32_t imageIndex, const neda::Frustum& frustum) {
+        std::vector<VkCommandBuffer> sceneCommandBuffers;
+        VkCommandBuffer particleCommandBuffer = VK_NULL_HANDLE;
+        VkCommandBuffer characterCommandBuffer = VK_NULL_HANDLE;
+        VkCommandBuffer terrainCommandBuffer = VK_NULL_HANDLE;
+        
+        neda::TaskGraph frameGraph;
+        frameGraph.addTask("updateShadows", [&] { updateShadows(); });
+        if (useSkinning) {
+            frameGraph.addTask("animateCharacters", [&] { animateCharacters(); });
+            frameGraph.addTask("recordCharacters", [&] { characterCommandBuffer = recordCharacterCommands(frame, frustum); });
+        }
+        if (useMeshlets) {
+            frameGraph.addTask("recordTerrain", [&] { terrainCommandBuffer = recordTerrainCommands(frame); });
+        }
+        if (useParticles) {
+            frameGraph.addTask("recordParticles", [&] { particleCommandBuffer = recordParticleCommands(frame); });
+        }
+        if (useGpuCulling) {
+            frameGraph.addTask("recordScene", [&] { sceneCommandBuffers = recordSceneCommands(frame); });
         } else {
-            VkExtent2D actualExtent = {WIDTH, HEIGHT};
+            neda::TaskGraph::TaskId occluders = frameGraph.addTask("rasterizeOccluders", [&] { rasterizeOccluders(); });
+            neda::TaskGraph::TaskId frustumCulling = frameGraph.addTask("frustumCull", [&] { frustumCull(frustum); });
+            neda::TaskGraph::TaskId occlusionCulling = frameGraph.addTask("occlusionCull", [&] { occlusionCull(); });
+            neda::TaskGraph::TaskId queueBuilding = frameGraph.addTask("buildRenderQueue", [&] { buildRenderQueue(); });
+            neda::TaskGraph::TaskId recording = frameGraph.addTask("recordScene", [&] { sceneCommandBuffers = recordSceneCommands(frame); });
+            frameGraph.precede(occluders, occlusionCulling);
+            frameGraph.precede(frustumCulling, occlusionCulling);
+            frameGraph.precede(occlusionCulling, queueBuilding);
+            frameGraph.precede(queueBuilding, recording);
+        }
+        frameGraph.execute(jobSystem);
+        captureDraws();
+        // behind most of what is in front of it, so it goes after the scene
+        if (terrainCommandBuffer != VK_NULL_HANDLE) {
+            sceneCommandBuffers.push_back(terrainCommandBuffer);
+        }
+        if (characterCommandBuffer != VK_NULL_HANDLE) {
+            sceneCommandBuffers.push_back(characterCommandBuffer);
+        }
+        // additive, so they go after everything opaque
+        if (particleCommandBuffer != VK_NULL_HANDLE) {
+            sceneCommandBuffers.push_back(particleCommandBuffer);
+        }
+        
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+        if (vkBeginCommandBuffer(frame.primaryBuffer, &beginInfo) != VK_SUCCESS) {
+            throw std::runtime_error("failed to begin recording command buffer!");
+        }
+        
+        VkQueryPool timestamps = graphicsTimestamps[currentFrame];
+        if (benchmark.enabled) {
+            vkCmdResetQueryPool(frame.primaryBuffer, timestamps, 0, 4);
+            vkCmdWriteTimestamp(frame.primaryBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestamps, 0);
+        }
+        bool timeFrame = useDynamicResolution || (replaying && frameTimeSupported);
+        if (timeFrame) {
+            vkCmdResetQueryPool(frame.primaryBuffer, frameTimeQueries[currentFrame], 0, 2);
+            vkCmdWriteTimestamp(frame.primaryBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frameTimeQueries[currentFrame], 0);
+        }
+        if (graphicsProfiler.isCreated()) {
+            graphicsProfiler.beginFrame(frame.primaryBuffer, static_cast<uint32_t>(currentFrame));
+        }
+        
+        if (useGpuCulling && !useAsyncCompute) {
+            if (benchmark.enabled) {
+                vkCmdWriteTimestamp(frame.primaryBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestamps, 2);
+            }
+            {
+                NEDA_GPU_ZONE(graphicsProfiler, frame.primaryBuffer, "gpuCulling");
+                recordGpuCulling(frame.primaryBuffer, frustum);
+            }
+            if (benchmark.enabled) {
+                vkCmdWriteTimestamp(frame.primaryBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, timestamps, 3);
+            }
+        } else if (useGpuCulling) {
+            computeHandoff().acquire(frame.primaryBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                                     VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+        }
+        
+        if (useParticles && !asyncComputeSupported) {
+            NEDA_GPU_ZONE(graphicsProfiler, frame.primaryBuffer, "particles");
+            recordParticleSimulation(frame.primaryBuffer);
+        } else if (useParticles) {
+            particleHandoff().acquire(frame.primaryBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                                      VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+        }
+        
+        {
+            NEDA_GPU_ZONE(graphicsProfiler, frame.primaryBuffer, "lightBinning");
+            recordLightBinning(frame.primaryBuffer);
+        }
+        if (useSkinning) {
+            NEDA_GPU_ZONE(graphicsProfiler, frame.primaryBuffer, "skinning");
+            recordSkinning(frame.primaryBuffer);
+        }
+        if (useMeshlets) {
+            NEDA_GPU_ZONE(graphicsProfiler, frame.primaryBuffer, "meshletCulling");
+            recordMeshletCulling(frame.primaryBuffer, frustum);
+        }
+        if (shadowRenderMask != 0) {
+            NEDA_GPU_ZONE(graphicsProfiler, frame.primaryBuffer, "shadowCascades");
+            recordShadowCascades(frame.primaryBuffer);
+        }
+        
+        VkRenderPassBeginInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassInfo.renderPass = renderPass;
+        renderPassInfo.framebuffer = sceneFramebuffer;
+        renderPassInfo.renderArea.offset = {0, 0};
+        renderPassInfo.renderArea.extent = renderExtent;
+        
+        VkClearValue clearValues[2]{};
+        clearValues[0].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
+        clearValues[1].depthStencil = {1.0f, 0};
+        renderPassInfo.clearValueCount = 2;
+        renderPassInfo.pClearValues = clearValues;
+        
+        {
+            NEDA_GPU_ZONE(graphicsProfiler, frame.primaryBuffer, "scenePass");
+            vkCmdBeginRenderPass(frame.primaryBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+            vkCmdExecuteCommands(frame.primaryBuffer, static_cast<uint32_t>(sceneCommandBuffers.size()), sceneCommandBuffers.data());
+            vkCmdEndRenderPass(frame.primaryBuffer);
+        }
+        if (usePostProcessing) {
+            NEDA_GPU_ZONE(graphicsProfiler, frame.primaryBuffer, "postProcessing");
+            recordPostProcessing(frame.primaryBuffer, imageIndex);
+        }
+        if (!storageSwapchainSupported) {
+            NEDA_GPU_ZONE(graphicsProfiler, frame.primaryBuffer, "upscale");
+            recordUpscale(frame.primaryBuffer, imageIndex);
+        }
+        
+        if (benchmark.enabled) {
+            vkCmdWriteTimestamp(frame.primaryBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestamps, 1);
+        }
+        if (timeFrame) {
+            vkCmdWriteTimestamp(frame.primaryBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frameTimeQueries[currentFrame], 1);
+            frameHasFrameTime[currentFrame] = true;
+            frameRenderScales[currentFrame] = dynamicResolution.scale();
+        }
+        
+        if (vkEndCommandBuffer(frame.primaryBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to record command buffer!");
+        }
+    }
+     
+    // bloom, exposure, tonemapping and grading between the scene pass and the swapchain. the downsamples and upsamples
+    // depend on the one before, every other pass only waits for what it reads
+    void recordPostProcessing(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+        double now = frameTime;
+        float deltaTime = lastPostUpdate == 0.0 ? 1.0f / 60.0f : static_cast<float>(std::min(now - lastPostUpdate, 0.1));
+        lastPostUpdate = now;
+        
+        neda::PostPushConstants pushConstants = neda::makePostPushConstants(postSettings, bloomMipCount, deltaTime);
+        float width = (float) swapChainExtent.width;
+        float height = (float) swapChainExtent.height;
+        pushConstants.uvScale[0] = renderExtent.width / width;
+        pushConstants.uvScale[1] = renderExtent.height / height;
+        pushConstants.uvMax[0] = (renderExtent.width - 0.5f) / width;
+        pushConstants.uvMax[1] = (renderExtent.height - 0.5f) / height;
+        
+        if (!exposureInitialized) {
+            vkCmdFillBuffer(commandBuffer, exposureBuffer, 0, VK_WHOLE_SIZE, 0);
+            exposureInitialized = true;
+        }
+        
+        // the bloom mips and the output are written from scratch, so their old contents go. the last frame's chain
+        // has to be done with them and the exposure though, and the swapchain image's acquire is waited on at color output
+        VkImage outputImage = storageSwapchainSupported ? swapChainImages[imageIndex] : postOutputImage;
+        VkImageMemoryBarrier imageBarriers[2]{};
+        for (VkImageMemoryBarrier& imageBarrier : imageBarriers) {
+            imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            imageBarrier.srcAccessMask = 0;
+            imageBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+            imageBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            imageBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+            imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            imageBarrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+        }
+        imageBarriers[0].image = bloomImage;
+        imageBarriers[0].subresourceRange.levelCount = bloomMipCount;
+        imageBarriers[1].image = outputImage;
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+                             VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 2, imageBarriers);
+        
+        auto passBarrier = [&] {
+            barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+        };
+        auto mipExtent = [&](uint32_t mip) {
+            return VkExtent2D{neda::bloomMipSize(swapChainExtent.width, mip), neda::bloomMipSize(swapChainExtent.height, mip)};
+        };
+        auto run = [&](neda::PostPass pass, VkDescriptorSet set, VkExtent2D source, VkExtent2D target) {
+            pushConstants.sourceSize[0] = source.width;
+            pushConstants.sourceSize[1] = source.height;
+            pushConstants.targetSize[0] = target.width;
+            pushConstants.targetSize[1] = target.height;
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, postPipelines[pass]);
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, postPipelineLayout, 0, 1, &set, 0, nullptr);
+            vkCmdPushConstants(commandBuffer, postPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+            const uint32_t groupSize = neda::PostConfig::GROUP_SIZE;
+            uint32_t groupsX = (target.width + groupSize - 1) / groupSize;
+            uint32_t groupsY = (target.height + groupSize - 1) / groupSize;
+            vkCmdDispatch(commandBuffer, groupsX, groupsY, 1);
+            commandRecorder.dispatch(neda::CAPTURE_PASS_POST, groupsX, groupsY, 1);
+        };
+        
+        run(neda::POST_PASS_PREFILTER, postPrefilterSet, swapChainExtent, mipExtent(0));
+        passBarrier();
+        run(neda::POST_PASS_EXPOSURE, postPrefilterSet, {1, 1}, {1, 1}); // only touches the exposure, so it overlaps the first downsample
+        for (uint32_t mip = 1; mip < bloomMipCount; mip++) {
+            if (mip > 1) passBarrier();
+            run(neda::POST_PASS_DOWNSAMPLE, postDownsampleSets[mip], mipExtent(mip - 1), mipExtent(mip));
+        }
+        for (uint32_t mip = bloomMipCount - 1; mip-- > 0;) {
+            passBarrier();
+            run(neda::POST_PASS_UPSAMPLE, postUpsampleSets[mip], mipExtent(mip + 1), mipExtent(mip));
+        }
+        passBarrier();
+        run(neda::POST_PASS_COMPOSITE, postCompositeSets[storageSwapchainSupported ? imageIndex : 0], mipExtent(0), swapChainExtent);
+        
+        // straight to present, or to the upscale pass that copies it over
+        VkImageMemoryBarrier& outputBarrier = imageBarriers[1];
+        outputBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        outputBarrier.dstAccessMask = storageSwapchainSupported ? 0 : VK_ACCESS_SHADER_READ_BIT;
+        outputBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+        outputBarrier.newLayout = storageSwapchainSupported ? VK_IMAGE_LAYOUT_PRESENT_SRC_KHR : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             storageSwapchainSupported ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                             0, 0, nullptr, 0, nullptr, 1, &outputBarrier);
+    }
+    
+    // the rendered part of the scene target, or the post chain's output, stretched over the whole swapchain image
+    void recordUpscale(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+        VkRenderPassBeginInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassInfo.renderPass = upscaleRenderPass;
+        renderPassInfo.framebuffer = swapChainFramebuffers[imageIndex];
+        renderPassInfo.renderArea.offset = {0, 0};
+        renderPassInfo.renderArea.extent = swapChainExtent;
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        
+        VkViewport viewport{0.0f, 0.0f, (float) swapChainExtent.width, (float) swapChainExtent.height, 0.0f, 1.0f};
+        VkRect2D scissor{{0, 0}, swapChainExtent};
+        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, upscalePipeline);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, upscalePipelineLayout, 0, 1, &upscaleDescriptorSet, 0, nullptr);
+        
+        // the uvs stop half a texel inside the rendered part, past that the filter would blend in stale pixels. the
+        // post chain already upscaled, its output covers everything
+        VkExtent2D source = usePostProcessing ? swapChainExtent : renderExtent;
+        float width = (float) swapChainExtent.width;
+        float height = (float) swapChainExtent.height;
+        float uvs[4] = {
+            source.width / width, source.height / height,
+            (source.width - 0.5f) / width, (source.height - 0.5f) / height,
+        };
+        vkCmdPushConstants(commandBuffer, upscalePipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(uvs), uvs);
+        vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+        vkCmdEndRenderPass(commandBuffer);
+    }
+     
+    void createSyncObjects() {
+        imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
+        frameTimelineValues.resize(MAX_FRAMES_IN_FLIGHT, 0);
+        frameComputeValues.resize(MAX_FRAMES_IN_FLIGHT, 0);
+
+        VkSemaphoreCreateInfo semaphoreInfo{};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        
+        for (auto& semaphore : imageAvailableSemaphores) {
+            if (vkCreateSemaphore(device, &semaphoreInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_SEMAPHORE), &semaphore) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create synchronization objects for a frame!");
+            }
+        }
+        createRenderFinishedSemaphores();
+    }
+    
+    // one per swapchain image, so they come and go with the swapchain
+    void createRenderFinishedSemaphores() {
+        renderFinishedSemaphores.resize(swapChainImages.size());
+        
+        VkSemaphoreCreateInfo semaphoreInfo{};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        
+        for (auto& semaphore : renderFinishedSemaphores) {
+            if (vkCreateSemaphore(device, &semaphoreInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_SEMAPHORE), &semaphore) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create synchronization objects for a frame!");
+            }
+        }
+    }
+    void drawFrame() {
+        NEDA_PROFILE_ZONE("drawFrame");
+        
+        // once this frame slot's last submit is done, its command pools and instance buffer are free. the swapchain
+        // image doesn't need its own wait, the gpu waits for it through imageAvailable and nothing on the cpu is per image.
+        // the graphics submit waited on the slot's compute submit, so that one is done too
+        {
+            NEDA_PROFILE_ZONE("waitForFrameSlot");
+            graphicsTimeline.wait(frameTimelineValues[currentFrame]);
+            if (asyncComputeSupported) {
+                computeTimeline.wait(frameComputeValues[currentFrame]);
+            }
+        }
+        std::chrono::steady_clock::time_point cpuStart = std::chrono::steady_clock::now();
+        hostAllocator.beginFrame();
+        deletionQueue.collect();
+        if (neda::Profiler::enabled) {
+            collectGpuZones(static_cast<uint32_t>(currentFrame));
+        }
+        collectBenchmarkTimestamps();
+        advanceBenchmark();
+        collectFrameTime();
+        
+        // everything this frame renders at, the clusters included. a replay takes it and the time from the capture
+        if (replaying) {
+            const neda::CapturedFrame& captured = replayLog.frames[replayFrame];
+            frameTime = captured.time;
+            renderExtent = {std::min(captured.renderWidth, swapChainExtent.width), std::min(captured.renderHeight, swapChainExtent.height)};
+        } else {
+            frameTime = glfwGetTime();
+            renderExtent = {dynamicResolution.scaled(swapChainExtent.width), dynamicResolution.scaled(swapChainExtent.height)};
+        }
+        commandRecorder.beginFrame(frameTime, swapChainExtent.width, swapChainExtent.height, renderExtent.width, renderExtent.height);
+        updateCamera();
+        updateLights();
+        neda::Frustum frustum = neda::Frustum::fromViewProjection(viewProjection);
+        
+        uint32_t imageIndex;
+        VkResult acquireResult;
+        {
+            NEDA_PROFILE_ZONE("acquireNextImage");
+            acquireResult = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+        }
+        // the frame is dropped and the slot is reused next time, suboptimal still presents and recreates after
+        if (acquireResult == VK_ERROR_OUT_OF_DATE_KHR) {
+            frameHasTimestamps[currentFrame] = false; // the graphics queries never got written
+            frameHasFrameTime[currentFrame] = false;
+            recreateSwapChain();
+            return;
+        } else if (acquireResult != VK_SUCCESS && acquireResult != VK_SUBOPTIMAL_KHR) {
+            throw std::runtime_error("failed to acquire swap chain image!");
+        }
+
+        // only once the acquire went through. a dropped frame must not step the particles or leave a queue
+        // ownership release behind without its acquire, and a replay has to retry it from the same state
+        uint64_t computeValue = 0;
+        if ((useGpuCulling && useAsyncCompute) || (useParticles && asyncComputeSupported)) {
+            computeValue = submitAsyncCompute(frustum);
+            frameComputeValues[currentFrame] = computeValue;
+        }
+
+        FrameCommands& frame = frameCommands[currentFrame];
+        {
+            NEDA_PROFILE_ZONE("recordFrame");
+            resetFrameCommands(frame);
+            recordFrame(frame, imageIndex, frustum);
+        }
+
+        NEDA_PROFILE_ZONE("submitAndPresent");
+        neda::QueueSubmission submission;
+        submission.waitBinary(imageAvailableSemaphores[currentFrame], VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+        if (computeValue != 0) {
+            submission.waitTimeline(computeTimeline, computeValue, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+        }
+        submission.addCommandBuffer(frame.primaryBuffer);
+        submission.signalBinary(renderFinishedSemaphores[imageIndex]);
+        frameTimelineValues[currentFrame] = submission.submit(graphicsTimeline);
+        graphicsProfiler.submitted();
+        commandRecorder.endFrame();
+        if (replaying) {
+            finishReplayFrame(cpuStart);
+        }
+
+        VkPresentInfoKHR presentInfo{};
+        presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+
+        presentInfo.waitSemaphoreCount = 1;
+        presentInfo.pWaitSemaphores = &renderFinishedSemaphores[imageIndex];
+
+        VkSwapchainKHR swapChains[] = {swapChain};
+        presentInfo.swapchainCount = 1;
+        presentInfo.pSwapchains = swapChains;
+
+        presentInfo.pImageIndices = &imageIndex;
+
+        VkResult presentResult;
+        {
+            NEDA_PROFILE_ZONE("present");
+            presentResult = vkQueuePresentKHR(presentQueue, &presentInfo);
+        }
+
+        currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+        
+        if ((presentResult == VK_SUCCESS || presentResult == VK_SUBOPTIMAL_KHR) && !presentationHeldResources.empty() && --presentsUntilReleased == 0) {
+            releasePresentationHeldResources();
+        }
+        if (presentResult == VK_ERROR_OUT_OF_DATE_KHR || presentResult == VK_SUBOPTIMAL_KHR || framebufferResized) {
+            framebufferResized = false;
+            recreateSwapChain();
+        } else if (presentResult != VK_SUCCESS) {
+            throw std::runtime_error("failed to present swap chain image!");
+        }
+    }
+    
+    // builds a new swapchain and everything sized by it while the old ones are still in flight, the old ones
+    // go into the deletion queue and are destroyed once the frames that used them are done
+    void recreateSwapChain() {
+        // a minimized window has no size, there is nothing to draw until it comes back
+        int width = 0, height = 0;
+        while (!headless && (width == 0 || height == 0)) {
+            glfwGetFramebufferSize(window, &width, &height);
+            if (width == 0 || height == 0) {
+                glfwWaitEvents();
+            }
+        }
+        
+        NEDA_PROFILE_ZONE("recreateSwapChain");
+        releaseSwapChainResources();
+        createSwapChain(); // still sees the old handle and passes it as oldSwapchain
+        createImageViews();
+        createDepthResources();
+        createSceneColorResources();
+        createPostResources();
+        createFramebuffers();
+        createRenderFinishedSemaphores();
+    }
+    
+    // hands everything that belongs to the current swapchain to the deletion queue, or holds it for the presents first,
+    // the members keep the stale handles until they are replaced
+    void releaseSwapChainResources() {
+        for (VkFramebuffer framebuffer : swapChainFramebuffers) {
+            deletionQueue.release([this, framebuffer] { vkDestroyFramebuffer(device, framebuffer, hostAllocator.callbacks(VK_OBJECT_TYPE_FRAMEBUFFER)); });
+        }
+        for (VkImageView imageView : swapChainImageViews) {
+            deletionQueue.release([this, imageView] { vkDestroyImageView(device, imageView, hostAllocator.callbacks(VK_OBJECT_TYPE_IMAGE_VIEW)); });
+        }
+        // the presentation engine may still be waiting on these, the new swapchain's presents are what tells us it isn't
+        for (VkSemaphore semaphore : renderFinishedSemaphores) {
+            presentationHeldResources.push_back([this, semaphore] { vkDestroySemaphore(device, semaphore, hostAllocator.callbacks(VK_OBJECT_TYPE_SEMAPHORE)); });
+        }
+        
+        VkImage image = depthImage;
+        VkImageView imageView = depthImageView;
+        VkDeviceMemory memory = depthImageMemory;
+        deletionQueue.release([this, image, imageView, memory] {
+            vkDestroyImageView(device, imageView, hostAllocator.callbacks(VK_OBJECT_TYPE_IMAGE_VIEW));
+            vkDestroyImage(device, image, hostAllocator.callbacks(VK_OBJECT_TYPE_IMAGE));
+            vkFreeMemory(device, memory, hostAllocator.callbacks(VK_OBJECT_TYPE_DEVICE_MEMORY));
+        });
+        
+        VkFramebuffer framebuffer = sceneFramebuffer;
+        VkImage colorImage = sceneColorImage;
+        VkImageView colorImageView = sceneColorImageView;
+        VkDeviceMemory colorMemory = sceneColorImageMemory;
+        VkDescriptorPool descriptorPool = upscaleDescriptorPool;
+        deletionQueue.release([this, framebuffer, colorImage, colorImageView, colorMemory, descriptorPool] {
+            vkDestroyFramebuffer(device, framebuffer, hostAllocator.callbacks(VK_OBJECT_TYPE_FRAMEBUFFER));
+            vkDestroyDescriptorPool(device, descriptorPool, hostAllocator.callbacks(VK_OBJECT_TYPE_DESCRIPTOR_POOL));
+            vkDestroyImageView(device, colorImageView, hostAllocator.callbacks(VK_OBJECT_TYPE_IMAGE_VIEW));
+            vkDestroyImage(device, colorImage, hostAllocator.callbacks(VK_OBJECT_TYPE_IMAGE));
+            vkFreeMemory(device, colorMemory, hostAllocator.callbacks(VK_OBJECT_TYPE_DEVICE_MEMORY));
+        });
+        
+        if (usePostProcessing) {
+            VkImage postImage = postOutputImage;
+            VkImageView postImageView = postOutputImageView;
+            VkDeviceMemory postMemory = postOutputImageMemory;
+            VkImage bloom = bloomImage;
+            VkDeviceMemory bloomMemory = bloomImageMemory;
+            std::vector<VkImageView> bloomViews = bloomMipViews;
+            VkDescriptorPool postPool = postDescriptorPool;
+            deletionQueue.release([this, postImage, postImageView, postMemory, bloom, bloomMemory, bloomViews, postPool] {
+                vkDestroyDescriptorPool(device, postPool, hostAllocator.callbacks(VK_OBJECT_TYPE_DESCRIPTOR_POOL));
+                for (VkImageView view : bloomViews) {
+                    vkDestroyImageView(device, view, hostAllocator.callbacks(VK_OBJECT_TYPE_IMAGE_VIEW));
+                }
+                vkDestroyImage(device, bloom, hostAllocator.callbacks(VK_OBJECT_TYPE_IMAGE));
+                vkFreeMemory(device, bloomMemory, hostAllocator.callbacks(VK_OBJECT_TYPE_DEVICE_MEMORY));
+                // null with a storage swapchain, which vkDestroy* and vkFreeMemory ignore
+                vkDestroyImageView(device, postImageView, hostAllocator.callbacks(VK_OBJECT_TYPE_IMAGE_VIEW));
+                vkDestroyImage(device, postImage, hostAllocator.callbacks(VK_OBJECT_TYPE_IMAGE));
+                vkFreeMemory(device, postMemory, hostAllocator.callbacks(VK_OBJECT_TYPE_DEVICE_MEMORY));
+            });
+        }
+        
+        VkSwapchainKHR oldSwapChain = swapChain;
+        presentationHeldResources.push_back([this, oldSwapChain] { vkDestroySwapchainKHR(device, oldSwapChain, hostAllocator.callbacks(VK_OBJECT_TYPE_SWAPCHAIN_KHR)); });
+        presentsUntilReleased = MAX_FRAMES_IN_FLIGHT;
+    }
+    
+    // by then the old swapchain's presents are done, what is left is waiting for the submits like everything else
+    void releasePresentationHeldResources() {
+        for (auto& destroy : presentationHeldResources) {
+            deletionQueue.release(std::move(destroy));
+        }
+        presentationHeldResources.clear();
+    }
+    // a field of boxes and pyramids with some long walls in between that work as occluders
+    void createScene() {
+        // every face gets its own shade, it scales the ambient light so the unlit sides still read as 3d
+        const neda::Vec3 corners[8] = {
+            {-0.5f, -0.5f, -0.5f}, {0.5f, -0.5f, -0.5f}, {-0.5f, 0.5f, -0.5f}, {0.5f, 0.5f, -0.5f},
+            {-0.5f, -0.5f, 0.5f}, {0.5f, -0.5f, 0.5f}, {-0.5f, 0.5f, 0.5f}, {0.5f, 0.5f, 0.5f},
+        };
+        const int cubeFaces[6][4] = { // counter clockwise seen from outside
+            {4, 5, 7, 6}, {1, 0, 2, 3}, {5, 1, 3, 7}, {0, 4, 6, 2}, {6, 7, 3, 2}, {0, 1, 5, 4},
+        };
+        const float faceShades[6] = {0.8f, 0.6f, 0.7f, 0.5f, 1.0f, 0.3f};
+        
+        Mesh cube{static_cast<uint32_t>(vertices.size()), 36, {0.5f, 0.5f, 0.5f}};
+        for (int face = 0; face < 6; face++) {
+            neda::Vec3 shade(faceShades[face], faceShades[face], faceShades[face]);
+            const int* f = cubeFaces[face];
+            int triangles[6] = {f[0], f[1], f[2], f[0], f[2], f[3]};
+            neda::Vec3 normal = faceNormal(corners[f[0]], corners[f[1]], corners[f[2]]);
+            for (int corner : triangles) {
+                vertices.push_back({corners[corner], shade, normal});
+            }
+        }
+        meshes.push_back(cube);
+        
+        const neda::Vec3 apex(0.0f, 0.5f, 0.0f);
+        Mesh pyramid{static_cast<uint32_t>(vertices.size()), 18, {0.5f, 0.5f, 0.5f}};
+        const int baseEdges[4][2] = {{4, 5}, {5, 1}, {1, 0}, {0, 4}};
+        for (int side = 0; side < 4; side++) {
+            neda::Vec3 shade = neda::Vec3(1.0f, 1.0f, 1.0f) * faceShades[side];
+            neda::Vec3 normal = faceNormal(corners[baseEdges[side][0]], corners[baseEdges[side][1]], apex);
+            vertices.push_back({corners[baseEdges[side][0]], shade, normal});
+            vertices.push_back({corners[baseEdges[side][1]], shade, normal});
+            vertices.push_back({apex, shade, normal});
+        }
+        const int base[6] = {0, 1, 5, 0, 5, 4};
+        for (int corner : base) {
+            vertices.push_back({corners[corner], neda::Vec3(0.3f, 0.3f, 0.3f), neda::Vec3(0.0f, -1.0f, 0.0f)});
+        }
+        meshes.push_back(pyramid);
+        
+        materials = {
+            {PIPELINE_OPAQUE, {{1.0f, 1.0f, 1.0f, 1.0f}}},
+            {PIPELINE_OPAQUE, {{1.0f, 0.7f, 0.5f, 1.0f}}},
+            {PIPELINE_OPAQUE, {{0.5f, 0.7f, 1.0f, 1.0f}}},
+            {PIPELINE_DOUBLE_SIDED, {{0.8f, 0.8f, 0.8f, 1.0f}}},
+        };
+        const uint32_t WALL_MATERIAL = 3;
+        
+        std::mt19937 random(1337);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        
+        const int GRID_SIZE = 96;
+        const float SPACING = 3.0f;
+        for (int z = 0; z < GRID_SIZE; z++) {
+            for (int x = 0; x < GRID_SIZE; x++) {
+                SceneObject object{};
+                object.mesh = unit(random) < 0.7f ? 0 : 1;
+                object.material = static_cast<uint32_t>(unit(random) * 3.0f) % 3;
+                float size = 0.5f + unit(random) * 1.5f;
+                object.scale = {size, size, size};
+                object.position = {(x - GRID_SIZE / 2) * SPACING, size * 0.5f, (z - GRID_SIZE / 2) * SPACING};
+                object.color = {0.3f + 0.7f * unit(random), 0.3f + 0.7f * unit(random), 0.3f + 0.7f * unit(random)};
+                object.isOccluder = false;
+                sceneObjects.push_back(object);
+            }
+        }
+        
+        for (int i = 0; i < 24; i++) {
+            SceneObject wall{};
+            wall.mesh = 0;
+            wall.material = WALL_MATERIAL;
+            bool alongX = (i % 2) == 0;
+            wall.scale = alongX ? neda::Vec3(30.0f, 10.0f, 1.0f) : neda::Vec3(1.0f, 10.0f, 30.0f);
+            float range = GRID_SIZE * SPACING * 0.8f;
+            wall.position = {(unit(random) - 0.5f) * range, 5.0f, (unit(random) - 0.5f) * range};
+            wall.color = {0.9f, 0.9f, 0.9f};
+            wall.isOccluder = true;
+            occluderObjects.push_back(static_cast<uint32_t>(sceneObjects.size()));
+            sceneObjects.push_back(wall);
+        }
+        
+        for (const auto& object : sceneObjects) {
+            const neda::Vec3& extent = meshes[object.mesh].extent;
+            objectBounds.add(object.position, {extent.x * object.scale.x, extent.y * object.scale.y, extent.z * object.scale.z});
+        }
+        visibleObjects.resize(sceneObjects.size());
+        cullingScratch.resize(sceneObjects.size());
+        
+        // small lights circling between the objects, a quarter of them spot lights pointing down
+        lights.resize(LIGHT_COUNT);
+        for (auto& animated : lights) {
+            float range = GRID_SIZE * SPACING;
+            animated.orbitCenter = {(unit(random) - 0.5f) * range, 1.0f + unit(random) * 3.0f, (unit(random) - 0.5f) * range};
+            animated.orbitRadius = 1.0f + unit(random) * 6.0f;
+            animated.orbitSpeed = (unit(random) - 0.5f) * 1.5f;
+            animated.phase = unit(random) * 2.0f * neda::PI;
+            
+            neda::GpuLight& light = animated.light;
+            neda::Vec3 hue(unit(random), unit(random), unit(random));
+            light.color = neda::normalize(hue + neda::Vec3(0.2f, 0.2f, 0.2f)) * (8.0f + unit(random) * 12.0f);
+            light.direction = {0.0f, -1.0f, 0.0f};
+            if (unit(random) < 0.25f) {
+                light.radius = 10.0f + unit(random) * 6.0f;
+                light.cosOuter = std::cos(0.6f);
+                light.cosInner = std::cos(0.4f);
+            } else {
+                light.radius = 4.0f + unit(random) * 4.0f;
+                light.cosOuter = -1.0f;
+                light.cosInner = -0.9f;
+            }
+        }
+    }
+    
+    // a crowd of segmented stalks on a ring around the camera's path. every one loops two clips, a sway and a
+    // circling bend, and drifts between them at its own pace
+    void createCharacters() {
+        const uint32_t JOINT_COUNT = 8;
+        const float SEGMENT_LENGTH = 0.5f;
+        const float RADIUS = 0.25f;
+        const uint32_t SIDES = 8;
+        const uint32_t RINGS_PER_SEGMENT = 2;
+        const float HEIGHT = JOINT_COUNT * SEGMENT_LENGTH;
+        
+        // a chain, every joint a segment above its parent
+        for (uint32_t joint = 0; joint < JOINT_COUNT; joint++) {
+            characterSkeleton.parents.push_back(static_cast<int32_t>(joint) - 1);
+            neda::Mat4 inverseBind = neda::Mat4::identity();
+            inverseBind.at(1, 3) = -(joint * SEGMENT_LENGTH);
+            characterSkeleton.inverseBindMatrices.push_back(inverseBind);
+        }
+        
+        // a tapering tube. a ring belongs to the segments around it by how close it is to their middles
+        auto tubeVertex = [&](uint32_t ring, uint32_t side) {
+            float height = ring * SEGMENT_LENGTH / RINGS_PER_SEGMENT;
+            float angle = side * 2.0f * neda::PI / SIDES;
+            float radius = RADIUS * (1.0f - 0.6f * height / HEIGHT);
+            float segment = std::min(std::max(height / SEGMENT_LENGTH - 0.5f, 0.0f), JOINT_COUNT - 1.0f);
+            uint32_t lower = std::min(static_cast<uint32_t>(segment), JOINT_COUNT - 2);
+            float upperWeight = segment - lower;
+            
+            neda::SkinVertex vertex{};
+            vertex.position = {std::cos(angle) * radius, height, std::sin(angle) * radius};
+            vertex.normal = {std::cos(angle), 0.0f, std::sin(angle)};
+            vertex.color = neda::Vec3(1.0f, 1.0f, 1.0f) * (0.4f + 0.6f * height / HEIGHT);
+            vertex.joints = neda::packJoints(lower, lower + 1, 0, 0);
+            vertex.weights[0] = 1.0f - upperWeight;
+            vertex.weights[1] = upperWeight;
+            return vertex;
+        };
+        const uint32_t RING_COUNT = JOINT_COUNT * RINGS_PER_SEGMENT + 1;
+        for (uint32_t ring = 0; ring + 1 < RING_COUNT; ring++) {
+            for (uint32_t side = 0; side < SIDES; side++) {
+                uint32_t next = (side + 1) % SIDES;
+                neda::SkinVertex quad[4] = {tubeVertex(ring, side), tubeVertex(ring + 1, side), tubeVertex(ring + 1, next), tubeVertex(ring, next)};
+                const int triangles[6] = {0, 1, 2, 0, 2, 3};
+                for (int corner : triangles) {
+                    characterVertices.push_back(quad[corner]);
+                }
+            }
+        }
+        for (uint32_t side = 0; side < SIDES; side++) {
+            neda::SkinVertex cap[3] = {tubeVertex(RING_COUNT - 1, side), tubeVertex(RING_COUNT - 1, (side + 1) % SIDES), tubeVertex(RING_COUNT - 1, side)};
+            cap[0].position = {0.0f, HEIGHT, 0.0f};
+            for (neda::SkinVertex& vertex : cap) {
+                vertex.normal = {0.0f, 1.0f, 0.0f};
+                characterVertices.push_back(vertex);
+            }
+        }
+        
+        const float KEYS_PER_SECOND = 30.0f;
+        const uint32_t KEY_COUNT = 60;
+        neda::AnimationClip sway(characterSkeleton, KEYS_PER_SECOND);
+        neda::AnimationClip circle(characterSkeleton, KEYS_PER_SECOND);
+        neda::Pose pose;
+        pose.resize(characterSkeleton);
+        for (uint32_t joint = 1; joint < JOINT_COUNT; joint++) {
+            pose.setTranslation(joint, {0.0f, SEGMENT_LENGTH, 0.0f});
+        }
+        for (uint32_t key = 0; key < KEY_COUNT; key++) {
+            float phase = key * 2.0f * neda::PI / KEY_COUNT;
+            for (uint32_t joint = 0; joint < JOINT_COUNT; joint++) {
+                pose.setRotation(joint, {0.0f, 0.0f, 1.0f}, 0.18f * std::sin(phase - joint * 0.5f)); // a wave up the stalk
+            }
+            sway.addKey(pose);
+            for (uint32_t joint = 0; joint < JOINT_COUNT; joint++) {
+                pose.setRotation(joint, {std::cos(phase), 0.0f, std::sin(phase)}, 0.12f);
+            }
+            circle.addKey(pose);
+        }
+        sway.finish();
+        circle.finish();
+        characterClips = {sway, circle};
+        
+        std::mt19937 random(4242);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        characters.resize(CHARACTER_COUNT);
+        for (uint32_t i = 0; i < CHARACTER_COUNT; i++) {
+            Character& character = characters[i];
+            float angle = (i + unit(random) * 0.5f) * 2.0f * neda::PI / CHARACTER_COUNT;
+            float ringRadius = 50.0f + unit(random) * 8.0f;
+            character.position = {std::cos(angle) * ringRadius, 0.0f, std::sin(angle) * ringRadius};
+            character.heading = unit(random) * 2.0f * neda::PI;
+            character.scale = 0.7f + unit(random) * 0.5f;
+            character.timeOffset = unit(random) * 10.0f;
+            character.blendRate = 0.2f + unit(random) * 0.4f;
+            character.color = {0.6f + 0.4f * unit(random), 0.3f + 0.4f * unit(random), 0.2f + 0.3f * unit(random)};
+            // a bent chain still stays within its length of the root
+            characterBounds.add(character.position, (HEIGHT + RADIUS) * character.scale);
+        }
+        visibleCharacters.resize(CHARACTER_COUNT);
+    }
+    
+    // flat under the field and rising into hills outside it, a grid of quads in the shared vertex buffer
+    void createTerrain() {
+        const float FIELD_EDGE = 150.0f; // a bit past the outermost objects
+        const float HILL_START = 60.0f; // how far out the hills take to reach their full height
+        auto height = [&](float x, float z) {
+            float rise = std::min(std::max((std::max(std::abs(x), std::abs(z)) - FIELD_EDGE) / HILL_START, 0.0f), 1.0f);
+            float hills = 14.0f + 8.0f * std::sin(x * 0.045f) * std::cos(z * 0.037f) + 4.0f * std::sin(x * 0.11f + z * 0.13f);
+            return rise * rise * (3.0f - 2.0f * rise) * hills;
+        };
+        
+        const uint32_t side = TERRAIN_QUADS + 1;
+        const float spacing = TERRAIN_SIZE / TERRAIN_QUADS;
+        std::vector<neda::Vec3> positions;
+        terrainFirstVertex = static_cast<uint32_t>(vertices.size());
+        for (uint32_t row = 0; row < side; row++) {
+            for (uint32_t column = 0; column < side; column++) {
+                float x = column * spacing - TERRAIN_SIZE * 0.5f;
+                float z = row * spacing - TERRAIN_SIZE * 0.5f;
+                neda::Vec3 position(x, height(x, z), z);
+                neda::Vec3 normal = neda::normalize(neda::Vec3(height(x - spacing, z) - height(x + spacing, z), 2.0f * spacing,
+                                                               height(x, z - spacing) - height(x, z + spacing)));
+                float shade = 0.4f + 0.4f * normal.y; // darker on the slopes
+                vertices.push_back({position, neda::Vec3(shade, shade, shade), normal});
+                positions.push_back(position);
+            }
+        }
+        
+        // counter clockwise seen from above, tile by tile so the meshlets come out square
+        std::vector<uint32_t> indices;
+        for (uint32_t tileRow = 0; tileRow < TERRAIN_QUADS; tileRow += TERRAIN_TILE) {
+            for (uint32_t tileColumn = 0; tileColumn < TERRAIN_QUADS; tileColumn += TERRAIN_TILE) {
+                for (uint32_t row = tileRow; row < std::min(tileRow + TERRAIN_TILE, TERRAIN_QUADS); row++) {
+                    for (uint32_t column = tileColumn; column < std::min(tileColumn + TERRAIN_TILE, TERRAIN_QUADS); column++) {
+                        uint32_t corner = row * side + column;
+                        const uint32_t quad[6] = {corner, corner + side, corner + 1, corner + 1, corner + side, corner + side + 1};
+                        indices.insert(indices.end(), quad, quad + 6);
+                    }
+                }
+            }
+        }
+        terrainMeshlets = neda::buildMeshlets(positions, indices);
+    }
+    
+    // counter clockwise seen from the side it points to
+    static neda::Vec3 faceNormal(const neda::Vec3& a, const neda::Vec3& b, const neda::Vec3& c) {
+        return neda::normalize(neda::cross(b - a, c - a));
+    }
+    
+    // the camera circles through the field at head height
+    void updateCamera() {
+        float time = static_cast<float>(frameTime);
+        cameraPosition = neda::Vec3(std::cos(time * 0.1f) * 60.0f, 4.0f, std::sin(time * 0.1f) * 60.0f);
+        cameraForward = neda::normalize(neda::Vec3(-std::sin(time * 0.1f), -0.05f, std::cos(time * 0.1f)));
+        
+        float aspect = swapChainExtent.width / (float) swapChainExtent.height;
+        projectionMatrix = neda::Mat4::perspective(CAMERA_FOV_Y, aspect, CAMERA_NEAR_PLANE, CAMERA_FAR_PLANE);
+        viewMatrix = neda::Mat4::lookAt(cameraPosition, cameraPosition + cameraForward, {0.0f, 1.0f, 0.0f});
+        viewProjection = projectionMatrix * viewMatrix;
+    }
+    
+    // moves the lights and writes them with this frame's cluster parameters, after updateCamera
+    void updateLights() {
+        float time = static_cast<float>(frameTime);
+        neda::GpuLight* mapped = lightBuffersMapped[currentFrame];
+        for (uint32_t i = 0; i < LIGHT_COUNT; i++) {
+            const AnimatedLight& animated = lights[i];
+            float angle = animated.phase + time * animated.orbitSpeed;
+            neda::GpuLight light = animated.light;
+            light.position = animated.orbitCenter + neda::Vec3(std::cos(angle), 0.0f, std::sin(angle)) * animated.orbitRadius;
+            if (light.cosOuter > -1.0f) {
+                light.direction = neda::normalize(neda::Vec3(std::cos(angle) * 0.4f, -1.0f, std::sin(angle) * 0.4f));
+            }
+            mapped[i] = light;
+        }
+        
+        *clusterParamBuffersMapped[currentFrame] = neda::makeClusterParams(viewMatrix, projectionMatrix, CAMERA_NEAR_PLANE, CAMERA_FAR_PLANE, LIGHT_COUNT,
+                                                                           (float) renderExtent.width, (float) renderExtent.height);
+    }
+    
+    void rasterizeOccluders() {
+        if (!enableOcclusionCulling) return;
+        
+        occlusionBuffer.clear(viewProjection);
+        for (uint32_t index : occluderObjects) {
+            neda::Vec3 center(objectBounds.centerX[index], objectBounds.centerY[index], objectBounds.centerZ[index]);
+            neda::Vec3 extent(objectBounds.extentX[index], objectBounds.extentY[index], objectBounds.extentZ[index]);
+            occlusionBuffer.rasterizeBox(center, extent);
+        }
+    }
+    
+    // every batch culls into its own slice of the scratch buffer, then the slices get packed together in order
+    void frustumCull(const neda::Frustum& frustum) {
+        uint32_t objectCount = objectBounds.size();
+        uint32_t batchCount = (objectCount + CULLING_BATCH_SIZE - 1) / CULLING_BATCH_SIZE;
+        std::vector<uint32_t> batchVisible(batchCount);
+        visibleObjects.resize(objectCount);
+        
+        jobSystem.parallelFor(batchCount, 1, [&](uint32_t firstBatch, uint32_t lastBatch) {
+            for (uint32_t batch = firstBatch; batch < lastBatch; batch++) {
+                uint32_t begin = batch * CULLING_BATCH_SIZE;
+                uint32_t end = std::min(objectCount, begin + CULLING_BATCH_SIZE);
+                batchVisible[batch] = neda::cullBoxes(frustum, objectBounds, begin, end, &cullingScratch[begin]);
+            }
+        });
+        
+        uint32_t visibleCount = 0;
+        for (uint32_t batch = 0; batch < batchCount; batch++) {
+            std::copy_n(&cullingScratch[batch * CULLING_BATCH_SIZE], batchVisible[batch], &visibleObjects[visibleCount]);
+            visibleCount += batchVisible[batch];
+        }
+        visibleObjects.resize(visibleCount);
+    }
+    
+    // drops the frustum visible objects that are completely behind the rasterized occluders
+    void occlusionCull() {
+        if (!enableOcclusionCulling) return;
+        
+        std::vector<uint8_t> occluded(visibleObjects.size());
+        jobSystem.parallelFor(static_cast<uint32_t>(visibleObjects.size()), CULLING_BATCH_SIZE, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; i++) {
+                uint32_t index = visibleObjects[i];
+                if (sceneObjects[index].isOccluder) continue;
+                
+                neda::Vec3 center(objectBounds.centerX[index], objectBounds.centerY[index], objectBounds.centerZ[index]);
+                neda::Vec3 extent(objectBounds.extentX[index], objectBounds.extentY[index], objectBounds.extentZ[index]);
+                occluded[i] = occlusionBuffer.isBoxOccluded(center, extent) ? 1 : 0;
+            }
+        });
+        
+        uint32_t visibleCount = 0;
+        for (uint32_t i = 0; i < visibleObjects.size(); i++) {
+            visibleObjects[visibleCount] = visibleObjects[i];
+            visibleCount += occluded[i] ? 0 : 1;
+        }
+        visibleObjects.resize(visibleCount);
+    }
+    
+    void updateWindowTitle() {
+        framesSinceTitleUpdate++;
+        double now = glfwGetTime();
+        if (now - lastTitleUpdate < 1.0) return;
+        
+        std::stringstream title;
+        title << "NedaEngine - " << static_cast<int>(framesSinceTitleUpdate / (now - lastTitleUpdate)) << " fps - "
+              << (useGpuCulling ? std::string(useAsyncCompute ? "async gpu culling" : "gpu culling") : std::to_string(visibleObjects.size()) + "/" + std::to_string(sceneObjects.size()) + " objects visible") << " - "
+              << renderStats.drawCalls << " draws, " << renderStats.pipelineBinds << " pipeline binds, "
+              << renderStats.materialBinds << " material binds, " << renderStats.vertexBufferBinds << " vertex buffer binds - "
+              << hostAllocator.frameAllocations() << " driver host allocations, " << hostAllocator.frameArenaBytes() << " arena bytes - "
+              << shadowCascadesRendered << " shadow cascades rendered - render scale "
+              << static_cast<int>(dynamicResolution.scale() * 100.0f + 0.5f) << "%";
+        glfwSetWindowTitle(window, title.str().c_str());
+        
+        lastTitleUpdate = now;
+        framesSinceTitleUpdate = 0;
+        shadowCascadesRendered = 0;
+    }
+    
+    uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
+        VkPhysicalDeviceMemoryProperties memProperties;
+        vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+        for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+            if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+                return i;
+            }
+        }
+
+        throw std::runtime_error("failed to find suitable memory type!");
+    }
+    
+    void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory) {
+        commandRecorder.createBuffer(size, usage);
+        VkBufferCreateInfo bufferInfo{};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = size;
+        bufferInfo.usage = usage;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        if (vkCreateBuffer(device, &bufferInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_BUFFER), &buffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create buffer!");
+        }
+
+        VkMemoryRequirements memRequirements;
+        vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
+
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = memRequirements.size;
+        allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+
+        if (vkAllocateMemory(device, &allocInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_DEVICE_MEMORY), &bufferMemory) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate buffer memory!");
+        }
+
+        vkBindBufferMemory(device, buffer, bufferMemory, 0);
+    }
+    
+    VkCommandBuffer beginSingleTimeCommands() {
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandPool = uploadCommandPool;
+        allocInfo.commandBufferCount = 1;
+
+        VkCommandBuffer commandBuffer;
+        if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate command buffers!");
+        }
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+        return commandBuffer;
+    }
+
+    void endSingleTimeCommands(VkCommandBuffer commandBuffer) {
+        vkEndCommandBuffer(commandBuffer);
+
+        neda::QueueSubmission submission;
+        submission.addCommandBuffer(commandBuffer);
+        graphicsTimeline.wait(submission.submit(graphicsTimeline));
+
+        vkFreeCommandBuffers(device, uploadCommandPool, 1, &commandBuffer);
+    }
+    
+    // for data that never changes, it goes into device local memory through a staging buffer
+    void createDeviceLocalBuffer(const void* contents, VkDeviceSize bufferSize, VkBufferUsageFlags usage, VkBuffer& buffer, VkDeviceMemory& bufferMemory) {
+        VkBuffer stagingBuffer;
+        VkDeviceMemory stagingBufferMemory;
+        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+
+        void* data;
+        vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
+        memcpy(data, contents, (size_t) bufferSize);
+        vkUnmapMemory(device, stagingBufferMemory);
+
+        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, bufferMemory);
+
+        VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+        VkBufferCopy copyRegion{};
+        copyRegion.size = bufferSize;
+        vkCmdCopyBuffer(commandBuffer, stagingBuffer, buffer, 1, &copyRegion);
+        endSingleTimeCommands(commandBuffer);
+        commandRecorder.upload(bufferSize);
+
+        vkDestroyBuffer(device, stagingBuffer, hostAllocator.callbacks(VK_OBJECT_TYPE_BUFFER));
+        vkFreeMemory(device, stagingBufferMemory, hostAllocator.callbacks(VK_OBJECT_TYPE_DEVICE_MEMORY));
+    }
+    
+    void createVertexBuffer() {
+        createDeviceLocalBuffer(vertices.data(), sizeof(Vertex) * vertices.size(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vertexBuffer, vertexBufferMemory);
+        
+        // the characters' bind pose and instances never change either, the skinning is what moves them
+        createDeviceLocalBuffer(characterVertices.data(), sizeof(neda::SkinVertex) * characterVertices.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, bindPoseBuffer, bindPoseBufferMemory);
+        std::vector<InstanceData> characterInstances;
+        for (const Character& character : characters) {
+            characterInstances.push_back({neda::Vec3(), neda::Vec3(1.0f, 1.0f, 1.0f), character.color});
+        }
+        createDeviceLocalBuffer(characterInstances.data(), sizeof(InstanceData) * characterInstances.size(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, characterInstanceBuffer, characterInstanceBufferMemory);
+        
+        // the terrain's vertices are in world space already, its one instance only gives it its color
+        InstanceData terrainInstance = {neda::Vec3(), neda::Vec3(1.0f, 1.0f, 1.0f), neda::Vec3(0.45f, 0.55f, 0.3f)};
+        createDeviceLocalBuffer(&terrainInstance, sizeof(InstanceData), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, terrainInstanceBuffer, terrainInstanceBufferMemory);
+        createDeviceLocalBuffer(terrainMeshlets.meshlets.data(), sizeof(neda::Meshlet) * terrainMeshlets.meshlets.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, meshletBuffer, meshletBufferMemory);
+        createDeviceLocalBuffer(terrainMeshlets.vertices.data(), sizeof(uint32_t) * terrainMeshlets.vertices.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, meshletVertexBuffer, meshletVertexBufferMemory);
+        createDeviceLocalBuffer(terrainMeshlets.triangles.data(), terrainMeshlets.triangles.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, meshletTriangleBuffer, meshletTriangleBufferMemory);
+    }
+    
+    // rewritten every frame, so they stay mapped in host visible memory
+    void createInstanceBuffers() {
+        VkDeviceSize bufferSize = sizeof(InstanceData) * sceneObjects.size();
+        
+        instanceBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+        instanceBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+        instanceBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            createBuffer(bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, instanceBuffers[i], instanceBuffersMemory[i]);
+            
+            void* data;
+            vkMapMemory(device, instanceBuffersMemory[i], 0, bufferSize, 0, &data);
+            instanceBuffersMapped[i] = static_cast<InstanceData*>(data);
+        }
+    }
+    
+    void createIndirectBuffers() {
+        if (!multiDrawIndirectSupported) return;
+        
+        // there are never more batches than visible objects
+        VkDeviceSize bufferSize = sizeof(VkDrawIndirectCommand) * sceneObjects.size();
+        
+        indirectBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+        indirectBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+        indirectBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            createBuffer(bufferSize, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, indirectBuffers[i], indirectBuffersMemory[i]);
+            
+            void* data;
+            vkMapMemory(device, indirectBuffersMemory[i], 0, bufferSize, 0, &data);
+            indirectBuffersMapped[i] = static_cast<VkDrawIndirectCommand*>(data);
+        }
+        
+        VkDeviceSize characterBufferSize = sizeof(VkDrawIndirectCommand) * CHARACTER_COUNT * (1 + neda::MAX_SHADOW_CASCADES);
+        characterIndirectBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+        characterIndirectBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+        characterIndirectBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            createBuffer(characterBufferSize, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, characterIndirectBuffers[i], characterIndirectBuffersMemory[i]);
+            
+            void* data;
+            vkMapMemory(device, characterIndirectBuffersMemory[i], 0, characterBufferSize, 0, &data);
+            characterIndirectBuffersMapped[i] = static_cast<VkDrawIndirectCommand*>(data);
+        }
+    }
+    
+    // the compute queue's command pools, and the timestamp queries of both queues for the benchmark and dynamic resolution
+    void createComputeCommands() {
+        VkCommandPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.queueFamilyIndex = computeQueueFamily;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        
+        VkQueryPoolCreateInfo queryPoolInfo{};
+        queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        
+        computeFrames.resize(MAX_FRAMES_IN_FLIGHT);
+        graphicsTimestamps.resize(MAX_FRAMES_IN_FLIGHT);
+        frameHasTimestamps.resize(MAX_FRAMES_IN_FLIGHT, false);
+        frameTimeQueries.resize(MAX_FRAMES_IN_FLIGHT);
+        frameHasFrameTime.resize(MAX_FRAMES_IN_FLIGHT, false);
+        frameRenderScales.resize(MAX_FRAMES_IN_FLIGHT, 1.0f);
+        frameReplayFrames.resize(MAX_FRAMES_IN_FLIGHT, 0);
+        frameBenchmarkModes.resize(MAX_FRAMES_IN_FLIGHT, neda::OverlapBenchmark::ASYNC);
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            ComputeFrame& computeFrame = computeFrames[i];
+            if (vkCreateCommandPool(device, &poolInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_COMMAND_POOL), &computeFrame.pool) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create command pool!");
+            }
+            
+            VkCommandBufferAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.commandPool = computeFrame.pool;
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            allocInfo.commandBufferCount = 1;
+            if (vkAllocateCommandBuffers(device, &allocInfo, &computeFrame.commandBuffer) != VK_SUCCESS) {
+                throw std::runtime_error("failed to allocate command buffers!");
+            }
+            
+            queryPoolInfo.queryCount = 2;
+            if (vkCreateQueryPool(device, &queryPoolInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_QUERY_POOL), &computeFrame.timestamps) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create query pool!");
+            }
+            queryPoolInfo.queryCount = 4;
+            if (vkCreateQueryPool(device, &queryPoolInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_QUERY_POOL), &graphicsTimestamps[i]) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create query pool!");
+            }
+            queryPoolInfo.queryCount = 2;
+            if (vkCreateQueryPool(device, &queryPoolInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_QUERY_POOL), &frameTimeQueries[i]) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create query pool!");
+            }
+        }
+        
+        // the gpu rows go below the job system's threads in the trace
+        if (gpuProfilingSupported) {
+            graphicsProfiler.create(device, MAX_FRAMES_IN_FLIGHT, "graphics queue", jobSystem.threadCount(), hostAllocator.callbacks(VK_OBJECT_TYPE_QUERY_POOL));
+            if (asyncComputeSupported) {
+                computeProfiler.create(device, MAX_FRAMES_IN_FLIGHT, "compute queue", jobSystem.threadCount() + 1, hostAllocator.callbacks(VK_OBJECT_TYPE_QUERY_POOL));
+            }
+        }
+    }
+    
+    void createGpuCullingResources() {
+        if (!gpuCullingSupported) return;
+        
+        // bucket the whole scene once, the same way the render queue batches the visible objects
+        neda::RenderQueue bucketQueue;
+        bucketQueue.reset(sceneObjects.size());
+        for (uint32_t i = 0; i < sceneObjects.size(); i++) {
+            const SceneObject& object = sceneObjects[i];
+            bucketQueue.set(i, neda::SortKey::make(RENDER_PASS_OPAQUE, materials[object.material].pipeline, object.material, object.mesh, 0), i);
+        }
+        bucketQueue.sort();
+        bucketQueue.buildBatches();
+        gpuCullBuckets = bucketQueue.batches();
+        
+        std::vector<GpuCullObject> cullObjects(sceneObjects.size());
+        std::vector<VkDrawIndirectCommand> drawTemplates(gpuCullBuckets.size());
+        for (uint32_t bucket = 0; bucket < gpuCullBuckets.size(); bucket++) {
+            const neda::DrawBatch& batch = gpuCullBuckets[bucket];
+            const Mesh& mesh = meshes[batch.mesh];
+            drawTemplates[bucket] = {mesh.vertexCount, 0, mesh.firstVertex, batch.firstItem};
+            
+            for (uint32_t item = batch.firstItem; item < batch.firstItem + batch.itemCount; item++) {
+                uint32_t index = bucketQueue.items()[item].object;
+                const SceneObject& object = sceneObjects[index];
+                GpuCullObject& cullObject = cullObjects[index];
+                cullObject.center = {objectBounds.centerX[index], objectBounds.centerY[index], objectBounds.centerZ[index]};
+                cullObject.extent = {objectBounds.extentX[index], objectBounds.extentY[index], objectBounds.extentZ[index]};
+                cullObject.bucket = bucket;
+                cullObject.firstInstance = batch.firstItem;
+                cullObject.position = object.position;
+                cullObject.scale = object.scale;
+                cullObject.color = object.color;
+            }
+        }
+        
+        createDeviceLocalBuffer(cullObjects.data(), sizeof(GpuCullObject) * cullObjects.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, gpuCullObjectBuffer, gpuCullObjectBufferMemory);
+        createDeviceLocalBuffer(drawTemplates.data(), sizeof(VkDrawIndirectCommand) * drawTemplates.size(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, gpuCullDrawTemplateBuffer, gpuCullDrawTemplateBufferMemory);
+        
+        gpuCullInstanceBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+        gpuCullInstanceBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+        gpuCullDrawBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+        gpuCullDrawBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            createBuffer(sizeof(InstanceData) * sceneObjects.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, gpuCullInstanceBuffers[i], gpuCullInstanceBuffersMemory[i]);
+            createBuffer(sizeof(VkDrawIndirectCommand) * drawTemplates.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, gpuCullDrawBuffers[i], gpuCullDrawBuffersMemory[i]);
+        }
+        
+        createCullDescriptorSets();
+        createCullPipeline();
+    }
+    
+    void createCullDescriptorSets() {
+        VkDescriptorSetLayoutBinding bindings[3]{};
+        for (uint32_t i = 0; i < 3; i++) {
+            bindings[i].binding = i;
+            bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            bindings[i].descriptorCount = 1;
+            bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        }
+        
+        VkDescriptorSetLayoutCreateInfo layoutInfo{};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.bindingCount = 3;
+        layoutInfo.pBindings = bindings;
+        if (vkCreateDescriptorSetLayout(device, &layoutInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT), &cullDescriptorSetLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create descriptor set layout!");
+        }
+        
+        VkDescriptorPoolSize poolSize{};
+        poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        poolSize.descriptorCount = 3 * MAX_FRAMES_IN_FLIGHT;
+        
+        VkDescriptorPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.poolSizeCount = 1;
+        poolInfo.pPoolSizes = &poolSize;
+        poolInfo.maxSets = MAX_FRAMES_IN_FLIGHT;
+        if (vkCreateDescriptorPool(device, &poolInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_DESCRIPTOR_POOL), &cullDescriptorPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create descriptor pool!");
+        }
+        
+        std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, cullDescriptorSetLayout);
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = cullDescriptorPool;
+        allocInfo.descriptorSetCount = MAX_FRAMES_IN_FLIGHT;
+        allocInfo.pSetLayouts = layouts.data();
+        cullDescriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
+        if (vkAllocateDescriptorSets(device, &allocInfo, cullDescriptorSets.data()) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate descriptor sets!");
+        }
+        
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            VkDescriptorBufferInfo bufferInfos[3] = {
+                {gpuCullObjectBuffer, 0, VK_WHOLE_SIZE},
+                {gpuCullInstanceBuffers[i], 0, VK_WHOLE_SIZE},
+                {gpuCullDrawBuffers[i], 0, VK_WHOLE_SIZE},
+            };
+            VkWriteDescriptorSet writes[3]{};
+            for (uint32_t binding = 0; binding < 3; binding++) {
+                writes[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                writes[binding].dstSet = cullDescriptorSets[i];
+                writes[binding].dstBinding = binding;
+                writes[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                writes[binding].descriptorCount = 1;
+                writes[binding].pBufferInfo = &bufferInfos[binding];
+            }
+            vkUpdateDescriptorSets(device, 3, writes, 0, nullptr);
+        }
+    }
+    
+    void createCullPipeline() {
+        auto computeShaderCode = readFile("cull.spv");
+        VkShaderModule computeShaderModule = createShaderModule(computeShaderCode);
+        
+        VkPushConstantRange pushConstantRange{};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = sizeof(CullPushConstants);
+        
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &cullDescriptorSetLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+        if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_PIPELINE_LAYOUT), &cullPipelineLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create pipeline layout!");
+        }
+        
+        VkComputePipelineCreateInfo pipelineInfo{};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        pipelineInfo.stage.module = computeShaderModule;
+        pipelineInfo.stage.pName = "main";
+        pipelineInfo.layout = cullPipelineLayout;
+        if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_PIPELINE), &cullPipeline) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create compute pipeline!");
+        }
+        
+        vkDestroyShaderModule(device, computeShaderModule, hostAllocator.callbacks(VK_OBJECT_TYPE_SHADER_MODULE));
+    }
+    
+    // the lights and cluster parameters read by both the binning pass and the fragment shader, and the clusters in between
+    void createLightingDescriptorSetLayout() {
+        VkDescriptorSetLayoutBinding bindings[5]{};
+        for (uint32_t i = 0; i < 3; i++) {
+            bindings[i].binding = i;
+            bindings[i].descriptorType = i == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            bindings[i].descriptorCount = 1;
+            bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+        }
+        // the shadow parameters and the cascades, only the shading reads them
+        bindings[3].binding = 3;
+        bindings[3].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        bindings[3].descriptorCount = 1;
+        bindings[3].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+        bindings[4].binding = 4;
+        bindings[4].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        bindings[4].descriptorCount = 1;
+        bindings[4].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+        
+        VkDescriptorSetLayoutCreateInfo layoutInfo{};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.bindingCount = 5;
+        layoutInfo.pBindings = bindings;
+        if (vkCreateDescriptorSetLayout(device, &layoutInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT), &lightingDescriptorSetLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create descriptor set layout!");
+        }
+    }
+    
+    void createLightingResources() {
+        VkDeviceSize clusterBufferSize = sizeof(uint32_t) * neda::ClusterGrid::COUNT * (1 + neda::ClusterGrid::MAX_LIGHTS_PER_CLUSTER);
+        
+        lightBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+        lightBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+        lightBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+        clusterParamBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+        clusterParamBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+        clusterParamBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+        clusterBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+        clusterBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            createBuffer(sizeof(neda::GpuLight) * LIGHT_COUNT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, lightBuffers[i], lightBuffersMemory[i]);
+            createBuffer(sizeof(neda::ClusterParams), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, clusterParamBuffers[i], clusterParamBuffersMemory[i]);
+            createBuffer(clusterBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, clusterBuffers[i], clusterBuffersMemory[i]);
+            
+            void* data;
+            vkMapMemory(device, lightBuffersMemory[i], 0, sizeof(neda::GpuLight) * LIGHT_COUNT, 0, &data);
+            lightBuffersMapped[i] = static_cast<neda::GpuLight*>(data);
+            vkMapMemory(device, clusterParamBuffersMemory[i], 0, sizeof(neda::ClusterParams), 0, &data);
+            clusterParamBuffersMapped[i] = static_cast<neda::ClusterParams*>(data);
+        }
+        
+        VkDescriptorPoolSize poolSizes[3]{};
+        poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        poolSizes[0].descriptorCount = 2 * MAX_FRAMES_IN_FLIGHT;
+        poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        poolSizes[1].descriptorCount = 2 * MAX_FRAMES_IN_FLIGHT;
+        poolSizes[2].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        poolSizes[2].descriptorCount = MAX_FRAMES_IN_FLIGHT;
+        
+        VkDescriptorPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.poolSizeCount = 3;
+        poolInfo.pPoolSizes = poolSizes;
+        poolInfo.maxSets = MAX_FRAMES_IN_FLIGHT;
+        if (vkCreateDescriptorPool(device, &poolInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_DESCRIPTOR_POOL), &lightingDescriptorPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create descriptor pool!");
+        }
+        
+        std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, lightingDescriptorSetLayout);
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = lightingDescriptorPool;
+        allocInfo.descriptorSetCount = MAX_FRAMES_IN_FLIGHT;
+        allocInfo.pSetLayouts = layouts.data();
+        lightingDescriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
+        if (vkAllocateDescriptorSets(device, &allocInfo, lightingDescriptorSets.data()) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate descriptor sets!");
+        }
+        
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            VkDescriptorBufferInfo bufferInfos[4] = {
+                {clusterParamBuffers[i], 0, VK_WHOLE_SIZE},
+                {lightBuffers[i], 0, VK_WHOLE_SIZE},
+                {clusterBuffers[i], 0, VK_WHOLE_SIZE},
+                {shadowParamBuffers[i], 0, VK_WHOLE_SIZE},
+            };
+            VkDescriptorImageInfo shadowMapInfo{shadowSampler, shadowArrayView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+            VkWriteDescriptorSet writes[5]{};
+            for (uint32_t binding = 0; binding < 5; binding++) {
+                writes[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                writes[binding].dstSet = lightingDescriptorSets[i];
+                writes[binding].dstBinding = binding;
+                writes[binding].descriptorCount = 1;
+                if (binding == 4) {
+                    writes[binding].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+                    writes[binding].pImageInfo = &shadowMapInfo;
+                } else {
+                    writes[binding].descriptorType = binding == 0 || binding == 3 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                    writes[binding].pBufferInfo = &bufferInfos[binding];
+                }
+            }
+            vkUpdateDescriptorSets(device, 5, writes, 0, nullptr);
+        }
+        
+        auto computeShaderCode = readFile("cluster.spv");
+        VkShaderModule computeShaderModule = createShaderModule(computeShaderCode);
+        
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &lightingDescriptorSetLayout;
+        if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_PIPELINE_LAYOUT), &lightBinningPipelineLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create pipeline layout!");
+        }
+        
+        VkComputePipelineCreateInfo pipelineInfo{};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        pipelineInfo.stage.module = computeShaderModule;
+        pipelineInfo.stage.pName = "main";
+        pipelineInfo.layout = lightBinningPipelineLayout;
+        if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_PIPELINE), &lightBinningPipeline) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create compute pipeline!");
+        }
+        
+        vkDestroyShaderModule(device, computeShaderModule, hostAllocator.callbacks(VK_OBJECT_TYPE_SHADER_MODULE));
+    }
+    
+    // in the frame's graphics buffer in front of the render pass. the last frame that used this slot's cluster buffer is done,
+    // so only the fragment reads after it need a barrier
+    void recordLightBinning(VkCommandBuffer commandBuffer) {
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, lightBinningPipeline);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, lightBinningPipelineLayout, 0, 1, &lightingDescriptorSets[currentFrame], 0, nullptr);
+        uint32_t groupCount = (neda::ClusterGrid::COUNT + neda::ClusterGrid::BINNING_GROUP_SIZE - 1) / neda::ClusterGrid::BINNING_GROUP_SIZE;
+        vkCmdDispatch(commandBuffer, groupCount, 1, 1);
+        commandRecorder.dispatch(neda::CAPTURE_PASS_LIGHT_BINNING, groupCount, 1, 1);
+        
+        VkBufferMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.buffer = clusterBuffers[currentFrame];
+        barrier.offset = 0;
+        barrier.size = VK_WHOLE_SIZE;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+    }
+    
+    void createShadowResources() {
+        neda::ShadowSettings settings;
+        settings.caching = enableShadowCaching;
+        shadows.configure(settings);
+        
+        createImage(settings.resolution, settings.resolution, shadowFormat, VK_IMAGE_TILING_OPTIMAL,
+                    VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                    shadowImage, shadowImageMemory, settings.cascadeCount);
+        createImage(settings.resolution, settings.resolution, shadowFormat, VK_IMAGE_TILING_OPTIMAL,
+                    VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                    shadowStaticImage, shadowStaticImageMemory, settings.cascadeCount);
+        shadowArrayView = createImageView(shadowImage, shadowFormat, VK_IMAGE_ASPECT_DEPTH_BIT, VK_IMAGE_VIEW_TYPE_2D_ARRAY, 0, settings.cascadeCount);
+        
+        shadowLayerViews.resize(settings.cascadeCount);
+        shadowFramebuffers.resize(settings.cascadeCount);
+        shadowStaticLayerViews.resize(settings.cascadeCount);
+        shadowStaticFramebuffers.resize(settings.cascadeCount);
+        for (uint32_t i = 0; i < settings.cascadeCount; i++) {
+            shadowLayerViews[i] = createImageView(shadowImage, shadowFormat, VK_IMAGE_ASPECT_DEPTH_BIT, VK_IMAGE_VIEW_TYPE_2D, i, 1);
+            shadowStaticLayerViews[i] = createImageView(shadowStaticImage, shadowFormat, VK_IMAGE_ASPECT_DEPTH_BIT, VK_IMAGE_VIEW_TYPE_2D, i, 1);
+            
+            VkFramebufferCreateInfo framebufferInfo{};
+            framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+            framebufferInfo.renderPass = shadowRenderPass;
+            framebufferInfo.attachmentCount = 1;
+            framebufferInfo.pAttachments = &shadowLayerViews[i];
+            framebufferInfo.width = settings.resolution;
+            framebufferInfo.height = settings.resolution;
+            framebufferInfo.layers = 1;
+            if (vkCreateFramebuffer(device, &framebufferInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_FRAMEBUFFER), &shadowFramebuffers[i]) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create shadow framebuffer!");
+            }
+            framebufferInfo.renderPass = shadowStaticRenderPass;
+            framebufferInfo.pAttachments = &shadowStaticLayerViews[i];
+            if (vkCreateFramebuffer(device, &framebufferInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_FRAMEBUFFER), &shadowStaticFramebuffers[i]) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create shadow framebuffer!");
+            }
+        }
+        
+        // compares against the stored depth, 1 means lit. outside the map everything is lit
+        VkSamplerCreateInfo samplerInfo{};
+        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        samplerInfo.magFilter = VK_FILTER_LINEAR;
+        samplerInfo.minFilter = VK_FILTER_LINEAR;
+        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+        samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+        samplerInfo.compareEnable = VK_TRUE;
+        samplerInfo.compareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+        samplerInfo.maxLod = 0.0f;
+        if (vkCreateSampler(device, &samplerInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_SAMPLER), &shadowSampler) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create shadow sampler!");
+        }
+        
+        VkDeviceSize instanceBufferSize = sizeof(InstanceData) * sceneObjects.size() * settings.cascadeCount;
+        shadowParamBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+        shadowParamBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+        shadowParamBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+        shadowInstanceBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+        shadowInstanceBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+        shadowInstanceBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            createBuffer(sizeof(neda::ShadowParams), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, shadowParamBuffers[i], shadowParamBuffersMemory[i]);
+            createBuffer(instanceBufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, shadowInstanceBuffers[i], shadowInstanceBuffersMemory[i]);
+            
+            void* data;
+            vkMapMemory(device, shadowParamBuffersMemory[i], 0, sizeof(neda::ShadowParams), 0, &data);
+            shadowParamBuffersMapped[i] = static_cast<neda::ShadowParams*>(data);
+            vkMapMemory(device, shadowInstanceBuffersMemory[i], 0, instanceBufferSize, 0, &data);
+            shadowInstanceBuffersMapped[i] = static_cast<InstanceData*>(data);
+        }
+    }
+    
+    // fits the cascades to this frame's camera, and for every cascade that has to be rendered again culls the casters
+    // against it and writes their instances grouped by mesh. runs in the frame graph, only once the frame is going to be drawn
+    // since the cascades count as rendered from here on
+    void updateShadows() {
+        float aspect = swapChainExtent.width / (float) swapChainExtent.height;
+        shadowStaticMask = shadows.update(cameraPosition, cameraForward, CAMERA_FOV_Y, aspect, CAMERA_NEAR_PLANE, sunDirection, staticSceneVersion);
+        *shadowParamBuffersMapped[currentFrame] = shadows.params(sunColor);
+        
+        // animated casters can't be cached. every cascade a character is in gets the cached static casters copied in and
+        // the characters drawn on top every frame, and once more after they left to clear their shadows out
+        uint32_t characterMask = 0;
+        for (uint32_t cascade = 0; cascade < shadows.settings().cascadeCount; cascade++) {
+            std::vector<uint32_t>& casters = shadowCharacters[cascade];
+            casters.clear();
+            if (!useSkinning) continue;
+            
+            casters.resize(CHARACTER_COUNT);
+            neda::Frustum frustum = neda::Frustum::fromViewProjection(shadows.cascade(cascade).viewProjection);
+            casters.resize(neda::cullSpheres(frustum, characterBounds, 0, CHARACTER_COUNT, casters.data()));
+            if (!casters.empty()) {
+                characterMask |= 1u << cascade;
+            }
+        }
+        shadowRenderMask = shadowStaticMask | characterMask | shadowCharacterMask;
+        shadowCharacterMask = characterMask;
+        
+        shadowDraws.clear();
+        uint32_t objectCount = objectBounds.size();
+        std::vector<uint32_t> casters(objectCount);
+        std::vector<uint32_t> meshCursors(meshes.size());
+        InstanceData* mapped = shadowInstanceBuffersMapped[currentFrame];
+        for (uint32_t cascade = 0; cascade < shadows.settings().cascadeCount; cascade++) {
+            if ((shadowStaticMask & (1u << cascade)) == 0) continue;
+            shadowCascadesRendered++;
+            
+            neda::Frustum frustum = neda::Frustum::fromViewProjection(shadows.cascade(cascade).viewProjection);
+            uint32_t casterCount = neda::cullBoxes(frustum, objectBounds, 0, objectCount, casters.data());
+            
+            // counting sort by mesh, so every mesh is one instanced draw
+            std::fill(meshCursors.begin(), meshCursors.end(), 0);
+            for (uint32_t i = 0; i < casterCount; i++) {
+                meshCursors[sceneObjects[casters[i]].mesh]++;
+            }
+            uint32_t firstInstance = cascade * objectCount;
+            for (uint32_t mesh = 0; mesh < meshes.size(); mesh++) {
+                uint32_t instanceCount = meshCursors[mesh];
+                if (instanceCount > 0) {
+                    shadowDraws.push_back({cascade, mesh, firstInstance, instanceCount});
+                }
+                meshCursors[mesh] = firstInstance;
+                firstInstance += instanceCount;
+            }
+            for (uint32_t i = 0; i < casterCount; i++) {
+                const SceneObject& object = sceneObjects[casters[i]];
+                mapped[meshCursors[object.mesh]++] = {object.position, object.scale, object.color};
+            }
+        }
+    }
+    
+    // in the frame's graphics buffer in front of the scene pass. a cascade's static casters are only rendered when they
+    // changed, every cascade that changed or has characters gets them copied into the map and the characters drawn on top
+    void recordShadowCascades(VkCommandBuffer commandBuffer) {
+        uint32_t resolution = shadows.settings().resolution;
+        VkViewport viewport{0.0f, 0.0f, (float) resolution, (float) resolution, 0.0f, 1.0f};
+        VkRect2D scissor{{0, 0}, {resolution, resolution}};
+        VkClearValue clearValue{};
+        clearValue.depthStencil = {1.0f, 0};
+        VkBuffer vertexBuffers[] = {vertexBuffer, shadowInstanceBuffers[currentFrame]};
+        VkBuffer characterBuffers[] = {skinnedVertexBuffers[currentFrame], characterInstanceBuffer};
+        VkDeviceSize offsets[] = {0, 0};
+        
+        VkRenderPassBeginInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassInfo.renderArea = scissor;
+        renderPassInfo.clearValueCount = 1;
+        renderPassInfo.pClearValues = &clearValue;
+        
+        size_t draw = 0;
+        for (uint32_t cascade = 0; cascade < shadows.settings().cascadeCount; cascade++) {
+            if ((shadowRenderMask & (1u << cascade)) == 0) continue;
+            // the material tint only colors the output, which a depth pass doesn't have
+            const neda::Mat4& cascadeViewProjection = shadows.cascade(cascade).viewProjection;
+            
+            if (shadowStaticMask & (1u << cascade)) {
+                renderPassInfo.renderPass = shadowStaticRenderPass;
+                renderPassInfo.framebuffer = shadowStaticFramebuffers[cascade];
+                vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, shadowPipeline);
+                vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+                vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+                vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, offsets);
+                vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(neda::Mat4), &cascadeViewProjection);
+                for (; draw < shadowDraws.size() && shadowDraws[draw].cascade == cascade; draw++) {
+                    const Mesh& mesh = meshes[shadowDraws[draw].mesh];
+                    vkCmdDraw(commandBuffer, mesh.vertexCount, shadowDraws[draw].instanceCount, mesh.firstVertex, shadowDraws[draw].firstInstance);
+                }
+                vkCmdEndRenderPass(commandBuffer);
+            }
+            
+            // the map's layer is overwritten whole, the frame before may still be sampling it
+            VkImageMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = shadowImage;
+            barrier.subresourceRange = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, cascade, 1};
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+            
+            VkImageCopy copyRegion{};
+            copyRegion.srcSubresource = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, cascade, 1};
+            copyRegion.dstSubresource = {VK_IMAGE_ASPECT_DEPTH_BIT, 0, cascade, 1};
+            copyRegion.extent = {resolution, resolution, 1};
+            vkCmdCopyImage(commandBuffer, shadowStaticImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, shadowImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+            
+            // the characters from the same skinned vertices the scene pass draws. the pass also leaves the layer ready
+            // to sample when there are none
+            renderPassInfo.renderPass = shadowRenderPass;
+            renderPassInfo.framebuffer = shadowFramebuffers[cascade];
+            vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+            if (!shadowCharacters[cascade].empty()) {
+                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, shadowPipeline);
+                vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+                vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+                vkCmdBindVertexBuffers(commandBuffer, 0, 2, characterBuffers, offsets);
+                vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(neda::Mat4), &cascadeViewProjection);
+                recordCharacterDraws(commandBuffer, shadowCharacters[cascade].data(), static_cast<uint32_t>(shadowCharacters[cascade].size()), 1 + cascade);
+            }
+            vkCmdEndRenderPass(commandBuffer);
+        }
+    }
+    
+    // the buffers the compute work writes this frame and the graphics queue reads
+    neda::BufferHandoff computeHandoff() {
+        neda::BufferHandoff handoff(useAsyncCompute ? computeQueueFamily : graphicsQueueFamily, graphicsQueueFamily);
+        handoff.add(gpuCullInstanceBuffers[currentFrame]);
+        handoff.add(gpuCullDrawBuffers[currentFrame]);
+        return handoff;
+    }
+    
+    // works on both queues, it goes into the compute queue's buffer with async compute and the frame's graphics buffer without
+    void recordGpuCulling(VkCommandBuffer commandBuffer, const neda::Frustum& frustum) {
+        VkBufferCopy copyRegion{};
+        copyRegion.size = sizeof(VkDrawIndirectCommand) * gpuCullBuckets.size();
+        vkCmdCopyBuffer(commandBuffer, gpuCullDrawTemplateBuffer, gpuCullDrawBuffers[currentFrame], 1, &copyRegion);
+        
+        VkBufferMemoryBarrier resetBarrier{};
+        resetBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        resetBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        resetBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        resetBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        resetBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        resetBarrier.buffer = gpuCullDrawBuffers[currentFrame];
+        resetBarrier.offset = 0;
+        resetBarrier.size = VK_WHOLE_SIZE;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &resetBarrier, 0, nullptr);
+        
+        CullPushConstants pushConstants{};
+        memcpy(pushConstants.planes, frustum.planes, sizeof(pushConstants.planes));
+        pushConstants.objectCount = static_cast<uint32_t>(sceneObjects.size());
+        
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 0, 1, &cullDescriptorSets[currentFrame], 0, nullptr);
+        vkCmdPushConstants(commandBuffer, cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullPushConstants), &pushConstants);
+        vkCmdDispatch(commandBuffer, (pushConstants.objectCount + 63) / 64, 1, 1);
+        commandRecorder.dispatch(neda::CAPTURE_PASS_GPU_CULLING, (pushConstants.objectCount + 63) / 64, 1, 1);
+        
+        computeHandoff().release(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                                 VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                                 VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+    }
+    
+    // the particle pool with its dead and alive lists, the per frame draw buffers, the compute passes and the draw pipeline
+    void createParticleResources() {
+        const uint32_t capacity = neda::ParticleConfig::CAPACITY;
+        createBuffer(sizeof(neda::GpuParticle) * capacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, particleBuffer, particleBufferMemory);
+        createBuffer(sizeof(uint32_t) * capacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, particleDeadListBuffer, particleDeadListBufferMemory);
+        createBuffer(sizeof(uint32_t) * capacity * 2, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, particleAliveListBuffer, particleAliveListBufferMemory);
+        createBuffer(sizeof(neda::ParticleCounters), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, particleCounterBuffer, particleCounterBufferMemory);
+        
+        particleDrawBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+        particleDrawBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            createBuffer(neda::PARTICLE_DRAW_HEADER_SIZE + sizeof(neda::ParticleInstance) * capacity,
+                         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, particleDrawBuffers[i], particleDrawBuffersMemory[i]);
+        }
+        
+        VkDescriptorSetLayoutBinding bindings[5]{};
+        for (uint32_t i = 0; i < 5; i++) {
+            bindings[i].binding = i;
+            bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            bindings[i].descriptorCount = 1;
+            bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        }
+        VkDescriptorSetLayoutCreateInfo layoutInfo{};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.bindingCount = 5;
+        layoutInfo.pBindings = bindings;
+        if (vkCreateDescriptorSetLayout(device, &layoutInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT), &particleDescriptorSetLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create descriptor set layout!");
+        }
+        
+        VkDescriptorPoolSize poolSize{};
+        poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        poolSize.descriptorCount = 5 * MAX_FRAMES_IN_FLIGHT;
+        VkDescriptorPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.poolSizeCount = 1;
+        poolInfo.pPoolSizes = &poolSize;
+        poolInfo.maxSets = MAX_FRAMES_IN_FLIGHT;
+        if (vkCreateDescriptorPool(device, &poolInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_DESCRIPTOR_POOL), &particleDescriptorPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create descriptor pool!");
+        }
+        
+        std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, particleDescriptorSetLayout);
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = particleDescriptorPool;
+        allocInfo.descriptorSetCount = MAX_FRAMES_IN_FLIGHT;
+        allocInfo.pSetLayouts = layouts.data();
+        particleDescriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
+        if (vkAllocateDescriptorSets(device, &allocInfo, particleDescriptorSets.data()) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate descriptor sets!");
+        }
+        
+        // the state is shared, only the draw buffer is the frame's own
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            VkDescriptorBufferInfo bufferInfos[5] = {
+                {particleBuffer, 0, VK_WHOLE_SIZE},
+                {particleDeadListBuffer, 0, VK_WHOLE_SIZE},
+                {particleAliveListBuffer, 0, VK_WHOLE_SIZE},
+                {particleCounterBuffer, 0, VK_WHOLE_SIZE},
+                {particleDrawBuffers[i], 0, VK_WHOLE_SIZE},
+            };
+            VkWriteDescriptorSet writes[5]{};
+            for (uint32_t binding = 0; binding < 5; binding++) {
+                writes[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                writes[binding].dstSet = particleDescriptorSets[i];
+                writes[binding].dstBinding = binding;
+                writes[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                writes[binding].descriptorCount = 1;
+                writes[binding].pBufferInfo = &bufferInfos[binding];
+            }
+            vkUpdateDescriptorSets(device, 5, writes, 0, nullptr);
+        }
+        
+        createParticleComputePipelines();
+        createParticleRenderPipeline();
+    }
+    
+    // one pipeline per pass, all from the same shader
+    void createParticleComputePipelines() {
+        VkPushConstantRange pushConstantRange{};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = sizeof(neda::ParticlePushConstants);
+        
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &particleDescriptorSetLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+        if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_PIPELINE_LAYOUT), &particleComputePipelineLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create pipeline layout!");
+        }
+        
+        auto computeShaderCode = readFile("particles.spv");
+        VkShaderModule computeShaderModule = createShaderModule(computeShaderCode);
+        
+        uint32_t passes[neda::PARTICLE_PASS_COUNT];
+        VkSpecializationMapEntry specializationEntry{0, 0, sizeof(uint32_t)};
+        VkSpecializationInfo specializationInfos[neda::PARTICLE_PASS_COUNT]{};
+        VkComputePipelineCreateInfo pipelineInfos[neda::PARTICLE_PASS_COUNT]{};
+        for (uint32_t pass = 0; pass < neda::PARTICLE_PASS_COUNT; pass++) {
+            passes[pass] = pass;
+            specializationInfos[pass].mapEntryCount = 1;
+            specializationInfos[pass].pMapEntries = &specializationEntry;
+            specializationInfos[pass].dataSize = sizeof(uint32_t);
+            specializationInfos[pass].pData = &passes[pass];
+            
+            pipelineInfos[pass].sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+            pipelineInfos[pass].stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+            pipelineInfos[pass].stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+            pipelineInfos[pass].stage.module = computeShaderModule;
+            pipelineInfos[pass].stage.pName = "main";
+            pipelineInfos[pass].stage.pSpecializationInfo = &specializationInfos[pass];
+            pipelineInfos[pass].layout = particleComputePipelineLayout;
+        }
+        if (vkCreateComputePipelines(device, VK_NULL_HANDLE, neda::PARTICLE_PASS_COUNT, pipelineInfos, hostAllocator.callbacks(VK_OBJECT_TYPE_PIPELINE), particleComputePipelines) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create compute pipeline!");
+        }
+        
+        vkDestroyShaderModule(device, computeShaderModule, hostAllocator.callbacks(VK_OBJECT_TYPE_SHADER_MODULE));
+    }
+    
+    // camera facing quads straight from the draw buffer, blended additively and depth tested without writing depth
+    void createParticleRenderPipeline() {
+        auto vertShaderCode = readFile("particlesVert.spv");
+        auto fragShaderCode = readFile("particlesFrag.spv");
+        VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
+        VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
+        
+        VkPipelineShaderStageCreateInfo shaderStages[2]{};
+        shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+        shaderStages[0].module = vertShaderModule;
+        shaderStages[0].pName = "main";
+        shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+        shaderStages[1].module = fragShaderModule;
+        shaderStages[1].pName = "main";
+        
+        VkVertexInputBindingDescription bindingDescription{0, sizeof(neda::ParticleInstance), VK_VERTEX_INPUT_RATE_INSTANCE};
+        VkVertexInputAttributeDescription attributeDescriptions[] = {
+            {0, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(neda::ParticleInstance, position)},
+            {1, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(neda::ParticleInstance, color)},
+        };
+        VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+        vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+        vertexInputInfo.vertexBindingDescriptionCount = 1;
+        vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+        vertexInputInfo.vertexAttributeDescriptionCount = 2;
+        vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions;
+        
+        VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+        inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+        inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+        
+        VkPipelineViewportStateCreateInfo viewportState{};
+        viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+        viewportState.viewportCount = 1;
+        viewportState.scissorCount = 1;
+        
+        VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+        VkPipelineDynamicStateCreateInfo dynamicState{};
+        dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+        dynamicState.dynamicStateCount = 2;
+        dynamicState.pDynamicStates = dynamicStates;
+        
+        VkPipelineRasterizationStateCreateInfo rasterizer{};
+        rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+        rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+        rasterizer.lineWidth = 1.0f;
+        rasterizer.cullMode = VK_CULL_MODE_NONE;
+        rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+        
+        VkPipelineMultisampleStateCreateInfo multisampling{};
+        multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+        multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+        
+        VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+        colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+        colorBlendAttachment.blendEnable = VK_TRUE;
+        colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+        colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+        colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+        colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+        colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+        colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+        
+        VkPipelineColorBlendStateCreateInfo colorBlending{};
+        colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+        colorBlending.attachmentCount = 1;
+        colorBlending.pAttachments = &colorBlendAttachment;
+        
+        VkPipelineDepthStencilStateCreateInfo depthStencil{};
+        depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+        depthStencil.depthTestEnable = VK_TRUE;
+        depthStencil.depthWriteEnable = VK_FALSE;
+        depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+        
+        // the view projection, then the camera's right and up vectors
+        VkPushConstantRange pushConstantRange{};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = sizeof(neda::Mat4) + 2 * sizeof(neda::Vec4);
+        
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+        if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_PIPELINE_LAYOUT), &particleRenderPipelineLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create pipeline layout!");
+        }
+        
+        VkGraphicsPipelineCreateInfo pipelineInfo{};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+        pipelineInfo.stageCount = 2;
+        pipelineInfo.pStages = shaderStages;
+        pipelineInfo.pVertexInputState = &vertexInputInfo;
+        pipelineInfo.pInputAssemblyState = &inputAssembly;
+        pipelineInfo.pViewportState = &viewportState;
+        pipelineInfo.pRasterizationState = &rasterizer;
+        pipelineInfo.pMultisampleState = &multisampling;
+        pipelineInfo.pDepthStencilState = &depthStencil;
+        pipelineInfo.pColorBlendState = &colorBlending;
+        pipelineInfo.pDynamicState = &dynamicState;
+        pipelineInfo.layout = particleRenderPipelineLayout;
+        pipelineInfo.renderPass = renderPass;
+        pipelineInfo.subpass = 0;
+        if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_PIPELINE), &particleRenderPipeline) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create particle pipeline!");
+        }
+        
+        vkDestroyShaderModule(device, fragShaderModule, hostAllocator.callbacks(VK_OBJECT_TYPE_SHADER_MODULE));
+        vkDestroyShaderModule(device, vertShaderModule, hostAllocator.callbacks(VK_OBJECT_TYPE_SHADER_MODULE));
+    }
+    
+    neda::BufferHandoff particleHandoff() {
+        neda::BufferHandoff handoff(asyncComputeSupported ? computeQueueFamily : graphicsQueueFamily, graphicsQueueFamily);
+        handoff.add(particleDrawBuffers[currentFrame]);
+        return handoff;
+    }
+    
+    // begin, emit and simulate, each pass waits for the one before. the emission and simulation sizes are only
+    // known on the gpu, so those two dispatch indirectly with what the begin pass wrote
+    void recordParticleSimulation(VkCommandBuffer commandBuffer) {
+        double now = frameTime;
+        float deltaTime = lastParticleUpdate == 0.0 ? 1.0f / 60.0f : static_cast<float>(std::min(now - lastParticleUpdate, 0.1));
+        lastParticleUpdate = now;
+        
+        neda::ParticlePushConstants pushConstants{};
+        const float fountains[neda::ParticleConfig::EMITTER_COUNT][4] = {
+            {40.0f, 0.0f, 0.0f, 1.5f}, {-40.0f, 0.0f, 0.0f, 1.5f}, {0.0f, 0.0f, 40.0f, 1.5f}, {0.0f, 0.0f, -40.0f, 1.5f},
+        };
+        memcpy(pushConstants.emitters, fountains, sizeof(fountains));
+        pushConstants.deltaTime = deltaTime;
+        pushConstants.time = static_cast<float>(now);
+        pushConstants.emitRequest = particleEmission.take(deltaTime);
+        pushConstants.current = particleAliveList;
+        commandRecorder.dispatch(neda::CAPTURE_PASS_PARTICLES, pushConstants.emitRequest, 0, 0);
+        
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, particleComputePipelineLayout, 0, 1, &particleDescriptorSets[currentFrame], 0, nullptr);
+        vkCmdPushConstants(commandBuffer, particleComputePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+        
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        VkPipelineStageFlags computeStages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+        auto passBarrier = [&] {
+            barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+            vkCmdPipelineBarrier(commandBuffer, computeStages, computeStages, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+        };
+        
+        // the last frame's passes on this queue wrote the state and read the arguments this frame works on
+        passBarrier();
+        if (!particlesInitialized) {
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, particleComputePipelines[neda::PARTICLE_PASS_INIT]);
+            vkCmdDispatch(commandBuffer, neda::ParticleConfig::CAPACITY / neda::ParticleConfig::GROUP_SIZE, 1, 1);
+            passBarrier();
+            particlesInitialized = true;
+        }
+        
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, particleComputePipelines[neda::PARTICLE_PASS_BEGIN]);
+        vkCmdDispatch(commandBuffer, 1, 1, 1);
+        passBarrier();
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, particleComputePipelines[neda::PARTICLE_PASS_EMIT]);
+        vkCmdDispatchIndirect(commandBuffer, particleCounterBuffer, offsetof(neda::ParticleCounters, emitDispatch));
+        passBarrier();
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, particleComputePipelines[neda::PARTICLE_PASS_SIMULATE]);
+        vkCmdDispatchIndirect(commandBuffer, particleCounterBuffer, offsetof(neda::ParticleCounters, simulateDispatch));
+        
+        particleHandoff().release(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                                  VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                                  VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+        particleAliveList = 1 - particleAliveList;
+    }
+    
+    // one indirect draw, the instance count is whatever survived the simulation
+    VkCommandBuffer recordParticleCommands(FrameCommands& frame) {
+        VkCommandBuffer commandBuffer = acquireSecondaryCommandBuffer(frame);
+        
+        VkCommandBufferInheritanceInfo inheritanceInfo{};
+        inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritanceInfo.renderPass = renderPass;
+        inheritanceInfo.subpass = 0;
+        inheritanceInfo.framebuffer = sceneFramebuffer;
+        
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        beginInfo.pInheritanceInfo = &inheritanceInfo;
+        if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+            throw std::runtime_error("failed to begin recording command buffer!");
+        }
+        
+        VkViewport viewport{0.0f, 0.0f, (float) renderExtent.width, (float) renderExtent.height, 0.0f, 1.0f};
+        VkRect2D scissor{{0, 0}, renderExtent};
+        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, particleRenderPipeline);
+        
+        struct {
+            neda::Mat4 viewProjection;
+            neda::Vec4 cameraRight;
+            neda::Vec4 cameraUp;
+        } pushConstants = {
+            viewProjection,
+            {viewMatrix.m[0], viewMatrix.m[4], viewMatrix.m[8], 0.0f},
+            {viewMatrix.m[1], viewMatrix.m[5], viewMatrix.m[9], 0.0f},
+        };
+        vkCmdPushConstants(commandBuffer, particleRenderPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(pushConstants), &pushConstants);
+        
+        VkDeviceSize offset = neda::PARTICLE_DRAW_HEADER_SIZE;
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, &particleDrawBuffers[currentFrame], &offset);
+        vkCmdDrawIndirect(commandBuffer, particleDrawBuffers[currentFrame], 0, 1, sizeof(VkDrawIndirectCommand));
+        
+        if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to record command buffer!");
+        }
+        return commandBuffer;
+    }
+    
+    void createSkinningResources() {
+        VkDeviceSize jointBufferSize = sizeof(neda::JointMatrix) * characterSkeleton.jointCount() * CHARACTER_COUNT;
+        VkDeviceSize skinnedBufferSize = sizeof(Vertex) * characterVertices.size() * CHARACTER_COUNT;
+        jointBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+        jointBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+        jointBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+        skinnedVertexBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+        skinnedVertexBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            createBuffer(jointBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, jointBuffers[i], jointBuffersMemory[i]);
+            createBuffer(skinnedBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, skinnedVertexBuffers[i], skinnedVertexBuffersMemory[i]);
+            
+            void* data;
+            vkMapMemory(device, jointBuffersMemory[i], 0, jointBufferSize, 0, &data);
+            jointBuffersMapped[i] = static_cast<neda::JointMatrix*>(data);
+        }
+        
+        VkDescriptorSetLayoutBinding bindings[3]{};
+        for (uint32_t i = 0; i < 3; i++) {
+            bindings[i].binding = i;
+            bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            bindings[i].descriptorCount = 1;
+            bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        }
+        VkDescriptorSetLayoutCreateInfo layoutInfo{};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.bindingCount = 3;
+        layoutInfo.pBindings = bindings;
+        if (vkCreateDescriptorSetLayout(device, &layoutInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT), &skinDescriptorSetLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create descriptor set layout!");
+        }
+        
+        VkDescriptorPoolSize poolSize{};
+        poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        poolSize.descriptorCount = 3 * MAX_FRAMES_IN_FLIGHT;
+        VkDescriptorPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.poolSizeCount = 1;
+        poolInfo.pPoolSizes = &poolSize;
+        poolInfo.maxSets = MAX_FRAMES_IN_FLIGHT;
+        if (vkCreateDescriptorPool(device, &poolInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_DESCRIPTOR_POOL), &skinDescriptorPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create descriptor pool!");
+        }
+        
+        std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, skinDescriptorSetLayout);
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = skinDescriptorPool;
+        allocInfo.descriptorSetCount = MAX_FRAMES_IN_FLIGHT;
+        allocInfo.pSetLayouts = layouts.data();
+        skinDescriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
+        if (vkAllocateDescriptorSets(device, &allocInfo, skinDescriptorSets.data()) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate descriptor sets!");
+        }
+        
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            VkDescriptorBufferInfo bufferInfos[3] = {
+                {bindPoseBuffer, 0, VK_WHOLE_SIZE},
+                {jointBuffers[i], 0, VK_WHOLE_SIZE},
+                {skinnedVertexBuffers[i], 0, VK_WHOLE_SIZE},
+            };
+            VkWriteDescriptorSet writes[3]{};
+            for (uint32_t binding = 0; binding < 3; binding++) {
+                writes[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                writes[binding].dstSet = skinDescriptorSets[i];
+                writes[binding].dstBinding = binding;
+                writes[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                writes[binding].descriptorCount = 1;
+                writes[binding].pBufferInfo = &bufferInfos[binding];
+            }
+            vkUpdateDescriptorSets(device, 3, writes, 0, nullptr);
+        }
+        
+        VkPushConstantRange pushConstantRange{};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = sizeof(neda::SkinPushConstants);
+        
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &skinDescriptorSetLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+        if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_PIPELINE_LAYOUT), &skinPipelineLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create pipeline layout!");
+        }
+        
+        auto computeShaderCode = readFile("skin.spv");
+        VkShaderModule computeShaderModule = createShaderModule(computeShaderCode);
+        
+        VkComputePipelineCreateInfo pipelineInfo{};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        pipelineInfo.stage.module = computeShaderModule;
+        pipelineInfo.stage.pName = "main";
+        pipelineInfo.layout = skinPipelineLayout;
+        if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_PIPELINE), &skinPipeline) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create compute pipeline!");
+        }
+        
+        vkDestroyShaderModule(device, computeShaderModule, hostAllocator.callbacks(VK_OBJECT_TYPE_SHADER_MODULE));
+    }
+    
+    // the index and draw buffers the culling writes, per frame since the last frame may still be drawing from its own
+    void createMeshletResources() {
+        VkDeviceSize indexBufferSize = sizeof(uint32_t) * 3 * terrainMeshlets.triangleCount;
+        meshletIndexBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+        meshletIndexBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+        meshletDrawBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+        meshletDrawBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            createBuffer(indexBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, meshletIndexBuffers[i], meshletIndexBuffersMemory[i]);
+            createBuffer(sizeof(VkDrawIndexedIndirectCommand), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, meshletDrawBuffers[i], meshletDrawBuffersMemory[i]);
+        }
+        
+        VkDescriptorSetLayoutBinding bindings[5]{};
+        for (uint32_t i = 0; i < 5; i++) {
+            bindings[i].binding = i;
+            bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            bindings[i].descriptorCount = 1;
+            bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        }
+        VkDescriptorSetLayoutCreateInfo layoutInfo{};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.bindingCount = 5;
+        layoutInfo.pBindings = bindings;
+        if (vkCreateDescriptorSetLayout(device, &layoutInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT), &meshletDescriptorSetLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create descriptor set layout!");
+        }
+        
+        VkDescriptorPoolSize poolSize{};
+        poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        poolSize.descriptorCount = 5 * MAX_FRAMES_IN_FLIGHT;
+        VkDescriptorPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.poolSizeCount = 1;
+        poolInfo.pPoolSizes = &poolSize;
+        poolInfo.maxSets = MAX_FRAMES_IN_FLIGHT;
+        if (vkCreateDescriptorPool(device, &poolInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_DESCRIPTOR_POOL), &meshletDescriptorPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create descriptor pool!");
+        }
+        
+        std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, meshletDescriptorSetLayout);
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = meshletDescriptorPool;
+        allocInfo.descriptorSetCount = MAX_FRAMES_IN_FLIGHT;
+        allocInfo.pSetLayouts = layouts.data();
+        meshletDescriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
+        if (vkAllocateDescriptorSets(device, &allocInfo, meshletDescriptorSets.data()) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate descriptor sets!");
+        }
+        
+        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            VkDescriptorBufferInfo bufferInfos[5] = {
+                {meshletBuffer, 0, VK_WHOLE_SIZE},
+                {meshletVertexBuffer, 0, VK_WHOLE_SIZE},
+                {meshletTriangleBuffer, 0, VK_WHOLE_SIZE},
+                {meshletIndexBuffers[i], 0, VK_WHOLE_SIZE},
+                {meshletDrawBuffers[i], 0, VK_WHOLE_SIZE},
+            };
+            VkWriteDescriptorSet writes[5]{};
+            for (uint32_t binding = 0; binding < 5; binding++) {
+                writes[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                writes[binding].dstSet = meshletDescriptorSets[i];
+                writes[binding].dstBinding = binding;
+                writes[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                writes[binding].descriptorCount = 1;
+                writes[binding].pBufferInfo = &bufferInfos[binding];
+            }
+            vkUpdateDescriptorSets(device, 5, writes, 0, nullptr);
+        }
+        
+        VkPushConstantRange pushConstantRange{};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = sizeof(neda::MeshletCullPushConstants);
+        
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &meshletDescriptorSetLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+        if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_PIPELINE_LAYOUT), &meshletPipelineLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create pipeline layout!");
+        }
+        
+        auto computeShaderCode = readFile("meshletCull.spv");
+        VkShaderModule computeShaderModule = createShaderModule(computeShaderCode);
+        
+        VkComputePipelineCreateInfo pipelineInfo{};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        pipelineInfo.stage.module = computeShaderModule;
+        pipelineInfo.stage.pName = "main";
+        pipelineInfo.layout = meshletPipelineLayout;
+        if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_PIPELINE), &meshletPipeline) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create compute pipeline!");
+        }
+        
+        vkDestroyShaderModule(device, computeShaderModule, hostAllocator.callbacks(VK_OBJECT_TYPE_SHADER_MODULE));
+    }
+    
+    // samples and blends every character's clips and writes its joint matrices for this frame's skinning.
+    // the characters don't depend on each other, so they are split across the job system
+    void animateCharacters() {
+        float time = static_cast<float>(frameTime);
+        uint32_t jointCount = characterSkeleton.jointCount();
+        neda::JointMatrix* mapped = jointBuffersMapped[currentFrame];
+        
+        jobSystem.parallelFor(CHARACTER_COUNT, CHARACTERS_PER_ANIMATION_JOB, [&](uint32_t begin, uint32_t end) {
+            NEDA_PROFILE_ZONE("animateCharacters");
+            neda::Pose pose, blendTarget;
+            pose.resize(characterSkeleton);
+            blendTarget.resize(characterSkeleton);
+            std::vector<neda::Mat4> modelScratch;
+            for (uint32_t i = begin; i < end; i++) {
+                const Character& character = characters[i];
+                float characterTime = time + character.timeOffset;
+                characterClips[0].sample(characterTime, pose);
+                characterClips[1].sample(characterTime, blendTarget);
+                neda::blendPoses(pose, blendTarget, 0.5f + 0.5f * std::sin(characterTime * character.blendRate), pose);
+                
+                float c = std::cos(character.heading) * character.scale;
+                float s = std::sin(character.heading) * character.scale;
+                neda::Mat4 world = neda::Mat4::identity();
+                world.at(0, 0) = c;
+                world.at(0, 2) = s;
+                world.at(1, 1) = character.scale;
+                world.at(2, 0) = -s;
+                world.at(2, 2) = c;
+                world.at(0, 3) = character.position.x;
+                world.at(1, 3) = character.position.y;
+                world.at(2, 3) = character.position.z;
+                neda::computeSkinMatrices(characterSkeleton, pose, world, modelScratch, mapped + i * jointCount);
+            }
+        });
+    }
+    
+    // one dispatch for the whole crowd in the frame's graphics buffer, in front of everything that draws it
+    void recordSkinning(VkCommandBuffer commandBuffer) {
+        neda::SkinPushConstants pushConstants{};
+        pushConstants.vertexCount = static_cast<uint32_t>(characterVertices.size());
+        pushConstants.jointCount = characterSkeleton.jointCount();
+        pushConstants.characterCount = CHARACTER_COUNT;
+        
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, skinPipeline);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, skinPipelineLayout, 0, 1, &skinDescriptorSets[currentFrame], 0, nullptr);
+        vkCmdPushConstants(commandBuffer, skinPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+        uint32_t vertexCount = pushConstants.vertexCount * CHARACTER_COUNT;
+        uint32_t groupCount = (vertexCount + neda::AnimationConfig::GROUP_SIZE - 1) / neda::AnimationConfig::GROUP_SIZE;
+        vkCmdDispatch(commandBuffer, groupCount, 1, 1);
+        commandRecorder.dispatch(neda::CAPTURE_PASS_SKINNING, groupCount, 1, 1);
+        
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+    
+    // the characters' draws for the scene pass, one command per visible character since each one's vertices are its own.
+    // they bind the skinned vertices where the static objects bind the shared vertex buffer
+    VkCommandBuffer recordCharacterCommands(FrameCommands& frame, const neda::Frustum& frustum) {
+        uint32_t visibleCount = neda::cullSpheres(frustum, characterBounds, 0, CHARACTER_COUNT, visibleCharacters.data());
+        visibleCharacterCount = visibleCount;
+        VkCommandBuffer commandBuffer = acquireSecondaryCommandBuffer(frame);
+        
+        VkCommandBufferInheritanceInfo inheritanceInfo{};
+        inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritanceInfo.renderPass = renderPass;
+        inheritanceInfo.subpass = 0;
+        inheritanceInfo.framebuffer = sceneFramebuffer;
+        
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        beginInfo.pInheritanceInfo = &inheritanceInfo;
+        if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+            throw std::runtime_error("failed to begin recording command buffer!");
+        }
+        
+        VkViewport viewport{0.0f, 0.0f, (float) renderExtent.width, (float) renderExtent.height, 0.0f, 1.0f};
+        VkRect2D scissor{{0, 0}, renderExtent};
+        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipelines[PIPELINE_OPAQUE]);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &lightingDescriptorSets[currentFrame], 0, nullptr);
+        MaterialConstants untinted = {{1.0f, 1.0f, 1.0f, 1.0f}};
+        vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(neda::Mat4), &viewProjection);
+        vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, sizeof(neda::Mat4), sizeof(MaterialConstants), &untinted);
+        
+        VkBuffer vertexBuffers[] = {skinnedVertexBuffers[currentFrame], characterInstanceBuffer};
+        VkDeviceSize offsets[] = {0, 0};
+        vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, offsets);
+        recordCharacterDraws(commandBuffer, visibleCharacters.data(), visibleCount, 0);
+        
+        if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to record command buffer!");
+        }
+        return commandBuffer;
+    }
+    
+    // the given characters with the skinned vertices bound, into range `range` of the frame's character commands as one
+    // multi draw. without multiDrawIndirect it's a draw per character, the instance is what gives each one its color so
+    // neighbours can't be merged into one plain draw either
+    void recordCharacterDraws(VkCommandBuffer commandBuffer, const uint32_t* characters, uint32_t count, uint32_t range) {
+        if (count == 0) return;
+        uint32_t vertexCount = static_cast<uint32_t>(characterVertices.size());
+        if (multiDrawIndirectSupported) {
+            VkDrawIndirectCommand* commands = characterIndirectBuffersMapped[currentFrame] + range * CHARACTER_COUNT;
+            for (uint32_t i = 0; i < count; i++) {
+                commands[i] = {vertexCount, 1, characters[i] * vertexCount, characters[i]};
+            }
+            vkCmdDrawIndirect(commandBuffer, characterIndirectBuffers[currentFrame], range * CHARACTER_COUNT * sizeof(VkDrawIndirectCommand), count, sizeof(VkDrawIndirectCommand));
+        } else {
+            for (uint32_t i = 0; i < count; i++) {
+                vkCmdDraw(commandBuffer, vertexCount, 1, characters[i] * vertexCount, characters[i]);
+            }
+        }
+    }
+    
+    // in the frame's graphics buffer in front of the scene pass. the draw is reset to no indices first, the culling
+    // counts the visible triangles into it
+    void recordMeshletCulling(VkCommandBuffer commandBuffer, const neda::Frustum& frustum) {
+        VkDrawIndexedIndirectCommand draw{0, 1, 0, static_cast<int32_t>(terrainFirstVertex), 0};
+        vkCmdUpdateBuffer(commandBuffer, meshletDrawBuffers[currentFrame], 0, sizeof(draw), &draw);
+        
+        VkBufferMemoryBarrier resetBarrier{};
+        resetBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        resetBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        resetBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        resetBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        resetBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        resetBarrier.buffer = meshletDrawBuffers[currentFrame];
+        resetBarrier.offset = 0;
+        resetBarrier.size = VK_WHOLE_SIZE;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &resetBarrier, 0, nullptr);
+        
+        neda::MeshletCullPushConstants pushConstants{};
+        memcpy(pushConstants.planes, frustum.planes, sizeof(pushConstants.planes));
+        pushConstants.cameraPosition = cameraPosition;
+        pushConstants.meshletCount = static_cast<uint32_t>(terrainMeshlets.meshlets.size());
+        
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, meshletPipeline);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, meshletPipelineLayout, 0, 1, &meshletDescriptorSets[currentFrame], 0, nullptr);
+        vkCmdPushConstants(commandBuffer, meshletPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+        vkCmdDispatch(commandBuffer, pushConstants.meshletCount, 1, 1);
+        commandRecorder.dispatch(neda::CAPTURE_PASS_MESHLET_CULLING, pushConstants.meshletCount, 1, 1);
+        
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                             0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+    
+    // the terrain's one draw for the scene pass, with however many indices the culling left
+    VkCommandBuffer recordTerrainCommands(FrameCommands& frame) {
+        VkCommandBuffer commandBuffer = acquireSecondaryCommandBuffer(frame);
+        
+        VkCommandBufferInheritanceInfo inheritanceInfo{};
+        inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritanceInfo.renderPass = renderPass;
+        inheritanceInfo.subpass = 0;
+        inheritanceInfo.framebuffer = sceneFramebuffer;
+        
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        beginInfo.pInheritanceInfo = &inheritanceInfo;
+        if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+            throw std::runtime_error("failed to begin recording command buffer!");
+        }
+        
+        VkViewport viewport{0.0f, 0.0f, (float) renderExtent.width, (float) renderExtent.height, 0.0f, 1.0f};
+        VkRect2D scissor{{0, 0}, renderExtent};
+        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+        // back faces have to be culled in the draw too, the cone test only drops meshlets that have nothing else
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipelines[PIPELINE_OPAQUE]);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &lightingDescriptorSets[currentFrame], 0, nullptr);
+        MaterialConstants untinted = {{1.0f, 1.0f, 1.0f, 1.0f}};
+        vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(neda::Mat4), &viewProjection);
+        vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, sizeof(neda::Mat4), sizeof(MaterialConstants), &untinted);
+        
+        VkBuffer vertexBuffers[] = {vertexBuffer, terrainInstanceBuffer};
+        VkDeviceSize offsets[] = {0, 0};
+        vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, offsets);
+        vkCmdBindIndexBuffer(commandBuffer, meshletIndexBuffers[currentFrame], 0, VK_INDEX_TYPE_UINT32);
+        vkCmdDrawIndexedIndirect(commandBuffer, meshletDrawBuffers[currentFrame], 0, 1, sizeof(VkDrawIndexedIndirectCommand));
+        
+        if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to record command buffer!");
+        }
+        return commandBuffer;
+    }
+    
+    // records and submits this frame's compute queue work, the returned value is what the graphics submit waits on
+    uint64_t submitAsyncCompute(const neda::Frustum& frustum) {
+        ComputeFrame& computeFrame = computeFrames[currentFrame];
+        vkResetCommandPool(device, computeFrame.pool, 0);
+        
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        if (vkBeginCommandBuffer(computeFrame.commandBuffer, &beginInfo) != VK_SUCCESS) {
+            throw std::runtime_error("failed to begin recording command buffer!");
+        }
+        
+        if (benchmark.enabled) {
+            vkCmdResetQueryPool(computeFrame.commandBuffer, computeFrame.timestamps, 0, 2);
+            vkCmdWriteTimestamp(computeFrame.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, computeFrame.timestamps, 0);
+        }
+        if (computeProfiler.isCreated()) {
+            computeProfiler.beginFrame(computeFrame.commandBuffer, static_cast<uint32_t>(currentFrame));
+        }
+        if (useGpuCulling && useAsyncCompute) {
+            NEDA_GPU_ZONE(computeProfiler, computeFrame.commandBuffer, "gpuCulling");
+            recordGpuCulling(computeFrame.commandBuffer, frustum);
+        }
+        if (useParticles) {
+            NEDA_GPU_ZONE(computeProfiler, computeFrame.commandBuffer, "particles");
+            recordParticleSimulation(computeFrame.commandBuffer);
+        }
+        if (benchmark.enabled) {
+            vkCmdWriteTimestamp(computeFrame.commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, computeFrame.timestamps, 1);
+        }
+        
+        if (vkEndCommandBuffer(computeFrame.commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to record command buffer!");
+        }
+        
+        neda::QueueSubmission submission;
+        submission.addCommandBuffer(computeFrame.commandBuffer);
+        uint64_t value = submission.submit(computeTimeline);
+        computeProfiler.submitted();
+        return value;
+    }
+    
+    // called once the frame slot's previous submits are done, like the benchmark timestamps
+    void collectGpuZones(uint32_t frameIndex) {
+        gpuClock.calibrate();
+        graphicsProfiler.collect(frameIndex, gpuClock);
+        computeProfiler.collect(frameIndex, gpuClock);
+    }
+    
+    // after the device is idle, so the frames still in flight make it into the trace too
+    void writeTrace() {
+        for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+            collectGpuZones((static_cast<uint32_t>(currentFrame) + i) % MAX_FRAMES_IN_FLIGHT);
+        }
+        neda::Profiler::instance().writeChromeTrace(tracePath);
+        std::cout << "wrote trace to " << tracePath << std::endl;
+    }
+    
+    // called once the frame slot's previous submits are done, so its queries have results
+    void collectBenchmarkTimestamps() {
+        if (!benchmark.enabled || !frameHasTimestamps[currentFrame]) return;
+        
+        uint64_t graphics[4] = {};
+        uint32_t graphicsQueryCount = frameBenchmarkModes[currentFrame] == neda::OverlapBenchmark::SERIAL ? 4 : 2;
+        vkGetQueryPoolResults(device, graphicsTimestamps[currentFrame], 0, graphicsQueryCount, sizeof(graphics), graphics, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+        
+        double toMilliseconds = timestampPeriod / 1e6;
+        double graphicsTime = (graphics[1] - graphics[0]) * toMilliseconds;
+        double computeTime = 0.0;
+        if (frameBenchmarkModes[currentFrame] == neda::OverlapBenchmark::SERIAL) {
+            computeTime = (graphics[3] - graphics[2]) * toMilliseconds;
+        } else {
+            uint64_t compute[2] = {};
+            vkGetQueryPoolResults(device, computeFrames[currentFrame].timestamps, 0, 2, sizeof(compute), compute, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+            computeTime = (compute[1] - compute[0]) * toMilliseconds;
+        }
+        benchmark.addSample(frameBenchmarkModes[currentFrame], graphicsTime, computeTime);
+    }
+    
+    // called once the frame slot's previous submits are done, hands the frame's gpu time to the controller
+    void collectFrameTime() {
+        if (!frameHasFrameTime[currentFrame]) return;
+        frameHasFrameTime[currentFrame] = false;
+        
+        uint64_t timestamps[2] = {};
+        vkGetQueryPoolResults(device, frameTimeQueries[currentFrame], 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+        float milliseconds = static_cast<float>((timestamps[1] - timestamps[0]) * (timestampPeriod / 1e6));
+        if (useDynamicResolution) {
+            dynamicResolution.addSample(milliseconds, frameRenderScales[currentFrame]);
+        }
+        if (replaying) {
+            replayTimings.setGpu(frameReplayFrames[currentFrame], milliseconds);
+        }
+    }
+    
+    // picks this frame's mode, and once every round is done prints the result and closes the window
+    void advanceBenchmark() {
+        if (!benchmark.enabled) return;
+        
+        if (benchmark.isFinished()) {
+            std::cout << "async compute benchmark, " << benchmark.samples[neda::OverlapBenchmark::ASYNC] << " async and "
+                      << benchmark.samples[neda::OverlapBenchmark::SERIAL] << " serial frames" << std::endl;
+            std::cout << "  serial: graphics queue " << benchmark.averageGraphics(neda::OverlapBenchmark::SERIAL) << " ms/frame, "
+                      << benchmark.averageCompute(neda::OverlapBenchmark::SERIAL) << " ms of it compute" << std::endl;
+            std::cout << "  async:  graphics queue " << benchmark.averageGraphics(neda::OverlapBenchmark::ASYNC) << " ms/frame, compute queue "
+                      << benchmark.averageCompute(neda::OverlapBenchmark::ASYNC) << " ms/frame" << std::endl;
+            std::cout << "  overlap takes " << benchmark.averageGraphics(neda::OverlapBenchmark::SERIAL) - benchmark.averageGraphics(neda::OverlapBenchmark::ASYNC)
+                      << " ms/frame off the graphics queue" << (asyncComputeSupported ? "" : " (no async compute queue, both halves ran serially)") << std::endl;
+            glfwSetWindowShouldClose(window, GLFW_TRUE);
+        }
+        
+        useAsyncCompute = asyncComputeSupported && benchmark.currentMode() == neda::OverlapBenchmark::ASYNC;
+        frameBenchmarkModes[currentFrame] = useAsyncCompute ? neda::OverlapBenchmark::ASYNC : neda::OverlapBenchmark::SERIAL;
+        frameHasTimestamps[currentFrame] = !benchmark.isWarmingUp();
+        benchmark.frame++;
+    }
+    
+    // the capture decides what runs and every frame's size, so the dynamic resolution controller stays off
+    void loadReplay() {
+        replayLog = neda::CaptureLog::load(replayPath);
+        replaying = true;
+        useParticles = (replayLog.flags & neda::CAPTURE_FLAG_PARTICLES) != 0;
+        useSkinning = (replayLog.flags & neda::CAPTURE_FLAG_SKINNING) != 0;
+        usePostProcessing = (replayLog.flags & neda::CAPTURE_FLAG_POST_PROCESSING) != 0;
+        useGpuCulling = (replayLog.flags & neda::CAPTURE_FLAG_GPU_CULLING) != 0;
+        useMeshlets = (replayLog.flags & neda::CAPTURE_FLAG_MESHLETS) != 0;
+        useDynamicResolution = false;
+        replayTimings.resize(replayLog.frames.size());
+        std::cout << "replaying " << replayLog.frames.size() << " frames of " << replayPath << std::endl;
+    }
+    
+    uint32_t captureFlags() const {
+        return (useParticles ? neda::CAPTURE_FLAG_PARTICLES : 0) | (useSkinning ? neda::CAPTURE_FLAG_SKINNING : 0) |
+               (usePostProcessing ? neda::CAPTURE_FLAG_POST_PROCESSING : 0) | (useGpuCulling ? neda::CAPTURE_FLAG_GPU_CULLING : 0) |
+               (useMeshlets ? neda::CAPTURE_FLAG_MESHLETS : 0);
+    }
+    
+    // the frame's draws once the frame graph is done, in a fixed order no matter which job recorded them. the characters
+    // have no mesh of their own, their draws use the mesh ids after the last one
+    void captureDraws() {
+        if (!commandRecorder.enabled()) return;
+        const std::vector<neda::DrawBatch>& batches = useGpuCulling ? gpuCullBuckets : renderQueue.batches();
+        for (const neda::DrawBatch& batch : batches) {
+            commandRecorder.draw(batch.pipeline, batch.material, batch.mesh, batch.itemCount);
+        }
+        uint32_t characterMesh = static_cast<uint32_t>(meshes.size());
+        if (useSkinning) {
+            for (uint32_t i = 0; i < visibleCharacterCount; i++) {
+                commandRecorder.draw(PIPELINE_OPAQUE, static_cast<uint32_t>(materials.size()), characterMesh + visibleCharacters[i], 1);
+            }
+        }
+        for (const ShadowDraw& draw : shadowDraws) {
+            commandRecorder.shadowDraw(draw.cascade, draw.mesh, draw.instanceCount);
+        }
+        for (uint32_t cascade = 0; cascade < shadows.settings().cascadeCount; cascade++) {
+            for (uint32_t character : shadowCharacters[cascade]) {
+                commandRecorder.shadowDraw(cascade, characterMesh + character, 1);
+            }
+        }
+    }
+    
+    // right after the submit, the frame's gpu time comes in once its slot is done
+    void finishReplayFrame(std::chrono::steady_clock::time_point cpuStart) {
+        std::chrono::duration<float, std::milli> cpuTime = std::chrono::steady_clock::now() - cpuStart;
+        replayTimings.setCpu(replayFrame, cpuTime.count());
+        if (commandRecorder.frameCommands() != replayLog.frames[replayFrame].commands) {
+            replayTimings.addMismatch(replayFrame);
+        }
+        frameReplayFrames[currentFrame] = replayFrame;
+        replayFrame++;
+    }
+    
+    // with the device idle, the last frames' gpu times are there too
+    void finishReplay() {
+        for (currentFrame = 0; currentFrame < MAX_FRAMES_IN_FLIGHT; currentFrame++) {
+            collectFrameTime();
+        }
+        replayTimings.print(std::cout);
+    }
+    
+    VkFormat findSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features) {
+        for (VkFormat format : candidates) {
+            VkFormatProperties props;
+            vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &props);
+
+            if (tiling == VK_IMAGE_TILING_LINEAR && (props.linearTilingFeatures & features) == features) {
+                return format;
+            } else if (tiling == VK_IMAGE_TILING_OPTIMAL && (props.optimalTilingFeatures & features) == features) {
+                return format;
+            }
+        }
+
+        throw std::runtime_error("failed to find supported format!");
+    }
+    
+    VkFormat findDepthFormat() {
+        return findSupportedFormat({VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT},
+                                   VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+    }
+    
+    // the shadow maps are sampled with a compare sampler, and linear filtering gives 2x2 pcf for free
+    VkFormat findShadowFormat() {
+        return findSupportedFormat({VK_FORMAT_D32_SFLOAT, VK_FORMAT_D16_UNORM}, VK_IMAGE_TILING_OPTIMAL,
+                                   VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT);
+    }
+    
+    void createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory, uint32_t arrayLayers = 1, uint32_t mipLevels = 1) {
+        commandRecorder.createImage(width, height, format, mipLevels, usage);
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent.width = width;
+        imageInfo.extent.height = height;
+        imageInfo.extent.depth = 1;
+        imageInfo.mipLevels = mipLevels;
+        imageInfo.arrayLayers = arrayLayers;
+        imageInfo.format = format;
+        imageInfo.tiling = tiling;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = usage;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        if (vkCreateImage(device, &imageInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_IMAGE), &image) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create image!");
+        }
+
+        VkMemoryRequirements memRequirements;
+        vkGetImageMemoryRequirements(device, image, &memRequirements);
+
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = memRequirements.size;
+        allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+
+        if (vkAllocateMemory(device, &allocInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_DEVICE_MEMORY), &imageMemory) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate image memory!");
+        }
+
+        vkBindImageMemory(device, image, imageMemory, 0);
+    }
+    
+    VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags,
+                                VkImageViewType viewType = VK_IMAGE_VIEW_TYPE_2D, uint32_t baseArrayLayer = 0, uint32_t layerCount = 1,
+                                uint32_t baseMipLevel = 0) {
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = image;
+        viewInfo.viewType = viewType;
+        viewInfo.format = format;
+        viewInfo.subresourceRange.aspectMask = aspectFlags;
+        viewInfo.subresourceRange.baseMipLevel = baseMipLevel;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.baseArrayLayer = baseArrayLayer;
+        viewInfo.subresourceRange.layerCount = layerCount;
+
+        VkImageView imageView;
+        if (vkCreateImageView(device, &viewInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_IMAGE_VIEW), &imageView) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create image views!");
+        }
+
+        return imageView;
+    }
+    
+    void createDepthResources() {
+        createImage(swapChainExtent.width, swapChainExtent.height, depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depthImage, depthImageMemory);
+        depthImageView = createImageView(depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
+    }
+    
+    // full swapchain size, so a scale change never has to recreate it. the upscale pass's descriptor set lives and
+    // dies with it, and so does the post chain's output when the swapchain can't take it
+    void createSceneColorResources() {
+        createImage(swapChainExtent.width, swapChainExtent.height, sceneColorFormat, VK_IMAGE_TILING_OPTIMAL,
+                    VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                    sceneColorImage, sceneColorImageMemory);
+        sceneColorImageView = createImageView(sceneColorImage, sceneColorFormat, VK_IMAGE_ASPECT_COLOR_BIT);
+        
+        VkImageView presentedView = sceneColorImageView;
+        if (usePostProcessing && !storageSwapchainSupported) {
+            createImage(swapChainExtent.width, swapChainExtent.height, VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_TILING_OPTIMAL,
+                        VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                        postOutputImage, postOutputImageMemory);
+            postOutputImageView = createImageView(postOutputImage, VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT);
+            presentedView = postOutputImageView;
+        }
+        
+        VkDescriptorPoolSize poolSize{};
+        poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        poolSize.descriptorCount = 1;
+        VkDescriptorPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.poolSizeCount = 1;
+        poolInfo.pPoolSizes = &poolSize;
+        poolInfo.maxSets = 1;
+        if (vkCreateDescriptorPool(device, &poolInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_DESCRIPTOR_POOL), &upscaleDescriptorPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create descriptor pool!");
+        }
+        
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = upscaleDescriptorPool;
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &upscaleDescriptorSetLayout;
+        if (vkAllocateDescriptorSets(device, &allocInfo, &upscaleDescriptorSet) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate descriptor sets!");
+        }
+        
+        VkDescriptorImageInfo imageInfo{upscaleSampler, presentedView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+        VkWriteDescriptorSet write{};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = upscaleDescriptorSet;
+        write.dstBinding = 0;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        write.descriptorCount = 1;
+        write.pImageInfo = &imageInfo;
+        vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+    }
+    
+    // every pass of the chain is the same shader with its own specialization constant and one layout for all of them.
+    // the shader is built twice, see post.comp
+    void createPostPipelines() {
+        if (!usePostProcessing) return;
+        
+        VkDescriptorSetLayoutBinding bindings[5]{};
+        const VkDescriptorType types[5] = {
+            VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, // the scene target
+            VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, // the bloom mip the pass reads
+            VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, // the bloom mip it writes
+            VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, // the composite's output
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, // the exposure
+        };
+        for (uint32_t i = 0; i < 5; i++) {
+            bindings[i].binding = i;
+            bindings[i].descriptorType = types[i];
+            bindings[i].descriptorCount = 1;
+            bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        }
+        VkDescriptorSetLayoutCreateInfo layoutInfo{};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.bindingCount = 5;
+        layoutInfo.pBindings = bindings;
+        if (vkCreateDescriptorSetLayout(device, &layoutInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT), &postDescriptorSetLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create descriptor set layout!");
+        }
+        
+        VkPushConstantRange pushConstantRange{};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = sizeof(neda::PostPushConstants);
+        
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &postDescriptorSetLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+        if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_PIPELINE_LAYOUT), &postPipelineLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create pipeline layout!");
+        }
+        
+        auto computeShaderCode = readFile(storageSwapchainSupported ? "postSwapchain.spv" : "post.spv");
+        VkShaderModule computeShaderModule = createShaderModule(computeShaderCode);
+        
+        uint32_t passes[neda::POST_PASS_COUNT];
+        VkSpecializationMapEntry specializationEntry{0, 0, sizeof(uint32_t)};
+        VkSpecializationInfo specializationInfos[neda::POST_PASS_COUNT]{};
+        VkComputePipelineCreateInfo pipelineInfos[neda::POST_PASS_COUNT]{};
+        for (uint32_t pass = 0; pass < neda::POST_PASS_COUNT; pass++) {
+            passes[pass] = pass;
+            specializationInfos[pass].mapEntryCount = 1;
+            specializationInfos[pass].pMapEntries = &specializationEntry;
+            specializationInfos[pass].dataSize = sizeof(uint32_t);
+            specializationInfos[pass].pData = &passes[pass];
+            
+            pipelineInfos[pass].sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+            pipelineInfos[pass].stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+            pipelineInfos[pass].stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+            pipelineInfos[pass].stage.module = computeShaderModule;
+            pipelineInfos[pass].stage.pName = "main";
+            pipelineInfos[pass].stage.pSpecializationInfo = &specializationInfos[pass];
+            pipelineInfos[pass].layout = postPipelineLayout;
+        }
+        if (vkCreateComputePipelines(device, VK_NULL_HANDLE, neda::POST_PASS_COUNT, pipelineInfos, hostAllocator.callbacks(VK_OBJECT_TYPE_PIPELINE), postPipelines) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create compute pipeline!");
+        }
+        vkDestroyShaderModule(device, computeShaderModule, hostAllocator.callbacks(VK_OBJECT_TYPE_SHADER_MODULE));
+        
+        // zeroed on the gpu before the first frame uses it
+        createBuffer(sizeof(neda::ExposureState), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, exposureBuffer, exposureBufferMemory);
+    }
+    
+    // the bloom mips and the chain's descriptor sets, sized by the swapchain. every set has all five bindings filled,
+    // the ones a pass doesn't use point at the first bloom mip
+    void createPostResources() {
+        if (!usePostProcessing) return;
+        
+        bloomMipCount = neda::bloomMipCount(swapChainExtent.width, swapChainExtent.height);
+        createImage(neda::bloomMipSize(swapChainExtent.width, 0), neda::bloomMipSize(swapChainExtent.height, 0), VK_FORMAT_R16G16B16A16_SFLOAT,
+                    VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                    bloomImage, bloomImageMemory, 1, bloomMipCount);
+        bloomMipViews.resize(bloomMipCount);
+        for (uint32_t mip = 0; mip < bloomMipCount; mip++) {
+            bloomMipViews[mip] = createImageView(bloomImage, VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_VIEW_TYPE_2D, 0, 1, mip);
+        }
+        
+        uint32_t compositeSetCount = storageSwapchainSupported ? static_cast<uint32_t>(swapChainImageViews.size()) : 1;
+        uint32_t setCount = 1 + 2 * (bloomMipCount - 1) + compositeSetCount;
+        VkDescriptorPoolSize poolSizes[3]{};
+        poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        poolSizes[0].descriptorCount = 2 * setCount;
+        poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        poolSizes[1].descriptorCount = 2 * setCount;
+        poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        poolSizes[2].descriptorCount = setCount;
+        VkDescriptorPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.poolSizeCount = 3;
+        poolInfo.pPoolSizes = poolSizes;
+        poolInfo.maxSets = setCount;
+        if (vkCreateDescriptorPool(device, &poolInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_DESCRIPTOR_POOL), &postDescriptorPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create descriptor pool!");
+        }
+        
+        std::vector<VkDescriptorSetLayout> layouts(setCount, postDescriptorSetLayout);
+        std::vector<VkDescriptorSet> sets(setCount);
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = postDescriptorPool;
+        allocInfo.descriptorSetCount = setCount;
+        allocInfo.pSetLayouts = layouts.data();
+        if (vkAllocateDescriptorSets(device, &allocInfo, sets.data()) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate descriptor sets!");
+        }
+        
+        // the bloom mips stay in the general layout, they are sampled and written within the chain
+        auto writeSet = [&](VkDescriptorSet set, VkImageView source, VkImageView target, VkImageView output) {
+            VkDescriptorImageInfo imageInfos[4] = {
+                {upscaleSampler, sceneColorImageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+                {upscaleSampler, source, VK_IMAGE_LAYOUT_GENERAL},
+                {VK_NULL_HANDLE, target, VK_IMAGE_LAYOUT_GENERAL},
+                {VK_NULL_HANDLE, output, VK_IMAGE_LAYOUT_GENERAL},
+            };
+            VkDescriptorBufferInfo bufferInfo{exposureBuffer, 0, VK_WHOLE_SIZE};
+            VkWriteDescriptorSet writes[5]{};
+            for (uint32_t binding = 0; binding < 5; binding++) {
+                writes[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                writes[binding].dstSet = set;
+                writes[binding].dstBinding = binding;
+                writes[binding].descriptorCount = 1;
+                if (binding == 4) {
+                    writes[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                    writes[binding].pBufferInfo = &bufferInfo;
+                } else {
+                    writes[binding].descriptorType = binding < 2 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+                    writes[binding].pImageInfo = &imageInfos[binding];
+                }
+            }
+            vkUpdateDescriptorSets(device, 5, writes, 0, nullptr);
+        };
+        
+        uint32_t next = 0;
+        postPrefilterSet = sets[next++];
+        writeSet(postPrefilterSet, bloomMipViews[0], bloomMipViews[0], bloomMipViews[0]);
+        postDownsampleSets.assign(bloomMipCount, VK_NULL_HANDLE);
+        postUpsampleSets.assign(bloomMipCount, VK_NULL_HANDLE);
+        for (uint32_t mip = 1; mip < bloomMipCount; mip++) {
+            postDownsampleSets[mip] = sets[next++];
+            writeSet(postDownsampleSets[mip], bloomMipViews[mip - 1], bloomMipViews[mip], bloomMipViews[0]);
+            postUpsampleSets[mip - 1] = sets[next++];
+            writeSet(postUpsampleSets[mip - 1], bloomMipViews[mip], bloomMipViews[mip - 1], bloomMipViews[0]);
+        }
+        postCompositeSets.resize(compositeSetCount);
+        for (uint32_t i = 0; i < compositeSetCount; i++) {
+            postCompositeSets[i] = sets[next++];
+            writeSet(postCompositeSets[i], bloomMipViews[0], bloomMipViews[0], storageSwapchainSupported ? swapChainImageViews[i] : postOutputImageView);
+        }
+    }
+    
+    // a fullscreen triangle that samples the rendered part of the scene target, bilinear is the whole upscale
+    void createUpscalePipeline() {
+        dynamicResolution.configure(neda::DynamicResolutionSettings());
+        
+        VkSamplerCreateInfo samplerInfo{};
+        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        samplerInfo.magFilter = VK_FILTER_LINEAR;
+        samplerInfo.minFilter = VK_FILTER_LINEAR;
+        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.maxLod = 0.0f;
+        if (vkCreateSampler(device, &samplerInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_SAMPLER), &upscaleSampler) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create upscale sampler!");
+        }
+        
+        VkDescriptorSetLayoutBinding binding{};
+        binding.binding = 0;
+        binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        binding.descriptorCount = 1;
+        binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+        VkDescriptorSetLayoutCreateInfo layoutInfo{};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.bindingCount = 1;
+        layoutInfo.pBindings = &binding;
+        if (vkCreateDescriptorSetLayout(device, &layoutInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT), &upscaleDescriptorSetLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create descriptor set layout!");
+        }
+        
+        auto vertShaderCode = readFile("upscaleVert.spv");
+        auto fragShaderCode = readFile("upscaleFrag.spv");
+        VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
+        VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
+        
+        VkPipelineShaderStageCreateInfo shaderStages[2]{};
+        shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+        shaderStages[0].module = vertShaderModule;
+        shaderStages[0].pName = "main";
+        shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+        shaderStages[1].module = fragShaderModule;
+        shaderStages[1].pName = "main";
+        
+        VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+        vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+        
+        VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+        inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+        inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+        
+        VkPipelineViewportStateCreateInfo viewportState{};
+        viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+        viewportState.viewportCount = 1;
+        viewportState.scissorCount = 1;
+        
+        VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+        VkPipelineDynamicStateCreateInfo dynamicState{};
+        dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+        dynamicState.dynamicStateCount = 2;
+        dynamicState.pDynamicStates = dynamicStates;
+        
+        VkPipelineRasterizationStateCreateInfo rasterizer{};
+        rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+        rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+        rasterizer.lineWidth = 1.0f;
+        rasterizer.cullMode = VK_CULL_MODE_NONE;
+        rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+        
+        VkPipelineMultisampleStateCreateInfo multisampling{};
+        multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+        multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+        
+        VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+        colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+        colorBlendAttachment.blendEnable = VK_FALSE;
+        
+        VkPipelineColorBlendStateCreateInfo colorBlending{};
+        colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+        colorBlending.attachmentCount = 1;
+        colorBlending.pAttachments = &colorBlendAttachment;
+        
+        // the rendered part's size as a fraction of the target, and the last uv that is still inside it
+        VkPushConstantRange pushConstantRange{};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = 4 * sizeof(float);
+        
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &upscaleDescriptorSetLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+        if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_PIPELINE_LAYOUT), &upscalePipelineLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create pipeline layout!");
+        }
+        
+        VkGraphicsPipelineCreateInfo pipelineInfo{};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+        pipelineInfo.stageCount = 2;
+        pipelineInfo.pStages = shaderStages;
+        pipelineInfo.pVertexInputState = &vertexInputInfo;
+        pipelineInfo.pInputAssemblyState = &inputAssembly;
+        pipelineInfo.pViewportState = &viewportState;
+        pipelineInfo.pRasterizationState = &rasterizer;
+        pipelineInfo.pMultisampleState = &multisampling;
+        pipelineInfo.pColorBlendState = &colorBlending;
+        pipelineInfo.pDynamicState = &dynamicState;
+        pipelineInfo.layout = upscalePipelineLayout;
+        pipelineInfo.renderPass = upscaleRenderPass;
+        pipelineInfo.subpass = 0;
+        if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_PIPELINE), &upscalePipeline) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create upscale pipeline!");
+        }
+        
+        vkDestroyShaderModule(device, fragShaderModule, hostAllocator.callbacks(VK_OBJECT_TYPE_SHADER_MODULE));
+        vkDestroyShaderModule(device, vertShaderModule, hostAllocator.callbacks(VK_OBJECT_TYPE_SHADER_MODULE));
+    }
+    
+    VkShaderModule createShaderModule(const std::vector<char>& code) {
+        VkShaderModuleCreateInfo createInfo{};
+        createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        createInfo.codeSize = code.size();
+        createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+
+        VkShaderModule shaderModule;
+        if (vkCreateShaderModule(device, &createInfo, hostAllocator.callbacks(VK_OBJECT_TYPE_SHADER_MODULE), &shaderModule) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create shader module!");
+        }
+
+        return shaderModule;
+    }
+    
+    // swap surface format == color depth
+    VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats) {
+        VkSurfaceFormatKHR storageFormat;
+        if (storageSwapchainSupported && findStorageSurfaceFormat(availableFormats, storageFormat)) {
+            return storageFormat; // the post chain encodes srgb itself
+        }
+        for (const auto& availableFormat : availableFormats) { // we want SRGB, but if we cant have that is doenst reallly matter
+            if (availableFormat.format == VK_FORMAT_B8G8R8A8_SRGB && availableFormat.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) {
+                return availableFormat;
+            }
+        }
+        return availableFormats[0];
+
+    }
+    // an 8 bit unorm format in the srgb color space that compute shaders can write
+    bool findStorageSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats, VkSurfaceFormatKHR& format) {
+        for (const auto& availableFormat : availableFormats) {
+            if ((availableFormat.format != VK_FORMAT_B8G8R8A8_UNORM && availableFormat.format != VK_FORMAT_R8G8B8A8_UNORM) ||
+                availableFormat.colorSpace != VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) {
+                continue;
+            }
+            VkFormatProperties properties;
+            vkGetPhysicalDeviceFormatProperties(physicalDevice, availableFormat.format, &properties);
+            if (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT) {
+                format = availableFormat;
+                return true;
+            }
+        }
+        return false;
+    }
+    VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes) {
+        return VK_PRESENT_MODE_FIFO_KHR; // this is just were the swap chain acts as a quueue and if queue is full program has to wait
+    }
+    
+    //swap extent == resolution of swap chain images
+    VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities) {
+        if (capabilities.currentExtent.width != UINT32_MAX) {
+            return capabilities.currentExtent;
+        } else {
+            // a headless surface has no size of its own, it gets the captured one
+            int width = static_cast<int>(replayLog.width), height = static_cast<int>(replayLog.height);
+            if (!headless) {
+                glfwGetFramebufferSize(window, &width, &height);
+            }
+            VkExtent2D actualExtent = {static_cast<uint32_t>(width), static_cast<uint32_t>(height)};
 
             // claming the width and the heigth of the swam chain images to be within the capabilites of graphics and window
             actualExtent.width = std::max(capabilities.minImageExtent.width, std::min(capabilities.maxImageExtent.width, actualExtent.width));
@@ -824,12 +4926,42 @@ private:
         bool extensionsSupperted = checkDeviceExtensionSupport(device);
         bool swapChainAdequate = false;
         
+        bool timelineSupported = false;
+        
         if(extensionsSupperted){
             SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
             swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
+            timelineSupported = isTimelineSemaphoreSupported(device);
         }
 
-        return indices.isComplete() && extensionsSupperted && swapChainAdequate;
+        return indices.isComplete() && extensionsSupperted && swapChainAdequate && timelineSupported;
+    }
+    // listing VK_KHR_timeline_semaphore doesn't mean the feature is there, every submit and frame wait relies on it
+    bool isTimelineSemaphoreSupported(VkPhysicalDevice device) {
+        auto getFeatures2 = (PFN_vkGetPhysicalDeviceFeatures2KHR) vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2KHR");
+        if (getFeatures2 == nullptr) {
+            return false;
+        }
+        VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures{};
+        timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+        VkPhysicalDeviceFeatures2KHR features{};
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+        features.pNext = &timelineFeatures;
+        getFeatures2(device, &features);
+        return timelineFeatures.timelineSemaphore == VK_TRUE;
+    }
+    bool isDeviceExtensionSupported(VkPhysicalDevice device, const char* name) {
+        uint32_t extCount;
+        vkEnumerateDeviceExtensionProperties(device, nullptr, &extCount, nullptr);
+        std::vector<VkExtensionProperties> availableExt(extCount);
+        vkEnumerateDeviceExtensionProperties(device, nullptr, &extCount, availableExt.data());
+        
+        for (const auto& extension : availableExt) {
+            if (strcmp(extension.extensionName, name) == 0) {
+                return true;
+            }
+        }
+        return false;
     }
     bool checkDeviceExtensionSupport(VkPhysicalDevice device){
         uint32_t extCount;
@@ -859,6 +4991,8 @@ private:
         
         uint32_t graphicsFamily = defaultVal;
         uint32_t presentFamily = defaultVal;
+        uint32_t computeFamily = defaultVal; // not needed to be complete, falls back to the graphics queue
+        uint32_t computeQueueIndex = 0;
         
         bool isComplete(){
             // TODO: i had to use optional here, but xcode didnt let me compile properly, so instead this temp solution of 9999...
@@ -895,6 +5029,20 @@ private:
             }
             i++;
         }
+        
+        // for async compute, a family that can do compute but not graphics is usually its own hardware queue.
+        // next best is a second queue of the graphics family, and if there is none compute shares the graphics queue
+        for (uint32_t family = 0; family < queueFamilyCount; family++) {
+            VkQueueFlags flags = queueFamilies[family].queueFlags;
+            if ((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT)) {
+                indices.computeFamily = family;
+                break;
+            }
+        }
+        if (indices.computeFamily == indices.defaultVal && indices.graphicsFamily != indices.defaultVal) {
+            indices.computeFamily = indices.graphicsFamily;
+            indices.computeQueueIndex = queueFamilies[indices.graphicsFamily].queueCount > 1 ? 1 : 0;
+        }
         return indices;
     }
     
@@ -954,18 +5102,40 @@ private:
 
     
     std::vector<const char*> getRequiredExtensions() {
-        uint32_t glfwExtensionCount = 0;
-        const char** glfwExtensions;
-        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-
-        std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+        std::vector<const char*> extensions;
+        if (headless) {
+            extensions = {VK_KHR_SURFACE_EXTENSION_NAME, VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME};
+        } else {
+            uint32_t glfwExtensionCount = 0;
+            const char** glfwExtensions;
+            glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+            extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+        }
 
         if (enableValidationLayers) {
             extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
         }
+        physicalDeviceProperties2Enabled = isInstanceExtensionSupported(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+        if (physicalDeviceProperties2Enabled) {
+            extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+        }
 
         return extensions;
     }
+    
+    bool isInstanceExtensionSupported(const char* name) {
+        uint32_t extCount;
+        vkEnumerateInstanceExtensionProperties(nullptr, &extCount, nullptr);
+        std::vector<VkExtensionProperties> availableExt(extCount);
+        vkEnumerateInstanceExtensionProperties(nullptr, &extCount, availableExt.data());
+        
+        for (const auto& extension : availableExt) {
+            if (strcmp(extension.extensionName, name) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
   
     bool checkValidationLayerSupport() {
         uint32_t layerCount;
@@ -1028,15 +5198,39 @@ private:
 };
 
 
-int main() {
+int main(int argc, char** argv) {
     HelloTriangleApplication app;
+    bool benchmarking = false, replaying = false, headless = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--benchmark") == 0) {
+            benchmarking = true;
+            app.enableBenchmark();
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            app.setTracePath(argv[++i]);
+        } else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc) {
+            app.setCapturePath(argv[++i]);
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replaying = true;
+            app.setReplayPath(argv[++i]);
+        } else if (strcmp(argv[i], "--headless") == 0) {
+            headless = true;
+            app.enableHeadless();
+        }
+    }
 
     try {
+        // nothing would end a headless run but the end of a replay, and a benchmark picks its own modes every frame
+        if (headless && !replaying) {
+            throw std::runtime_error("failed to start, --headless needs --replay!");
+        }
+        if (replaying && benchmarking) {
+            throw std::runtime_error("failed to start, --replay can't run with --benchmark!");
+        }
         app.run();
     } catch (const std::exception& e) {
         std::cerr << e.what() << std::endl;
         return EXIT_FAILURE;
     }
 
-    return EXIT_SUCCESS;
+    return app.replayMatched() ? EXIT_SUCCESS : EXIT_FAILURE;
 }
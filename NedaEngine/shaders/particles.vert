@@ -0,0 +1,30 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// expands every particle into a camera facing quad, the instances come straight from the simulation's draw buffer
+
+layout(push_constant) uniform PushConstants {
+    mat4 viewProjection;
+    vec4 cameraRight;
+    vec4 cameraUp;
+} pc;
+
+// per instance, ParticleInstance in Particles.hpp
+layout(location = 0) in vec4 instancePositionSize;
+layout(location = 1) in vec4 instanceColor;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragCorner;
+
+const vec2 CORNERS[6] = vec2[](
+    vec2(-1.0, -1.0), vec2(1.0, -1.0), vec2(1.0, 1.0),
+    vec2(-1.0, -1.0), vec2(1.0, 1.0), vec2(-1.0, 1.0)
+);
+
+void main() {
+    vec2 corner = CORNERS[gl_VertexIndex];
+    vec3 worldPosition = instancePositionSize.xyz + (pc.cameraRight.xyz * corner.x + pc.cameraUp.xyz * corner.y) * instancePositionSize.w;
+    gl_Position = pc.viewProjection * vec4(worldPosition, 1.0);
+    fragColor = instanceColor.rgb;
+    fragCorner = corner;
+}
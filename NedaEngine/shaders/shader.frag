@@ -1,10 +1,120 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
-layout(location = 0) in vec3 fragColor;
+// matches ClusterGrid in Lighting.hpp
+#define CLUSTER_COUNT (16 * 9 * 24)
+#define MAX_LIGHTS_PER_CLUSTER 256
+// matches MAX_SHADOW_CASCADES in Shadows.hpp
+#define MAX_SHADOW_CASCADES 4
+
+const float AMBIENT_STRENGTH = 0.25;
+
+struct Light {
+    vec3 position;
+    float radius;
+    vec3 color;
+    float cosInner;
+    vec3 direction;
+    float cosOuter;
+};
+
+layout(std140, set = 0, binding = 0) uniform ClusterParams {
+    mat4 view;
+    vec2 projectionScale;
+    float nearPlane;
+    float farPlane;
+    uvec3 gridSize;
+    uint lightCount;
+    vec2 screenSize;
+    float sliceScale;
+    float sliceBias;
+} params;
+
+layout(std430, set = 0, binding = 1) readonly buffer Lights {
+    Light lights[];
+};
+
+layout(std430, set = 0, binding = 2) readonly buffer Clusters {
+    uint clusterLightCounts[CLUSTER_COUNT];
+    uint clusterLightIndices[];
+};
+
+layout(std140, set = 0, binding = 3) uniform ShadowParams {
+    mat4 cascadeViewProjections[MAX_SHADOW_CASCADES];
+    vec4 splitDepths;
+    vec4 normalOffsets;
+    vec3 lightDirection;
+    uint cascadeCount;
+    vec3 lightColor;
+    float texelSize;
+} shadow;
+
+layout(set = 0, binding = 4) uniform sampler2DArrayShadow shadowMaps;
+
+layout(location = 0) in vec3 fragAlbedo;
+layout(location = 1) in vec3 fragAmbient;
+layout(location = 2) in vec3 fragWorldPosition;
+layout(location = 3) in vec3 fragNormal;
 
 layout(location = 0) out vec4 outColor;
 
+uint clusterIndex(float depth) {
+    uint slice = uint(clamp(log(depth) * params.sliceScale + params.sliceBias, 0.0, float(params.gridSize.z - 1)));
+    uvec2 tile = min(uvec2(gl_FragCoord.xy / params.screenSize * vec2(params.gridSize.xy)), params.gridSize.xy - 1);
+    return (slice * params.gridSize.y + tile.y) * params.gridSize.x + tile.x;
+}
+
+// 1 is lit. the first cascade that reaches this depth, 3x3 taps that are each filtered 2x2 by the compare sampler
+float sunShadow(vec3 normal, float depth) {
+    uint cascade = 0;
+    while (cascade < shadow.cascadeCount && depth > shadow.splitDepths[cascade]) {
+        cascade++;
+    }
+    if (cascade == shadow.cascadeCount) {
+        return 1.0;
+    }
+
+    // pushed out along the normal by about a texel, so the receiver doesn't shadow itself where the bias isn't enough
+    vec3 position = fragWorldPosition + normal * shadow.normalOffsets[cascade];
+    vec4 shadowPosition = shadow.cascadeViewProjections[cascade] * vec4(position, 1.0);
+    vec2 uv = shadowPosition.xy * 0.5 + 0.5;
+
+    float lit = 0.0;
+    for (int y = -1; y <= 1; y++) {
+        for (int x = -1; x <= 1; x++) {
+            lit += texture(shadowMaps, vec4(uv + vec2(x, y) * shadow.texelSize, float(cascade), shadowPosition.z));
+        }
+    }
+    return lit / 9.0;
+}
+
 void main() {
-    outColor = vec4(fragColor, 1.0);
+    vec3 normal = normalize(fragNormal);
+    vec3 lighting = fragAmbient * AMBIENT_STRENGTH;
+
+    float depth = -(params.view * vec4(fragWorldPosition, 1.0)).z;
+    float sun = max(dot(normal, -shadow.lightDirection), 0.0);
+    lighting += shadow.lightColor * (sun * sunShadow(normal, depth));
+
+    uint cluster = clusterIndex(depth);
+    uint count = clusterLightCounts[cluster];
+    for (uint i = 0; i < count; i++) {
+        Light light = lights[clusterLightIndices[cluster * MAX_LIGHTS_PER_CLUSTER + i]];
+        vec3 toLight = light.position - fragWorldPosition;
+        float distanceSquared = dot(toLight, toLight);
+        if (distanceSquared >= light.radius * light.radius) {
+            continue;
+        }
+        vec3 direction = toLight * inversesqrt(distanceSquared);
+
+        // inverse square, windowed so it reaches 0 at the radius the light was binned with
+        float ratio = distanceSquared / (light.radius * light.radius);
+        float window = clamp(1.0 - ratio * ratio, 0.0, 1.0);
+        float attenuation = window * window / (distanceSquared + 1.0);
+        float spot = smoothstep(light.cosOuter, light.cosInner, dot(-direction, light.direction));
+
+        lighting += light.color * (max(dot(normal, direction), 0.0) * attenuation * spot);
+    }
+
+    outColor = vec4(fragAlbedo * lighting, 1.0);
 }
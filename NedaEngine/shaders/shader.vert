@@ -1,21 +1,30 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
-layout(location = 0) out vec3 fragColor;
+layout(push_constant) uniform PushConstants {
+    mat4 viewProjection;
+    vec4 materialTint;
+} pc;
 
-vec2 positions[3] = vec2[](
-    vec2(0.0, -0.5),
-    vec2(0.5, 0.5),
-    vec2(-0.5, 0.5)
-);
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inColor;
+layout(location = 5) in vec3 inNormal;
 
-vec3 colors[3] = vec3[](
-    vec3(1.0, 0.0, 0.0),
-    vec3(0.0, 1.0, 0.0),
-    vec3(0.0, 0.0, 1.0)
-);
+// per instance
+layout(location = 2) in vec3 instancePosition;
+layout(location = 3) in vec3 instanceScale;
+layout(location = 4) in vec3 instanceColor;
+
+layout(location = 0) out vec3 fragAlbedo;
+layout(location = 1) out vec3 fragAmbient;
+layout(location = 2) out vec3 fragWorldPosition;
+layout(location = 3) out vec3 fragNormal;
 
 void main() {
-    gl_Position = vec4(positions[gl_VertexIndex], 0.0, 1.0);
-    fragColor = colors[gl_VertexIndex];
+    vec3 worldPosition = instancePosition + inPosition * instanceScale;
+    gl_Position = pc.viewProjection * vec4(worldPosition, 1.0);
+    fragAlbedo = instanceColor * pc.materialTint.rgb;
+    fragAmbient = inColor; // the per face shade, it keeps the unlit sides readable
+    fragWorldPosition = worldPosition;
+    fragNormal = inNormal / instanceScale; // the inverse transpose of a scale is the inverse scale
 }
@@ -0,0 +1,19 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// stretches the rendered part of the scene target over the swapchain image, the bilinear filter does the upscale
+
+layout(set = 0, binding = 0) uniform sampler2D sceneColor;
+
+layout(push_constant) uniform PushConstants {
+    vec2 uvScale; // the rendered part's size over the target's
+    vec2 uvMax; // half a texel inside the rendered part
+} pc;
+
+layout(location = 0) in vec2 fragUv;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    outColor = vec4(texture(sceneColor, min(fragUv * pc.uvScale, pc.uvMax)).rgb, 1.0);
+}